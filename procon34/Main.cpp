@@ -1,10 +1,22 @@
 ﻿#include "stdafx.h"
 #include "main_display.hpp"
+#include "benchmarks/benchmark.hpp"
+#include "solvers/solver_executor.hpp"
 
 void Main() {
 	Scene::SetBackground(ColorF{ 0.0, 0.0, 0.0 });
 	Window::Resize(1280, 720);
 	using namespace Procon34;
+
+	// --solver-threads=N , --pin-threads : 探索で共有するスレッドプールの設定
+	SolverExecutor::ConfigureFromCommandLine();
+
+	// --benchmark : GUI の代わりにベンチマークを実行し、結果を Console に出す
+	if (Benchmark::RunFromCommandLine()) {
+		while (System::Update()) {}
+		return;
+	}
+
 	MainDisplay mainDisplay;
 
 	while (System::Update()) {
@@ -0,0 +1,81 @@
+﻿#include "benchmark.hpp"
+
+namespace Procon34 {
+
+	namespace Benchmark {
+
+		void Report(const Measurement& measurement) {
+			Console << U"{} : mean = {:.1f} us , min = {:.1f} us ({} iterations)"_fmt(
+				measurement.name, measurement.meanMicroseconds, measurement.minMicroseconds, measurement.iterations);
+		}
+
+		BoxPtr<GameState> RandomGameState(uint64 seed, int32 width, int32 height, int32 agentCount) {
+			std::mt19937_64 rng(seed);
+
+			GameInitialState initialState;
+			initialState.boardWidth = width;
+			initialState.boardHeight = height;
+			initialState.biomeGrid.assign(Size(width, height), MassBiome::Normal);
+			for (int32 i = 0; i < width * height / 12; i++) {
+				Point pos = Point((int32)(rng() % width), (int32)(rng() % height));
+				initialState.biomeGrid[pos] = (rng() % 3 == 0) ? MassBiome::Castle : MassBiome::Pond;
+			}
+
+			// 職人は池以外のマスに重ならないように置く
+			Array<int32> cells;
+			for (int32 i = 0; i < width * height; i++) {
+				if (initialState.biomeGrid[Point(i % width, i / width)] != MassBiome::Pond) cells.push_back(i);
+			}
+			std::shuffle(cells.begin(), cells.end(), rng);
+			for (auto color : GameState::AllPlayers()) {
+				initialState.agentPos[color].clear();
+				for (int32 i = 0; i < agentCount; i++) {
+					int32 cell = cells.back();
+					cells.pop_back();
+					initialState.agentPos[color].push_back(BoardPos(cell / width, cell % width));
+				}
+			}
+
+			initialState.turnCount = 200;
+			initialState.turnTimeLimitInMiliseconds = 3000;
+			initialState.firstToMove = PlayerColor::Red;
+			initialState.castleCoefficient = 100;
+			initialState.teritorryCoefficient = 30;
+			initialState.wallCoefficient = 10;
+			auto state = GameState::FromInitialState(initialState);
+
+			// 試合の途中らしく、両者の壁を散らしておく
+			auto board = state->getBoard();
+			for (int32 i = 0; i < width * height / 6; i++) {
+				auto pos = BoardPos((int32)(rng() % height), (int32)(rng() % width));
+				auto& mass = (*board)[pos];
+				if (mass.biome == MassBiome::Castle || mass.hasAgent()) continue;
+				mass.wall = WallData{ (rng() % 2) ? PlayerColor::Red : PlayerColor::Blue };
+			}
+			return state;
+		}
+
+		void RunAll() {
+			Console << U"---- benchmark ----";
+			WallPathSolve();
+			MainSolution2Pruning();
+			ThreadPoolDispatch();
+			MatchStateRequest();
+			MatchStateParse();
+			Console << U"---- benchmark finished ----";
+		}
+
+		bool RunFromCommandLine() {
+			auto args = System::GetCommandLineArgs();
+			if (args.contains(U"--load-test")) {
+				CompetitionLoad();
+				return true;
+			}
+			if (!args.contains(U"--benchmark")) return false;
+			RunAll();
+			return true;
+		}
+
+	}
+
+}
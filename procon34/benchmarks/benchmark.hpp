@@ -0,0 +1,71 @@
+﻿#pragma once
+#include "../stdafx.h"
+#include "../game_state.hpp"
+#include <chrono>
+
+// 探索の部品ごとのマイクロベンチマーク。
+// 起動時のコマンドライン引数に --benchmark を付けると、 GUI の代わりにこれを実行して結果を Console に出す。
+// --load-test を付けると、ローカルの競技サーバーに対して MatchInteractor の負荷試験をする。
+
+namespace Procon34 {
+
+	namespace Benchmark {
+
+		struct Measurement {
+			String name;
+			int32 iterations;
+			double meanMicroseconds;
+			double minMicroseconds;
+		};
+
+		// f を iterations 回実行して時間を測る
+		template<class F>
+		Measurement Measure(StringView name, int32 iterations, F&& f) {
+			using Clock = std::chrono::steady_clock;
+			double total = 0.0;
+			double minimum = std::numeric_limits<double>::infinity();
+			for (int32 i = 0; i < iterations; i++) {
+				auto begin = Clock::now();
+				f();
+				double elapsed = std::chrono::duration<double, std::micro>(Clock::now() - begin).count();
+				total += elapsed;
+				minimum = Min(minimum, elapsed);
+			}
+			return Measurement{ String(name), iterations, total / Max(iterations, 1), minimum };
+		}
+
+		void Report(const Measurement& measurement);
+
+		// ベンチマーク用のランダムな盤面。 seed が同じなら同じ盤面になる。
+		BoxPtr<GameState> RandomGameState(uint64 seed, int32 width, int32 height, int32 agentCount);
+
+		// WallPath2::solve （ 25x25 、職人 6 人）
+		void WallPathSolve();
+
+		// MainSolution2 の職人の集合の DP を、枝刈りありとなしで解き比べる（固定の盤面で、選ぶ計画が同じか確かめる）
+		void MainSolution2Pruning();
+
+		// ThreadPool に小さなタスクを大量に渡す
+		void ThreadPoolDispatch();
+
+		// 試合状態取得API 、行動計画更新API をローカルのサーバーに対して呼ぶ（ 25x25 、職人 6 人、行動ログ付き）
+		void MatchStateRequest();
+
+		// 試合状態取得API の応答を読んで GameState を作る（ JSON の木を作る場合と、 MatchStateResponse で直接読む場合）
+		void MatchStateParse();
+
+		// ローカルの競技サーバー (MockServer::CompetitionServer) で data/field の盤面の試合を同時に進め、
+		// MatchInteractor がターンの開始から行動計画を送るまでの時間を測る。 RunAll には含めない。
+		// --load-test-matches=N 、 --load-test-turns=N 、 --load-test-turn-seconds=N 、
+		// --mock-latency=ms 、 --mock-jitter=ms 、 --mock-drop=割合 で条件を変える
+		void CompetitionLoad();
+
+		// すべて実行する
+		void RunAll();
+
+		// コマンドライン引数に --benchmark があれば RunAll を、 --load-test があれば CompetitionLoad を実行して true を返す
+		bool RunFromCommandLine();
+
+	}
+
+}
@@ -0,0 +1,124 @@
+﻿#include "benchmark.hpp"
+#include "../request.hpp"
+#include "../match_interactor.hpp"
+#include "../match_scheduler.hpp"
+#include "../solvers/solver_list.hpp"
+#include "../mock_server/competition_server.hpp"
+
+namespace Procon34 {
+
+	namespace Benchmark {
+
+		namespace {
+
+			struct LoadTestConfig {
+				int32 matchCount = 8;
+				int32 turnCount = 30;
+				int32 turnSeconds = 3;
+				MockServer::CompetitionServer::Config server;
+			};
+
+			LoadTestConfig LoadTestConfigFromCommandLine() {
+				LoadTestConfig config;
+				for (auto& arg : System::GetCommandLineArgs()) {
+					auto valueOf = [&](StringView name) -> Optional<String> {
+						if (!arg.starts_with(name)) return none;
+						return arg.substr(name.size());
+					};
+					if (auto val = valueOf(U"--load-test-matches=")) config.matchCount = ParseOpt<int32>(*val).value_or(config.matchCount);
+					if (auto val = valueOf(U"--load-test-turns=")) config.turnCount = ParseOpt<int32>(*val).value_or(config.turnCount);
+					if (auto val = valueOf(U"--load-test-turn-seconds=")) config.turnSeconds = ParseOpt<int32>(*val).value_or(config.turnSeconds);
+					if (auto val = valueOf(U"--mock-latency=")) config.server.latencyMilliseconds = ParseOpt<int32>(*val).value_or(config.server.latencyMilliseconds);
+					if (auto val = valueOf(U"--mock-jitter=")) config.server.jitterMilliseconds = ParseOpt<int32>(*val).value_or(config.server.jitterMilliseconds);
+					if (auto val = valueOf(U"--mock-drop=")) config.server.dropRate = ParseOpt<double>(*val).value_or(config.server.dropRate);
+				}
+				return config;
+			}
+
+			void ReportLatencies(StringView name, Array<double> values) {
+				if (values.empty()) {
+					Console << U"{} : no samples"_fmt(name);
+					return;
+				}
+				values.sort();
+				auto percentile = [&](double p) { return values[Min(values.size() - 1, (size_t)(p * values.size()))]; };
+				double mean = values.sum() / values.size();
+				Console << U"{} : mean = {:.1f} ms , p50 = {:.1f} ms , p95 = {:.1f} ms , max = {:.1f} ms ({} turns)"_fmt(
+					name, mean, percentile(0.5), percentile(0.95), values.back(), values.size());
+			}
+
+		}
+
+		void CompetitionLoad() {
+			auto config = LoadTestConfigFromCommandLine();
+
+			Array<FilePath> fieldPaths = FileSystem::DirectoryContents(U"data/field", Recursive::No).filter([](const FilePath& path) {
+				return FileSystem::Extension(path) == U"csv";
+			}).sorted();
+			if (fieldPaths.empty()) {
+				Console << U"CompetitionLoad : skipped (no field in data/field)";
+				return;
+			}
+
+			// request.cpp の接続先 (localhost:3000) で競技サーバーの代わりをする
+			std::unique_ptr<MockServer::CompetitionServer> server;
+			try {
+				server = std::make_unique<MockServer::CompetitionServer>(config.server);
+			}
+			catch (const Error&) {
+				Console << U"CompetitionLoad : skipped (port {} is in use)"_fmt(config.server.port);
+				return;
+			}
+
+			// 盤面は data/field のものを順に使い、先手と後手を交互にする。 MatchInteractor を用意する時間をおいて始める
+			for (int32 i = 0; i < config.matchCount; i++) {
+				auto initialState = GameInitialState::FromFieldCsv(fieldPaths[i % fieldPaths.size()]);
+				if (!initialState) throw Error(U"error at CompetitionLoad : cannot read {}"_fmt(fieldPaths[i % fieldPaths.size()]));
+				initialState->turnCount = config.turnCount;
+				initialState->turnTimeLimitInMiliseconds = config.turnSeconds * 1000;
+				initialState->firstToMove = i % 2 == 0 ? PlayerColor::Red : PlayerColor::Blue;
+				initialState->castleCoefficient = 100;
+				initialState->teritorryCoefficient = 30;
+				initialState->wallCoefficient = 10;
+				server->addMatch(*initialState, U"mock{}"_fmt(i + 1), std::chrono::milliseconds(2000));
+			}
+			Console << U"CompetitionLoad : {} matches , {} turns , {} s/turn , latency = {} ms , jitter = {} ms , drop = {}"_fmt(
+				config.matchCount, config.turnCount, config.turnSeconds, config.server.latencyMilliseconds, config.server.jitterMilliseconds, config.server.dropRate);
+
+			// GUI と同じように、試合一覧から MatchInteractor を作る
+			Optional<JSON> matches;
+			while (!(matches = getMatchesList())) System::Sleep(100ms);
+			auto scheduler = std::make_shared<MatchScheduler>();
+			Array<std::shared_ptr<MatchInteractor>> interactors;
+			for (auto val : (*matches)[U"matches"].arrayView()) {
+				auto overview = MatchOverview::FromJson(val);
+				if (!overview) throw Error(U"error at CompetitionLoad : cannot read the match list");
+				auto solver = SolverInterface::ListOfSolvers().back();
+				auto ponderSolverFactory = []() { return SolverInterface::ListOfSolvers().back(); };
+				interactors.push_back(std::make_shared<MatchInteractor>(*overview, solver, ponderSolverFactory, scheduler));
+			}
+
+			while (!server->isFinished()) System::Sleep(100ms);
+			for (auto& interactor : interactors) interactor->requestStop();
+			for (auto& interactor : interactors) interactor->stop();
+			server->stop();
+
+			// ターンが始まってから（サーバーが公開してから）行動計画を受け付けるまで
+			auto statistics = server->statistics();
+			ReportLatencies(U"turn start -> first post", statistics.firstPostMilliseconds);
+			ReportLatencies(U"turn start -> last post", statistics.lastPostMilliseconds);
+			Console << U"own turns = {} , missed = {} , posts = {} , rejected = {} , requests = {} , dropped = {}"_fmt(
+				statistics.ownTurnCount, statistics.missedTurnCount, statistics.postCount, statistics.rejectedPostCount, statistics.requestCount, statistics.droppedCount);
+
+			auto schedulerStatistics = scheduler->statistics();
+			Console << U"MatchScheduler : {} solves , waited = {} , oversubscribed = {} , max wait = {:.1f} ms"_fmt(
+				schedulerStatistics.solveCount, schedulerStatistics.waitedCount, schedulerStatistics.oversubscribedCount, schedulerStatistics.maxWaitMilliseconds);
+
+			auto clientStatistics = matchApiClient().statistics();
+			Console << U"HttpClient : {} requests , {} connections , {} failures , latency mean = {:.3f} ms , max = {:.3f} ms"_fmt(
+				clientStatistics.requestCount, clientStatistics.connectCount, clientStatistics.failureCount, clientStatistics.meanLatencyMilliseconds(), clientStatistics.maxLatencyMilliseconds);
+		}
+
+	}
+
+}
@@ -0,0 +1,40 @@
+﻿#include "benchmark.hpp"
+#include "../solvers/solver_main2.hpp"
+
+namespace Procon34 {
+
+	namespace Benchmark {
+
+		void MainSolution2Pruning() {
+			constexpr int32 SeedCount = 6;
+
+			// 制限時間で段階が打ち切られると結果が時間で変わるので、残す時間を負にして制限時間を 1 分延ばし、読むターン数を抑える
+			auto pruned = std::make_shared<Solvers::MainSolution2>(-60000, 6);
+			auto unpruned = std::make_shared<Solvers::MainSolution2>(-60000, 6);
+			unpruned->setBranchAndBound(false);
+
+			int32 mismatchCount = 0;
+			double prunedMilliseconds = 0.0, unprunedMilliseconds = 0.0;
+			for (int32 seed = 1; seed <= SeedCount; seed++) {
+				auto state = RandomGameState(seed, 25, 25, 6);
+				std::shared_ptr<SolverInterface> solvers[2] = { pruned, unpruned };
+				std::string bodies[2];
+				for (int32 k = 0; k < 2; k++) {
+					auto measurement = Measure(U"", 1, [&]() {
+						bodies[k].clear();
+						solvers[k]->solve(state, nullptr).appendJson(bodies[k]);
+					});
+					(k == 0 ? prunedMilliseconds : unprunedMilliseconds) += measurement.meanMicroseconds / 1000.0;
+				}
+				if (bodies[0] != bodies[1]) {
+					Console << U"MainSolution2Pruning : plan mismatch (seed = {})"_fmt(seed);
+					mismatchCount++;
+				}
+			}
+			Console << U"MainSolution2Pruning : {} / {} plans match , branch and bound = {:.1f} ms , without = {:.1f} ms"_fmt(
+				SeedCount - mismatchCount, SeedCount, prunedMilliseconds, unprunedMilliseconds);
+		}
+
+	}
+
+}
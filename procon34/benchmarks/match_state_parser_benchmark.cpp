@@ -0,0 +1,57 @@
+﻿#include "benchmark.hpp"
+#include "../request.hpp"
+#include "../match_state_response.hpp"
+#include "../mock_server/match_json.hpp"
+
+namespace Procon34 {
+
+	namespace Benchmark {
+
+		void MatchStateParse() {
+			constexpr int32 Iterations = 500;
+
+			// 25x25 、職人 6 人、 150 ターン分の行動ログがある応答
+			auto played = MockServer::PlayRandomly(RandomGameState(1, 25, 25, 6), 150, 1);
+			const std::string body = MockServer::MatchStateToJson(1, *played.state, PlayerColor::Red, played.logs).formatUTF8();
+			Console << U"MatchStateParse : response body = {} bytes"_fmt(body.size());
+
+			// 試合一覧API で受け取るはずの内容
+			auto initialState = played.state->getInitialState();
+			MatchOverview overview{
+				.id = 1,
+				.turns = initialState->turnCount,
+				.turnSeconds = initialState->turnTimeLimitInMiliseconds / 1000,
+				.opponent = U"benchmark",
+				.bonusWall = initialState->wallCoefficient,
+				.bonusTerritory = initialState->teritorryCoefficient,
+				.bonusCastle = initialState->castleCoefficient,
+				.first = initialState->firstToMove == PlayerColor::Red,
+				.boardWidth = initialState->boardWidth,
+				.boardHeight = initialState->boardHeight,
+				.boardMason = (int32)initialState->agentPos[PlayerColor::Red].size(),
+				.myAgentPos = initialState->agentPos[PlayerColor::Red],
+				.opponentAgentPos = initialState->agentPos[PlayerColor::Blue],
+			};
+
+			// 以前のやり方： JSON の木を作ってから盤面を読む
+			Report(Measure(U"JSON::Load", Iterations, [&]() {
+				JSON::Load(MemoryViewReader(body.data(), body.size()));
+			}));
+			Report(Measure(U"JSON::Load + GameState::FromJson", Iterations, [&]() {
+				GameState::FromJson(JSON::Load(MemoryViewReader(body.data(), body.size())), overview);
+			}));
+
+			// 本体を 1 回なめて、行優先の配列へ直接書く（配列の領域は使い回す）
+			MatchStateResponse response;
+			Report(Measure(U"MatchStateResponse::parse", Iterations, [&]() {
+				response.parse(body);
+			}));
+			Report(Measure(U"MatchStateResponse::parse + GameState::FromResponse", Iterations, [&]() {
+				response.parse(body);
+				GameState::FromResponse(response, overview);
+			}));
+		}
+
+	}
+
+}
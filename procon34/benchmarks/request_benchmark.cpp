@@ -0,0 +1,95 @@
+﻿#include "benchmark.hpp"
+#include "../request.hpp"
+#include "../game_instructions.hpp"
+#include "../mock_server/local_http_server.hpp"
+#include "../mock_server/match_json.hpp"
+#include <thread>
+
+namespace Procon34 {
+
+	namespace Benchmark {
+
+		void MatchStateRequest() {
+			constexpr int64 MatchId = 1;
+			constexpr int32 Iterations = 200;
+			constexpr int32 ConcurrentMatches = 4;
+
+			// 25x25 、職人 6 人、 150 ターン分の行動ログがある応答
+			auto played = MockServer::PlayRandomly(RandomGameState(1, 25, 25, 6), 150, 1);
+			const std::string body = MockServer::MatchStateToJson(MatchId, *played.state, PlayerColor::Red, played.logs).formatUTF8();
+
+			// request.cpp の接続先 (localhost:3000) で競技サーバーの代わりをする
+			std::unique_ptr<MockServer::LocalHttpServer> server;
+			try {
+				server = std::make_unique<MockServer::LocalHttpServer>(3000, [&](const MockServer::HttpRequest& request) {
+					if (request.target != "/matches/1") return MockServer::HttpResponse{ .status = 404, .body = "{}" };
+					if (request.method == "POST") return MockServer::HttpResponse{ .body = "{\"accepted_at\":0}" };
+					return MockServer::HttpResponse{ .body = body };
+				});
+			}
+			catch (const Error&) {
+				Console << U"MatchStateRequest : skipped (port 3000 is in use)";
+				return;
+			}
+			Console << U"MatchStateRequest : response body = {} bytes"_fmt(body.size());
+
+			// 以前のやり方：要求のたびに接続し、ファイルに書き出して読み直す
+			const HashTable<String, String> header = { { U"procon-token", U"token" } };
+			const FilePath path = U"benchmark_temp.json";
+			Report(Measure(U"SimpleHTTP::Get to file + JSON::Load(path)", Iterations, [&]() {
+				if (SimpleHTTP::Get(U"http://localhost:3000/matches/1", header, path)) JSON::Load(path);
+			}));
+			FileSystem::Remove(path);
+
+			// 接続だけ比べる（本体は読まない）
+			MemoryWriter writer;
+			Report(Measure(U"SimpleHTTP::Get to memory (new connection each time)", Iterations, [&]() {
+				writer.clear();
+				SimpleHTTP::Get(U"http://localhost:3000/matches/1", header, writer);
+			}));
+
+			HttpClient::Buffers buffers;
+			Report(Measure(U"HttpClient::get (keep-alive)", Iterations, [&]() {
+				matchApiClient().get("/matches/1", buffers);
+			}));
+
+			Report(Measure(U"getMatchesState (keep-alive + JSON)", Iterations, [&]() {
+				getMatchesState(MatchId, buffers);
+			}));
+
+			// 試合ごとのスレッドから同時に取得する
+			Report(Measure(U"getMatchesState x {} threads"_fmt(ConcurrentMatches), Iterations / 10, [&]() {
+				Array<std::thread> threads;
+				for (int32 i = 0; i < ConcurrentMatches; i++) {
+					threads.emplace_back([]() {
+						HttpClient::Buffers matchBuffers;
+						for (int32 k = 0; k < 10; k++) getMatchesState(MatchId, matchBuffers);
+					});
+				}
+				for (auto& thread : threads) thread.join();
+			}));
+
+			// 行動計画更新API の本体を作る
+			TurnInstruction instruction(played.state, played.state->whosTurn());
+			std::string out;
+			Report(Measure(U"TurnInstruction::toJson().formatUTF8()", Iterations * 10, [&]() {
+				out = instruction.toJson().formatUTF8();
+			}));
+			Report(Measure(U"TurnInstruction::appendJson (reused buffer)", Iterations * 10, [&]() {
+				out.clear();
+				instruction.appendJson(out);
+			}));
+			Report(Measure(U"HttpClient::post + TurnInstruction::appendJson (keep-alive)", Iterations, [&]() {
+				matchApiClient().post("/matches/1", [&](std::string& request) { instruction.appendJson(request); }, buffers);
+			}));
+
+			auto statistics = matchApiClient().statistics();
+			Console << U"HttpClient : {} requests , {} connections , {} failures , latency mean = {:.3f} ms , max = {:.3f} ms"_fmt(
+				statistics.requestCount, statistics.connectCount, statistics.failureCount, statistics.meanLatencyMilliseconds(), statistics.maxLatencyMilliseconds);
+
+			server->stop();
+		}
+
+	}
+
+}
@@ -0,0 +1,57 @@
+﻿#include "benchmark.hpp"
+#include "../solvers/thread_pool.hpp"
+
+namespace Procon34 {
+
+	namespace Benchmark {
+
+		void ThreadPoolDispatch() {
+			constexpr int32 TaskCount = 100000;
+			constexpr int32 Iterations = 10;
+
+			uint32 threadCount = ThreadPool::HardwareConcurrency().value_or(4);
+			auto threadPool = ThreadPool::Construct(threadCount);
+			Console << U"ThreadPool : {} threads , {} tasks per iteration"_fmt(threadCount, TaskCount);
+
+			// 探索のタスクと同じく、参照と整数だけをキャプチャする小さなタスク
+			Array<int64> sums(threadCount, 0);
+			Report(Measure(U"ThreadPool::pushTask + sync (tiny tasks)", Iterations, [&]() {
+				for (int32 i = 0; i < TaskCount; i++) {
+					threadPool->pushTask([&sums, i](uint32 threadIndex) { sums[threadIndex] += i; });
+				}
+				threadPool->sync();
+			}));
+
+			// 各タスクの中から、さらにタスクを追加する（各スレッドの両端キューに入る）
+			Report(Measure(U"ThreadPool::pushTask (nested)", Iterations, [&]() {
+				for (int32 i = 0; i < (int32)threadCount; i++) {
+					threadPool->pushTask([&, i](uint32) {
+						for (int32 k = i; k < TaskCount; k += threadCount) {
+							threadPool->pushTask([&sums, k](uint32 threadIndex) { sums[threadIndex] += k; });
+						}
+					});
+				}
+				threadPool->sync();
+			}));
+
+			Report(Measure(U"ThreadPool::parallelFor", Iterations, [&]() {
+				threadPool->parallelFor(0, TaskCount, [&sums](size_t i, uint32 threadIndex) { sums[threadIndex] += (int64)i; });
+			}));
+
+			// 探索ごとのスレッド数の上限を付けたプール（ SolverExecutor::Budget と同じ形）を通す
+			Report(Measure(U"ThreadPool::ConstructLimited + pushTask + sync (1000 tasks)", Iterations, [&]() {
+				auto limited = ThreadPool::ConstructLimited(*threadPool, Max<uint32>(1, threadCount / 2));
+				for (int32 i = 0; i < 1000; i++) {
+					limited->pushTask([&sums, i](uint32 threadIndex) { sums[threadIndex] += i; });
+				}
+				limited->sync();
+			}));
+
+			int64 checksum = 0;
+			for (auto sum : sums) checksum += sum;
+			Console << U"checksum = {}"_fmt(checksum);
+		}
+
+	}
+
+}
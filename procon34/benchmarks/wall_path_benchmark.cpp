@@ -0,0 +1,180 @@
+﻿#include "benchmark.hpp"
+#include "../solvers/grid_shortpath_2.hpp"
+#include "../solvers/grid_walking.hpp"
+
+namespace Procon34 {
+
+	namespace Benchmark {
+
+		namespace {
+
+			// 辺を AoS で持っていたころの WallPath2::solve 。比較と答え合わせに使う。
+			Array<WallPath2::MovingState> SolveReference(const WallPath2& wallPath, int32 maxTurn, const Array<WallPath2::MovingState>& starters) {
+				auto& nodes = wallPath.nodes;
+				auto& edges = wallPath.edges;
+				auto& edgesSeparators = wallPath.edgesSeparators;
+
+				Array<std::pair<int32, int32>> sortedStarters;
+				for (auto& start : starters) sortedStarters.push_back(std::make_pair(start.nodeId, start.turnCount));
+				sortedStarters.sort_by([](auto l, auto r) { return l.second < r.second; });
+				size_t starterPointer = 0;
+
+				Array<int32> nodesMapping;
+				Array<int32> distanceSeparator = { 0 };
+				Array<WallPath2::EdgeDesc> newEdges;
+				Array<int32> newEdgesSeparators;
+
+				Array<int32> visited(nodes.size(), maxTurn + 1);
+				Array<int32> nx1, nx2;
+				for (int32 dist = 0; dist <= maxTurn; dist++) {
+					while (starterPointer < sortedStarters.size() && sortedStarters[starterPointer].second <= dist) {
+						int32 pos = sortedStarters[starterPointer].first;
+						if (visited[pos] > dist) {
+							nx1.push_back(pos);
+							visited[pos] = dist;
+						}
+						starterPointer++;
+					}
+					auto nx0 = std::move(nx1);
+					nx1 = std::move(nx2);
+					nx2 = {};
+					for (int32 v : nx0) if (visited[v] == dist) {
+						nodesMapping.push_back(v);
+						for (int32 ei = edgesSeparators[v]; ei < edgesSeparators[v + 1]; ei++) {
+							auto& e = edges[ei];
+							newEdges.push_back(e);
+							int32 nxdist = e.turns + dist;
+							if (nxdist >= visited[e.to]) continue;
+							(e.turns == 2 ? nx2 : nx1).push_back(e.to);
+							visited[e.to] = nxdist;
+						}
+					}
+					newEdgesSeparators.push_back((int32)newEdges.size());
+					distanceSeparator.push_back((int32)nodesMapping.size());
+				}
+
+				Array<int32> nodesInverseMapping(nodes.size());
+				for (int32 i = 0; i < (int32)nodesMapping.size(); i++) nodesInverseMapping[nodesMapping[i]] = i;
+				for (auto& e : newEdges) {
+					e.from = nodesInverseMapping[e.from];
+					e.to = nodesInverseMapping[e.to];
+				}
+
+				Array<size_t> distanceArrayOffset(maxTurn + 2, 0);
+				for (int32 d = 0; d <= maxTurn; d++) distanceArrayOffset[d + 1] = distanceArrayOffset[d] + distanceSeparator[d + 1];
+
+				WallPath2::MovingState ini;
+				ini.firstMove = ShortenMove::Stay();
+				ini.offsetProfit = -1001001001001001;
+				Array<WallPath2::MovingState> result(distanceArrayOffset.back(), ini);
+				for (auto& starter : starters) {
+					result[distanceArrayOffset[starter.turnCount] + nodesInverseMapping[starter.nodeId]] = starter;
+				}
+
+				for (int32 turnId = 0; turnId <= maxTurn; turnId++) {
+					for (int32 nodeId = 0; nodeId < distanceSeparator[turnId + 1]; nodeId++) {
+						result[distanceArrayOffset[turnId] + nodeId].turnCount = turnId;
+						result[distanceArrayOffset[turnId] + nodeId].nodeId = nodesMapping[nodeId];
+					}
+					if (turnId == maxTurn) continue;
+					for (int32 edgeId = 0; edgeId < newEdgesSeparators[turnId]; edgeId++) {
+						auto& edge = newEdges[edgeId];
+						if (turnId + edge.turns > maxTurn) continue;
+						size_t prevIndex = distanceArrayOffset[turnId] + edge.from;
+						size_t toIndex = distanceArrayOffset[turnId + edge.turns] + edge.to;
+						int64 nextProfit = result[prevIndex].offsetProfit + edge.cost;
+						if (nextProfit <= result[toIndex].offsetProfit) continue;
+						result[toIndex].offsetProfit = nextProfit;
+						if (turnId == 0) {
+							switch (edge.type) {
+							case 0: result[toIndex].firstMove = ShortenMove::Move(edge.direction); break;
+							case 1: result[toIndex].firstMove = ShortenMove::Construct(edge.direction); break;
+							default: result[toIndex].firstMove = ShortenMove::Destroy(edge.direction); break;
+							}
+						}
+						else {
+							result[toIndex].firstMove = result[prevIndex].firstMove;
+						}
+					}
+				}
+				return result;
+			}
+
+			bool IsSameResult(const Array<WallPath2::MovingState>& l, const Array<WallPath2::MovingState>& r) {
+				if (l.size() != r.size()) return false;
+				for (size_t i = 0; i < l.size(); i++) {
+					if (l[i].nodeId != r[i].nodeId || l[i].turnCount != r[i].turnCount) return false;
+					if (l[i].offsetProfit != r[i].offsetProfit || l[i].firstMove != r[i].firstMove) return false;
+				}
+				return true;
+			}
+
+		}
+
+		void WallPathSolve() {
+			constexpr int32 BoardSize = 25;
+			constexpr int32 AgentCount = 6;
+			constexpr int32 MaxTurn = 8;
+			constexpr int32 DifferenceRadius = 7;
+
+			std::shared_ptr<const GameState> state = RandomGameState(34, BoardSize, BoardSize, AgentCount);
+			auto boardSize = state->getBoard()->getSize();
+			auto myAgents = state->getAgents(state->whosTurn());
+
+			// MainSolution2 と同じ形の入力を作る
+			auto gridWalking = GridWalking(state, Array<Grid<int64>>(MaxTurn + 1, Grid<int64>(boardSize, 0)));
+			auto diagGraph = std::make_shared<DiagonalGraph>(state, Grid<int64>(boardSize, 100));
+			auto wallPath = WallPath2(diagGraph, state, Grid<int64>(boardSize, -10), WallPath2::EnabledDifferenceWithRadius(DifferenceRadius), true);
+
+			// ConstructWallPath2::solve と同じく、職人ごと・壁の始点ごとに 1 回ずつ解く
+			Array<Array<WallPath2::MovingState>> inputs;
+			for (auto& answer : gridWalking.solveAll(myAgents, MaxTurn)) {
+				Array<Array<BoardPos>> validAgentPos(diagGraph->numberOfBases());
+				for (auto& node : wallPath.nodes) {
+					if (answer.positionToListIndex[node.agentPos.asPoint()] >= 0) validAgentPos[node.baseId].push_back(node.agentPos);
+				}
+				for (int32 base = 0; base < (int32)validAgentPos.size(); base++) if (validAgentPos[base].size() >= 1) {
+					Array<WallPath2::MovingState> starters;
+					for (auto agentPos : validAgentPos[base]) {
+						int32 listIndex = answer.positionToListIndex[agentPos.asPoint()];
+						for (int32 t = 0; t <= MaxTurn; t++) {
+							if ((int32)answer.shortPath[t].size() <= listIndex) continue;
+							WallPath2::MovingState tmp;
+							tmp.nodeId = wallPath.getNodeId(agentPos, base);
+							tmp.turnCount = t;
+							tmp.firstMove = ShortenMove::Encode(answer.shortPath[t][listIndex].firstMove);
+							tmp.offsetProfit = answer.shortPath[t][listIndex].profit;
+							starters.push_back(tmp);
+						}
+					}
+					inputs.push_back(std::move(starters));
+				}
+			}
+			Console << U"WallPath2::solve : {} nodes , {} edges , {} calls per iteration"_fmt(wallPath.nodes.size(), wallPath.edges.size(), inputs.size());
+
+			auto batchedResults = wallPath.solve(MaxTurn, inputs);
+			for (size_t i = 0; i < inputs.size(); i++) {
+				auto reference = SolveReference(wallPath, MaxTurn, inputs[i]);
+				if (!IsSameResult(reference, wallPath.solve(MaxTurn, inputs[i])) || !IsSameResult(reference, batchedResults[i])) {
+					Console << U"WallPath2::solve : result mismatch";
+					return;
+				}
+			}
+
+			constexpr int32 Iterations = 10;
+			int64 checksum = 0;
+			Report(Measure(U"WallPath2::solve (AoS reference)", Iterations, [&]() {
+				for (auto& starters : inputs) checksum += SolveReference(wallPath, MaxTurn, starters).size();
+			}));
+			Report(Measure(U"WallPath2::solve (one call per starter set)", Iterations, [&]() {
+				for (auto& starters : inputs) checksum += wallPath.solve(MaxTurn, starters).size();
+			}));
+			Report(Measure(U"WallPath2::solve (batched)", Iterations, [&]() {
+				checksum += wallPath.solve(MaxTurn, inputs).size();
+			}));
+			Console << U"checksum = {}"_fmt(checksum);
+		}
+
+	}
+
+}
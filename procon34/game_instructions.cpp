@@ -1,5 +1,6 @@
 ﻿#include "game_instructions.hpp"
 #include "game_state.hpp"
+#include <cstdio>
 
 
 namespace Procon34 {
@@ -67,4 +68,40 @@ namespace Procon34 {
 		}
 		return result;
 	}
+
+	void TurnInstruction::appendJson(std::string& out) const {
+		auto appendInteger = [&](int32 val) {
+			char buf[16];
+			out.append(buf, std::snprintf(buf, sizeof(buf), "%d", (int)val));
+		};
+
+		out += "{\"turn\":";
+		appendInteger(m_game->getTurnIndex() + 1);
+		out += ",\"actions\":[";
+		for (size_t idx = 0; idx < m_data.size(); idx++) {
+			auto& agent = m_data[idx];
+			int32 type = 0;
+			int32 dir = 0; // 無方向
+			if (agent.isMove()) {
+				type = 1;
+				dir = (11 - agent.asMove().dir.value()) % 8 + 1;
+			}
+			else if (agent.isConstruct()) {
+				type = 2;
+				dir = (11 - agent.asConstruct().dir.value()) % 8 + 1;
+			}
+			else if (agent.isDestroy()) {
+				type = 3;
+				dir = (11 - agent.asDestroy().dir.value()) % 8 + 1;
+			}
+
+			if (idx != 0) out += ',';
+			out += "{\"type\":";
+			appendInteger(type);
+			out += ",\"dir\":";
+			appendInteger(dir);
+			out += '}';
+		}
+		out += "]}";
+	}
 }
@@ -28,6 +28,9 @@ namespace Procon34 {
 
 		// 行動計画更新API の Request Body ([POST] /matches/{id})
 		JSON toJson() const;
+
+		// toJson().formatUTF8() と同じ内容を out の後ろに直接書く（ JSON を組み立てない）
+		void appendJson(std::string& out) const;
 	};
 
 }
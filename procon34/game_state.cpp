@@ -130,6 +130,39 @@ namespace Procon34 {
 		return res;
 	}
 
+	Optional<GameInitialState> GameInitialState::FromFieldCsv(FilePathView path) {
+		const CSV csv(path);
+		if (!csv || csv.rows() == 0) return none;
+
+		GameInitialState res;
+		res.agentPos[PlayerColor::Red].clear();
+		res.agentPos[PlayerColor::Blue].clear();
+
+		int32 h = (int32)csv.rows();
+		int32 w = (int32)csv.columns(0);
+		res.boardHeight = h;
+		res.boardWidth = w;
+		res.biomeGrid.assign(Size(w, h), MassBiome::Normal);
+		for (int32 r = 0; r < h; r++) for (int32 c = 0; c < w; c++) {
+			BoardPos pos = BoardPos(r, c);
+			Point posp = pos.asPoint();
+			String s = csv.get(r, c);
+			if (s == U"1") {
+				res.biomeGrid[posp] = MassBiome::Pond;
+			}
+			if (s == U"2") {
+				res.biomeGrid[posp] = MassBiome::Castle;
+			}
+			if (s == U"a") {
+				res.agentPos[PlayerColor::Red].push_back(pos);
+			}
+			if (s == U"b") {
+				res.agentPos[PlayerColor::Blue].push_back(pos);
+			}
+		}
+		return res;
+	}
+
 
 	// returns error messages (one line string for each)
 	Optional<Array<String>> GameInitialState::verify(bool doThrow) const {
@@ -219,6 +252,7 @@ namespace Procon34 {
 	GameState::GameState()
 		: m_turnId(0)
 		, m_score(0, 0)
+		, m_computedCache(std::make_shared<ComputedCache>())
 	{}
 
 	void GameState::initAreas() {
@@ -425,6 +459,9 @@ namespace Procon34 {
 		recalcOpenAreas();
 		recalcScores();
 
+		// 盤面が変わったので、計算済みの値は使えない
+		m_computedCache = std::make_shared<ComputedCache>();
+
 		// ターン番号を進める。
 		m_turnId++;
 		m_playerOfTurn = OpponentOf(m_playerOfTurn);
@@ -449,6 +486,42 @@ namespace Procon34 {
 		return m_closedArea[color][pos.asPoint()];
 	}
 
+	uint64 GameState::hash() const {
+		// FNV-1a
+		uint64 res = 14695981039346656037ull;
+		auto mix = [&](uint64 val) -> void {
+			res ^= val;
+			res *= 1099511628211ull;
+		};
+
+		int32 h = m_board->getHeight();
+		int32 w = m_board->getWidth();
+		for (int32 r = 0; r < h; r++) {
+			for (int32 c = 0; c < w; c++) {
+				auto& wall = (*m_board)[BoardPos(r, c)].wall;
+				mix(!wall.has_value() ? 0 : wall->color == PlayerColor::Red ? 1 : 2);
+			}
+		}
+		for (auto player : AllPlayers()) {
+			for (auto& agent : m_agents[player]) mix((uint64)(agent.pos.r * w + agent.pos.c));
+		}
+		mix((uint64)m_turnId);
+
+		return res;
+	}
+
+	BoxPtr<GameState> GameState::clone() const {
+
+		class ConstructionHelper : public GameState {
+		public:
+			ConstructionHelper(const GameState& src) : GameState(src) {}
+		};
+
+		BoxPtr<GameState> res = std::make_shared<ConstructionHelper>(*this);
+		res->m_board = std::make_shared<GameBoard>(*m_board); // 盤面だけは共有しない
+		return res;
+	}
+
 	BoxPtr<GameState> GameState::FromInitialState(const GameInitialState& initialState) {
 
 		class ConstructionHelper : public GameState {
@@ -579,6 +652,7 @@ namespace Procon34 {
 					int32 destIndex = agent_idx - 1;
 					auto agent = Agent{ .marker = AgentMarker{.color = PlayerColor::Red, .index = destIndex }, .pos = BoardPos(r, c) };
 					agents[PlayerColor::Red][destIndex] = agent;
+					(*gameboard)[agent.pos].agent = agent.marker;
 				}
 
 				// 敵は負
@@ -586,6 +660,7 @@ namespace Procon34 {
 					int32 destIndex = -agent_idx - 1;
 					auto agent = Agent{ .marker = AgentMarker{.color = PlayerColor::Blue, .index = destIndex }, .pos = BoardPos(r, c) };
 					agents[PlayerColor::Blue][destIndex] = agent;
+					(*gameboard)[agent.pos].agent = agent.marker;
 				}
 			}
 		}
@@ -632,4 +707,89 @@ namespace Procon34 {
 
 		return res;
 	}
+
+	BoxPtr<GameState> GameState::FromResponse(const MatchStateResponse& response, const MatchOverview& mov) {
+		class ConstructionHelper : public GameState {
+		public:
+			ConstructionHelper() : GameState() {}
+		};
+
+		if (response.width != mov.boardWidth || response.height != mov.boardHeight) {
+			throw Error(U"GameState::FromResponse failed (board size differs from the match overview)");
+		}
+
+		auto initialState = std::make_shared<GameInitialState>();
+		initialState->boardWidth = mov.boardWidth;
+		initialState->boardHeight = mov.boardHeight;
+		initialState->castleCoefficient = mov.bonusCastle;
+		initialState->teritorryCoefficient = mov.bonusTerritory;
+		initialState->wallCoefficient = mov.bonusWall;
+		initialState->turnCount = mov.turns;
+		initialState->turnTimeLimitInMiliseconds = mov.turnSeconds * 1000;
+		initialState->firstToMove = mov.first ? PlayerColor::Red : PlayerColor::Blue;
+		initialState->biomeGrid.assign(Size(mov.boardWidth, mov.boardHeight), MassBiome::Normal);
+		initialState->agentPos[PlayerColor::Red] = mov.myAgentPos;
+		initialState->agentPos[PlayerColor::Blue] = mov.opponentAgentPos;
+
+		auto board = std::make_shared<GameBoard>(mov.boardWidth, mov.boardHeight);
+		auto agents = EachPlayer<Array<Agent>>();
+		agents[PlayerColor::Red].resize(mov.boardMason);
+		agents[PlayerColor::Blue].resize(mov.boardMason);
+
+		// 地形・職人・壁を 1 回なめて盤面に書く
+		for (int32 r = 0; r < mov.boardHeight; r++) {
+			for (int32 c = 0; c < mov.boardWidth; c++) {
+				auto pos = BoardPos(r, c);
+				auto& mass = (*board)[pos];
+				size_t cell = response.cellIndex(r, c);
+
+				int32 biome = response.structures[cell];
+				mass.biome = biome == 0 ? MassBiome::Normal : biome == 1 ? MassBiome::Pond : MassBiome::Castle;
+				initialState->biomeGrid[r][c] = mass.biome;
+
+				// 味方は正、敵は負
+				int32 mason = response.masons[cell];
+				if (mason != 0) {
+					auto color = mason > 0 ? PlayerColor::Red : PlayerColor::Blue;
+					int32 index = Abs(mason) - 1;
+					if (mov.boardMason <= index) throw Error(U"GameState::FromResponse failed (mason index out of range)");
+					agents[color][index] = Agent{ .marker = AgentMarker{.color = color, .index = index }, .pos = pos };
+					mass.agent = agents[color][index].marker;
+				}
+
+				// 味方は 1 、敵は 2
+				int32 wall = response.walls[cell];
+				if (wall == 1) mass.wall = WallData{ PlayerColor::Red };
+				else if (wall == 2) mass.wall = WallData{ PlayerColor::Blue };
+			}
+		}
+
+		BoxPtr<GameState> res = std::make_shared<ConstructionHelper>();
+		res->m_board = board;
+		res->m_agents = std::move(agents);
+		res->m_initialState = initialState;
+		res->m_turnId = response.turn;
+
+		int32 parityTurn = (mov.first ? 1 : 0) ^ (res->m_turnId % 2);
+		res->m_playerOfTurn = parityTurn ? PlayerColor::Red : PlayerColor::Blue;
+
+		// 陣地は壁だけからは決まらない（囲いを崩しても残る）ので、応答の territories があればそれを使う
+		res->initAreas();
+		res->recalcClosedAreas();
+		if (!response.territories.empty()) {
+			for (int32 r = 0; r < mov.boardHeight; r++) {
+				for (int32 c = 0; c < mov.boardWidth; c++) {
+					int32 territory = response.territories[response.cellIndex(r, c)];
+					res->m_area[PlayerColor::Red][r][c] = (territory & 1) ? 1 : 0;
+					res->m_area[PlayerColor::Blue][r][c] = (territory & 2) ? 1 : 0;
+				}
+			}
+		}
+		else {
+			res->recalcOpenAreas();
+		}
+		res->recalcScores();
+
+		return res;
+	}
 }
@@ -5,6 +5,9 @@
 #include "game_board.hpp"
 #include "game_instructions.hpp"
 #include "request.hpp"
+#include "match_state_response.hpp"
+#include <mutex>
+#include <typeindex>
 
 namespace Procon34 {
 
@@ -52,6 +55,10 @@ namespace Procon34 {
 
 		JSON toJson() const;
 		static GameInitialState FromJson(JSON json);
+
+		// App/data/field の CSV （ 0 : 平地、 1 : 池、 2 : 城、 a : 赤の職人、 b : 青の職人）から盤面と職人の位置を読む。
+		// ほかの値はコンストラクタで決めたまま。読めなければ none
+		static Optional<GameInitialState> FromFieldCsv(FilePathView path);
 	};
 
 
@@ -97,6 +104,20 @@ namespace Procon34 {
 		// 保存された初期状態を取得
 		BoxPtr<const GameInitialState> getInitialState() const;
 
+		// 盤面（壁・職人の位置）とターン番号から計算するハッシュ値。
+		// 同じ局面かどうかの判定（探索の重複除去）に使う。
+		uint64 hash() const;
+
+		// 盤面から計算される値 T を取得する。
+		// 最初に呼ばれたときに T(const GameState&) で計算し、以降は同じものを返す。
+		// makeMove で盤面が変わると捨てられる。複数のスレッドから呼んでよい。
+		template<class T>
+		std::shared_ptr<const T> getComputed() const;
+
+		// 盤面も含めて複製する。
+		// 複製先で makeMove しても元の状態は変わらない。
+		BoxPtr<GameState> clone() const;
+
 		// 初期状態から構築
 		static BoxPtr<GameState> FromInitialState(const GameInitialState& initialState);
 
@@ -107,6 +128,9 @@ namespace Procon34 {
 		// 試合状態取得API の Response
 		static BoxPtr<GameState> FromJson(const JSON& json, const MatchOverview& mov);
 
+		// 同じく MatchStateResponse::parse で読んだもの。盤面を 1 回なめるだけで作る
+		static BoxPtr<GameState> FromResponse(const MatchStateResponse& response, const MatchOverview& mov);
+
 	private:
 		BoxPtr<GameBoard> m_board;
 		EachPlayer<Array<Agent>> m_agents;
@@ -120,6 +144,13 @@ namespace Procon34 {
 		PlayerColor m_playerOfTurn = PlayerColor::Red;
 		int32 m_turnId; // 0 at initial
 
+		// getComputed の保存先。複製した GameState とは makeMove するまで共有する
+		struct ComputedCache {
+			std::mutex mutex;
+			HashTable<std::type_index, std::shared_ptr<const void>> values;
+		};
+		std::shared_ptr<ComputedCache> m_computedCache;
+
 		GameState();
 
 		void initAreas();
@@ -135,4 +166,22 @@ namespace Procon34 {
 
 	};
 
+
+	template<class T>
+	std::shared_ptr<const T> GameState::getComputed() const {
+		auto key = std::type_index(typeid(T));
+		{
+			std::lock_guard lock(m_computedCache->mutex);
+			auto it = m_computedCache->values.find(key);
+			if (it != m_computedCache->values.end()) return std::static_pointer_cast<const T>(it->second);
+		}
+
+		// 計算中はロックを持たない（ T の計算の中で getComputed を呼んでもよい）
+		std::shared_ptr<const void> value = std::make_shared<const T>(*this);
+
+		std::lock_guard lock(m_computedCache->mutex);
+		auto [it, inserted] = m_computedCache->values.emplace(key, std::move(value));
+		return std::static_pointer_cast<const T>(it->second);
+	}
+
 }
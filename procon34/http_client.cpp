@@ -0,0 +1,252 @@
+﻿#include "http_client.hpp"
+#include <cctype>
+#include <chrono>
+
+namespace Procon34 {
+
+	namespace {
+
+		bool EqualsIgnoreCase(std::string_view a, std::string_view b) {
+			if (a.size() != b.size()) return false;
+			for (size_t i = 0; i < a.size(); i++) {
+				if (std::tolower((unsigned char)a[i]) != std::tolower((unsigned char)b[i])) return false;
+			}
+			return true;
+		}
+
+		std::string_view Trim(std::string_view s) {
+			while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+			while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+			return s;
+		}
+
+		// 16 進数または 10 進数の先頭の数字を読む。読めなければ none
+		Optional<size_t> ParseSize(std::string_view s, int32 base) {
+			s = Trim(s);
+			size_t res = 0;
+			size_t digits = 0;
+			for (char ch : s) {
+				int32 d = ('0' <= ch && ch <= '9') ? ch - '0' : (base == 16 && 'a' <= std::tolower((unsigned char)ch) && std::tolower((unsigned char)ch) <= 'f') ? std::tolower((unsigned char)ch) - 'a' + 10 : -1;
+				if (d < 0) break;
+				res = res * base + d;
+				digits++;
+			}
+			if (digits == 0) return none;
+			return res;
+		}
+
+	}
+
+
+	HttpClient::HttpClient(const URL& host, const HashTable<String, String>& headers) {
+		std::string url = host.toUTF8();
+		constexpr std::string_view Scheme = "http://";
+		if (url.substr(0, Scheme.size()) != Scheme) throw Error(U"error at HttpClient : only http:// is supported ({})"_fmt(host));
+		std::string authority = url.substr(Scheme.size());
+		authority = authority.substr(0, authority.find('/'));
+
+		m_port = 80;
+		if (auto colon = authority.rfind(':'); colon != std::string::npos) {
+			auto port = ParseSize(std::string_view(authority).substr(colon + 1), 10);
+			if (!port || *port > 65535) throw Error(U"error at HttpClient : bad port ({})"_fmt(host));
+			m_port = (uint16)*port;
+			m_hostName = authority.substr(0, colon);
+		}
+		else {
+			m_hostName = authority;
+		}
+
+		m_commonHeaders = "Host: " + authority + "\r\n";
+		for (auto& [name, value] : headers) m_commonHeaders += name.toUTF8() + ": " + value.toUTF8() + "\r\n";
+	}
+
+	Optional<HttpClient::Result> HttpClient::get(std::string_view target, Buffers& buffers) {
+		auto& request = buffers.request;
+		request.clear();
+		request.append("GET ").append(target).append(" HTTP/1.1\r\n");
+		request.append(m_commonHeaders);
+		request.append("\r\n");
+		// GET は何度送っても同じなので、送り直してよい
+		return send(buffers, true);
+	}
+
+	Optional<HttpClient::Result> HttpClient::post(std::string_view target, const std::function<void(std::string&)>& writeBody, Buffers& buffers, bool resendIfUnanswered) {
+		// 本体の長さは書いてみるまでわからないので、 Content-Length の欄を空白で取っておいて後から埋める
+		constexpr size_t LengthWidth = 10;
+
+		auto& request = buffers.request;
+		request.clear();
+		request.append("POST ").append(target).append(" HTTP/1.1\r\n");
+		request.append(m_commonHeaders);
+		request.append("Content-Type: application/json\r\n");
+		request.append("Content-Length: ");
+		size_t lengthPos = request.size();
+		request.append(LengthWidth, ' ');
+		request.append("\r\n\r\n");
+
+		size_t bodyBegin = request.size();
+		writeBody(request);
+		std::string length = std::to_string(request.size() - bodyBegin);
+		request.replace(lengthPos + LengthWidth - length.size(), length.size(), length);
+
+		return send(buffers, resendIfUnanswered);
+	}
+
+	HttpClient::Statistics HttpClient::statistics() const {
+		std::lock_guard lock(m_mutex);
+		return m_statistics;
+	}
+
+	Optional<HttpClient::Result> HttpClient::send(Buffers& buffers, bool resendIfUnanswered) {
+		using Clock = std::chrono::steady_clock;
+		auto begin = Clock::now();
+
+		// 溜めておいた接続はサーバー側で閉じられていることがある。
+		// 何も受け取れなかったときだけ、新しい接続でもう一度送る（ resendIfUnanswered のときだけ。
+		// 閉じられる前に届いていれば、サーバーはもう受け付けているかもしれない）
+		for (int32 attempt = 0; attempt < 2; attempt++) {
+			bool reused = false;
+			auto socket = acquire(attempt == 0, reused);
+			if (!socket) break;
+
+			bool keepAlive = false;
+			Optional<int32> status;
+			if (socket.sendAll(buffers.request.data(), buffers.request.size())) {
+				status = ReceiveResponse(socket, buffers, keepAlive);
+			}
+			if (!status) {
+				if (reused && buffers.received.empty()) {
+					// サーバーが再起動したなどで、ほかの溜めておいた接続も使えないことが多い
+					{
+						std::lock_guard lock(m_mutex);
+						m_idleConnections.clear();
+					}
+					if (resendIfUnanswered) continue;
+				}
+				break;
+			}
+
+			Result res{ .status = *status, .latencyMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - begin).count(), .reusedConnection = reused };
+
+			std::lock_guard lock(m_mutex);
+			if (keepAlive) m_idleConnections.push_back(std::move(socket));
+			m_statistics.requestCount++;
+			m_statistics.totalLatencyMilliseconds += res.latencyMilliseconds;
+			m_statistics.maxLatencyMilliseconds = Max(m_statistics.maxLatencyMilliseconds, res.latencyMilliseconds);
+			return res;
+		}
+
+		std::lock_guard lock(m_mutex);
+		m_statistics.failureCount++;
+		return none;
+	}
+
+	TcpSocket HttpClient::acquire(bool allowReuse, bool& reused) {
+		{
+			std::lock_guard lock(m_mutex);
+			if (allowReuse && !m_idleConnections.empty()) {
+				reused = true;
+				auto socket = std::move(m_idleConnections.back());
+				m_idleConnections.pop_back();
+				return socket;
+			}
+			m_statistics.connectCount++;
+		}
+
+		reused = false;
+		auto socket = TcpSocket::Connect(m_hostName, m_port, ConnectTimeoutMilliseconds);
+		if (socket) {
+			socket.setNoDelay();
+			socket.setReceiveTimeout(ReceiveTimeoutMilliseconds);
+		}
+		return socket;
+	}
+
+	Optional<int32> HttpClient::ReceiveResponse(const TcpSocket& socket, Buffers& buffers, bool& keepAlive) {
+		auto& received = buffers.received;
+		received.clear();
+
+		size_t headerEnd;
+		while ((headerEnd = received.find("\r\n\r\n")) == std::string::npos) {
+			if (!socket.receiveMore(received)) return none;
+		}
+
+		// "HTTP/1.1 200 OK"
+		std::string_view header(received.data(), headerEnd);
+		size_t lineEnd = header.find("\r\n");
+		std::string_view statusLine = header.substr(0, lineEnd);
+		size_t space = statusLine.find(' ');
+		if (space == std::string_view::npos) return none;
+		auto status = ParseSize(statusLine.substr(space + 1), 10);
+		if (!status) return none;
+		keepAlive = statusLine.substr(0, space) != "HTTP/1.0";
+
+		Optional<size_t> contentLength;
+		bool chunked = false;
+		for (size_t pos = lineEnd + 2; pos < headerEnd;) {
+			size_t end = Min(header.find("\r\n", pos), headerEnd);
+			std::string_view line = header.substr(pos, end - pos);
+			size_t colon = line.find(':');
+			if (colon != std::string_view::npos) {
+				auto name = line.substr(0, colon);
+				auto value = Trim(line.substr(colon + 1));
+				if (EqualsIgnoreCase(name, "content-length")) contentLength = ParseSize(value, 10);
+				else if (EqualsIgnoreCase(name, "transfer-encoding")) chunked = EqualsIgnoreCase(value, "chunked");
+				else if (EqualsIgnoreCase(name, "connection")) keepAlive = !EqualsIgnoreCase(value, "close");
+			}
+			pos = end + 2;
+		}
+
+		size_t bodyBegin = headerEnd + 4;
+		buffers.bodyBegin = bodyBegin;
+
+		if (chunked) {
+			// 各チャンクの本体を前に詰めながら読む
+			size_t write = bodyBegin;
+			size_t read = bodyBegin;
+			while (true) {
+				size_t sizeEnd;
+				while ((sizeEnd = received.find("\r\n", read)) == std::string::npos) {
+					if (!socket.receiveMore(received)) return none;
+				}
+				auto chunkSize = ParseSize(std::string_view(received).substr(read, sizeEnd - read), 16);
+				if (!chunkSize) return none;
+				read = sizeEnd + 2;
+				if (*chunkSize == 0) {
+					// 最後のチャンクの後ろのトレイラーを、空行まで読み捨てる
+					while (true) {
+						size_t end;
+						while ((end = received.find("\r\n", read)) == std::string::npos) {
+							if (!socket.receiveMore(received)) return none;
+						}
+						bool emptyLine = end == read;
+						read = end + 2;
+						if (emptyLine) break;
+					}
+					break;
+				}
+				while (received.size() < read + *chunkSize + 2) {
+					if (!socket.receiveMore(received)) return none;
+				}
+				std::copy(received.begin() + read, received.begin() + read + *chunkSize, received.begin() + write);
+				write += *chunkSize;
+				read += *chunkSize + 2;
+			}
+			buffers.bodySize = write - bodyBegin;
+		}
+		else if (contentLength) {
+			while (received.size() < bodyBegin + *contentLength) {
+				if (!socket.receiveMore(received)) return none;
+			}
+			buffers.bodySize = *contentLength;
+		}
+		else {
+			// 長さがわからなければ、接続が閉じられるまでが本体
+			while (socket.receiveMore(received)) {}
+			buffers.bodySize = received.size() - bodyBegin;
+			keepAlive = false;
+		}
+		return (int32)*status;
+	}
+
+}
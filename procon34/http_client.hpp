@@ -0,0 +1,88 @@
+﻿#pragma once
+#include "stdafx.h"
+#include "tcp_socket.hpp"
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+// 1 つのホストに HTTP/1.1 で要求を送るクライアント。
+// 接続は keep-alive で使い回し（空いている接続を溜めておく）、同時に複数のスレッドから使ってよい。
+// SimpleHTTP は要求のたびに接続し直すので、試合状態取得API を細かく問い合わせるときに接続の時間が無視できない。
+// http:// だけに対応する（競技サーバーは https ではない）。
+
+namespace Procon34 {
+
+	class HttpClient {
+	public:
+
+		// host : "http://localhost:3000" の形
+		// headers : すべての要求に付けるヘッダ（ procon-token など）
+		HttpClient(const URL& host, const HashTable<String, String>& headers);
+
+		// 要求と応答を組み立てるバッファ。要求のたびに中身だけ消して使い回す（試合ごとに 1 つ持つ）
+		struct Buffers {
+			std::string request;
+			std::string received; // 応答（ヘッダと本体）
+			size_t bodyBegin = 0;
+			size_t bodySize = 0;
+
+			// 直前の応答の本体
+			std::string_view body() const { return std::string_view(received).substr(bodyBegin, bodySize); }
+		};
+
+		struct Result {
+			int32 status;
+			double latencyMilliseconds; // 要求を送り始めてから応答を読み終わるまで（接続する時間を含む）
+			bool reusedConnection; // keep-alive で残っていた接続を使ったか
+
+			bool isOK() const { return status == 200; }
+		};
+
+		// GET target 。つながらなければ none
+		Optional<Result> get(std::string_view target, Buffers& buffers);
+
+		// POST target 。本体は writeBody が buffers.request の後ろに直接書く（ content-type は application/json ）。
+		// 溜めておいた接続で応答が何も来なかったとき、サーバーが受け付けたかはわからないので、送り直すかは resendIfUnanswered で決める
+		Optional<Result> post(std::string_view target, const std::function<void(std::string&)>& writeBody, Buffers& buffers, bool resendIfUnanswered = false);
+
+		// これまでの要求の時間の集計
+		struct Statistics {
+			int32 requestCount = 0;
+			int32 failureCount = 0;
+			int32 connectCount = 0; // 新しく接続した回数
+			double totalLatencyMilliseconds = 0.0;
+			double maxLatencyMilliseconds = 0.0;
+
+			double meanLatencyMilliseconds() const { return requestCount ? totalLatencyMilliseconds / requestCount : 0.0; }
+		};
+		Statistics statistics() const;
+
+		// 接続を待つ時間の上限
+		static constexpr int32 ConnectTimeoutMilliseconds = 2000;
+
+		// 応答を待つ時間の上限
+		static constexpr int32 ReceiveTimeoutMilliseconds = 5000;
+
+	private:
+
+		std::string m_hostName;
+		uint16 m_port;
+		std::string m_commonHeaders; // "Host: ...\r\n" とすべての要求に付けるヘッダ。最初に 1 回だけ組み立てる
+
+		mutable std::mutex m_mutex;
+		Array<TcpSocket> m_idleConnections;
+		Statistics m_statistics;
+
+		// buffers.request を送り、応答を buffers.received に読む。
+		// resendIfUnanswered なら、溜めておいた接続で何も受け取れなかったときに新しい接続で 1 回だけ送り直す
+		Optional<Result> send(Buffers& buffers, bool resendIfUnanswered);
+
+		// 溜めておいた接続を取り出す。なければ（ allowReuse が false なら）新しく接続する
+		TcpSocket acquire(bool allowReuse, bool& reused);
+
+		// 応答を読み、 buffers.bodyBegin と bodySize を決める。 keepAlive は続けて使える接続か
+		static Optional<int32> ReceiveResponse(const TcpSocket& socket, Buffers& buffers, bool& keepAlive);
+	};
+
+}
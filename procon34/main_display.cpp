@@ -12,6 +12,7 @@
 #include "match_viewer.hpp"
 
 #include "request.hpp"
+#include "match_interactor.hpp"
 
 
 namespace Procon34 {
@@ -98,188 +99,6 @@ namespace Procon34 {
 	} // anonymous namespace
 
 
-	namespace {
-
-		MatchRecord ConstructRecordFromReceivedData(
-			MatchOverview overview,
-			JSON receivedState
-		) {
-			auto state = GameState::FromJson(receivedState, overview);
-			auto initialState = state->getInitialState();
-
-			MatchRecord res;
-			res.initialState = *initialState;
-			res.turns.resize(initialState->turnCount);
-
-			AgentInstructionRecord defval;
-			defval.type = U"Stay";
-			defval.direction = unspecified;
-			for (auto& a : res.turns) a.instructions.assign(initialState->agentPos[PlayerColor::Red].size(), defval);
-
-			for (auto turn : receivedState[U"logs"].arrayView()) {
-				int32 turnId = turn[U"turn"].get<int32>() - 1;
-				int32 i = 0;
-				for (auto ag : turn[U"actions"].arrayView()) {
-					auto& result = res.turns[turnId].instructions[i];
-					if (ag[U"succeeded"].get<bool>()) {
-						int32 dir = ag[U"dir"].get<int32>();
-						int32 type = ag[U"type"].get<int32>();
-						if (type == 1) {
-							result.type = U"Move";
-							result.direction = MoveDirection((12 - dir) % 8);
-						}
-						else if (type == 2) {
-							result.type = U"Construct";
-							result.direction = MoveDirection((12 - dir) % 8);
-						}
-						else if (type == 3) {
-							result.type = U"Destroy";
-							result.direction = MoveDirection((12 - dir) % 8);
-						}
-						else {
-							result.type = U"Stay";
-							result.direction = unspecified;
-						}
-					}
-					i++;
-				}
-			}
-
-			return res;
-		}
-
-	}
-
-
-	namespace {
-
-		struct MatchInteractor {
-		private:
-
-			const MatchOverview m_matchOverview;
-			std::shared_ptr<SolverInterface> m_solver;
-
-			// これより上のメンバは、 readonly として、 mutex で保護されない。
-
-			std::mutex m_mutexForAllInfo;
-			int32 m_lastTurnProcessed;
-			bool m_messageToEnd;
-
-			std::thread m_solverThread;
-			MatchRecord m_record;
-
-			// m_mutexForAllInfo は、これより上のメンバを保護する
-
-			std::mutex m_mutexForErrMsg;
-			String m_lastError;
-
-
-			void run() {
-				while (true) {
-					// エラーが出たらエラーメッセージを更新して
-					//    500 msec 待つ。
-					try {
-						while (true) {
-							{
-								auto lck = std::lock_guard(m_mutexForAllInfo);
-								if (m_messageToEnd) return;
-							}
-
-							JSON matchesIdResponse = getMatchesState(m_matchOverview.id).value_or(JSON());
-
-							int32 nextTurn = matchesIdResponse[U"turn"].get<int32>();
-
-							auto info = getAllInfo();
-
-							if (info.lastTurn != nextTurn) {
-								auto lck = std::lock_guard(m_mutexForAllInfo);
-								m_record = ConstructRecordFromReceivedData(info.matchOverview, matchesIdResponse);
-
-								if (nextTurn % 2 == (info.matchOverview.first ? 0 : 1) && nextTurn < info.matchOverview.turns) {
-
-									auto gameState = GameState::FromJson(matchesIdResponse, info.matchOverview);
-									auto instruction = m_solver->operator()(gameState);
-
-									auto instructionJson = instruction.toJson();
-									postAgentActions(info.matchOverview.id, instructionJson);
-
-								}
-							}
-
-							{
-								auto lck = std::lock_guard(m_mutexForAllInfo);
-								m_lastTurnProcessed = nextTurn;
-							}
-							System::Sleep(500.0ms);
-						}
-					}
-					catch (const Error& e) {
-						auto lck = std::lock_guard(m_mutexForErrMsg);
-						m_lastError = e.what();
-						Console << U"--- ";
-						Console << U"!!! ERROR !!!";
-						Console << m_lastError;
-						Console << U"--- ";
-					}
-					System::Sleep(500.0ms);
-				}
-			}
-
-		public:
-
-			MatchInteractor(
-				MatchOverview matchOverview,
-				std::shared_ptr<SolverInterface> solver
-			)
-				: m_matchOverview(matchOverview)
-				, m_solver(solver)
-				, m_lastTurnProcessed(-1)
-				, m_messageToEnd(false)
-				, m_lastError(U"")
-			{
-				m_solverThread = std::thread(std::function<void()>([this]() { this->run(); }));
-			}
-
-			~MatchInteractor() {
-				stop();
-			}
-
-			String getErrorMessage() {
-				auto lck = std::lock_guard(m_mutexForErrMsg);
-				return m_lastError;
-			}
-
-			void stop() {
-				{
-					auto lck = std::lock_guard(m_mutexForAllInfo);
-					m_messageToEnd = true;
-				}
-				m_solverThread.join();
-			}
-
-			struct ProgressInfo {
-				MatchOverview matchOverview;
-				int32 lastTurn;
-			};
-
-			ProgressInfo getAllInfo() {
-				auto lck = std::lock_guard(m_mutexForAllInfo);
-				ProgressInfo res;
-				res.matchOverview = m_matchOverview;
-				res.lastTurn = m_lastTurnProcessed;
-				return res;
-			}
-
-			MatchRecord getMatchRecord() {
-				auto lck = std::lock_guard(m_mutexForAllInfo);
-				return m_record;
-			}
-		};
-
-	} // namespace
-	// for MatchInteractor
-
-
 	class MainDisplayImpl {
 
 
@@ -457,39 +276,8 @@ namespace Procon34 {
 			GameInitialState createGameInitialState() {
 				GameInitialState res;
 				if (!menu_field.isEmpty()) {
-					res.agentPos[PlayerColor::Red].clear();
-					res.agentPos[PlayerColor::Blue].clear();
-					{
-						String fieldCsvPath = fieldSearchPath + U"/" + menu_field.getItem();
-						auto csv = CSV(fieldCsvPath);
-						int32 h = (int32)csv.rows();
-						int32 w = (int32)csv.columns(0);
-						res.boardHeight = h;
-						res.boardWidth = w;
-						res.biomeGrid.assign(Size(w, h), MassBiome::Normal);
-						for (int32 r = 0; r < h; r++) for (int32 c = 0; c < w; c++) {
-							BoardPos pos = BoardPos(r, c);
-							Point posp = pos.asPoint();
-							String s = csv.get(r, c);
-							if (s == U"0") {
-								res.biomeGrid[posp] = MassBiome::Normal;
-							}
-							if (s == U"1") {
-								res.biomeGrid[posp] = MassBiome::Pond;
-							}
-							if (s == U"2") {
-								res.biomeGrid[posp] = MassBiome::Castle;
-							}
-							if (s == U"a") {
-								res.biomeGrid[posp] = MassBiome::Normal;
-								res.agentPos[PlayerColor::Red].push_back(pos);
-							}
-							if (s == U"b") {
-								res.biomeGrid[posp] = MassBiome::Normal;
-								res.agentPos[PlayerColor::Blue].push_back(pos);
-							}
-						}
-					}
+					String fieldCsvPath = fieldSearchPath + U"/" + menu_field.getItem();
+					res = GameInitialState::FromFieldCsv(fieldCsvPath).value_or(res);
 					res.turnTimeLimitInMiliseconds = 3000;
 					res.firstToMove = PlayerColor::Red;
 					res.wallCoefficient = 10;
@@ -547,6 +335,7 @@ namespace Procon34 {
 			Array<Optional<MatchOverview>> matchOverviews;
 			Array<int32> insertAwait;
 			std::list<std::pair<int32, std::shared_ptr<MatchInteractor>>> interactors; // leave したときのフラグをつける
+			std::shared_ptr<MatchScheduler> scheduler = std::make_shared<MatchScheduler>(); // すべての試合の探索で共有する
 			Vec2 scrollOffset = Vec2(0.0, 0.0);
 
 			bool reloadButtonClickBuffer = false;
@@ -582,7 +371,8 @@ namespace Procon34 {
 				// 選択された試合に接続
 				for (size_t i = 0; i < matchOverviews.size(); i++) if (overviewButtonClicked[i] != 0) {
 					auto solver = Procon34::SolverInterface::ListOfSolvers().back();
-					interactors.emplace_back(0, std::make_shared<MatchInteractor>(matchOverviews[i].value(), solver));
+					auto ponderSolverFactory = []() { return Procon34::SolverInterface::ListOfSolvers().back(); };
+					interactors.emplace_back(0, std::make_shared<MatchInteractor>(matchOverviews[i].value(), solver, ponderSolverFactory, scheduler));
 				}
 
 				if (reloadButtonClickBuffer) {
@@ -602,8 +392,9 @@ namespace Procon34 {
 
 				for(auto iter = interactors.begin(); iter != interactors.end(); ){
 					auto [flag, interactor] = *iter;
-					if (flag != 0) {
-						interactor->stop();
+					// 探索の途中なら終わるのを待たずに、あとのフレームで消す
+					if (flag != 0) interactor->requestStop();
+					if (flag != 0 && interactor->isFinished()) {
 						iter = interactors.erase(iter);
 					}
 					else {
@@ -689,8 +480,11 @@ namespace Procon34 {
 					)).draw(Arg::leftCenter(currentLT + Vec2(buttonw + 10.0, BasicRowHeight * 0.5) - scrollOffset), Palette::White);
 					currentLT.y += BasicRowHeight;
 
-					font(U"vs. {}"_fmt(
-						overview.opponent
+					// 直前のターンの変化に気づくまでにかかった時間（上限）
+					String detectionText = info.lastDetection ? U" . detected in {:.0f}ms"_fmt(info.lastDetection->maxDelayMilliseconds) : U"";
+					font(U"vs. {}{}"_fmt(
+						overview.opponent,
+						detectionText
 					)).draw(Arg::leftCenter(currentLT + Vec2(buttonw + 10.0, BasicRowHeight * 0.5) - scrollOffset), Palette::White);
 					currentLT.y += BasicRowHeight;
 
@@ -0,0 +1,266 @@
+﻿#include "match_interactor.hpp"
+#include "game_state.hpp"
+#include "solvers/pondering.hpp"
+#include "solvers/shorten_move.hpp"
+#include "solvers/solver_executor.hpp"
+#include <condition_variable>
+#include <future>
+#include <mutex>
+
+
+namespace Procon34 {
+
+	namespace {
+
+		// 探索のスレッドが見つけた指示を、送るスレッドへ渡す。送っている間に見つかったものは最新の 1 つだけ残す
+		class PendingInstruction {
+		public:
+
+			void put(const TurnInstruction& instruction) {
+				{
+					std::lock_guard lock(m_mutex);
+					m_instruction = instruction;
+				}
+				m_condition.notify_one();
+			}
+
+			// 探索が終わったことを伝える
+			void finish() {
+				{
+					std::lock_guard lock(m_mutex);
+					m_finished = true;
+				}
+				m_condition.notify_one();
+			}
+
+			// 新しい指示が来るか、探索が終わるまで待つ。終わっていて残っていなければ none
+			Optional<TurnInstruction> take() {
+				std::unique_lock lock(m_mutex);
+				m_condition.wait(lock, [&]() { return m_instruction.has_value() || m_finished; });
+				Optional<TurnInstruction> res = m_instruction;
+				m_instruction.reset();
+				return res;
+			}
+
+		private:
+			std::mutex m_mutex;
+			std::condition_variable m_condition;
+			Optional<TurnInstruction> m_instruction;
+			bool m_finished = false;
+		};
+
+	}
+
+
+	template<class F>
+	void MatchInteractor::publish(F&& update) {
+		auto next = std::make_shared<Snapshot>(*m_snapshot.load());
+		update(*next);
+		m_snapshot.store(std::move(next));
+	}
+
+
+	void MatchInteractor::run() {
+		bool startedAtApplied = false;
+		int32 lastTurnProcessed = -1;
+		while (true) {
+			// エラーが出たらエラーメッセージを更新して
+			//    500 msec 待つ。
+			try {
+				while (true) {
+					if (m_messageToEnd) {
+						if (m_scheduler) m_scheduler->removeMatch(m_matchOverview.id);
+						m_finished = true;
+						return;
+					}
+
+					auto sentAt = PollingScheduler::Clock::now();
+					if (!getMatchesState(m_matchOverview.id, m_requestBuffers, m_response)) {
+						throw Error(U"failed to get the match state");
+					}
+					auto receivedAt = PollingScheduler::Clock::now();
+
+					int32 nextTurn = m_response.turn;
+
+					if (!startedAtApplied && m_response.startedAtUnixTime) {
+						m_pollingScheduler.setStartedAtUnixTime(*m_response.startedAtUnixTime);
+						startedAtApplied = true;
+					}
+
+					// ターンが始まってから気づくまでの時間を記録する
+					if (auto detection = m_pollingScheduler.onResponse(nextTurn, sentAt, receivedAt)) {
+						Console << U"Turn #{} detected {:.0f}-{:.0f} ms after it started ({} polls)"_fmt(detection->turn, detection->minDelayMilliseconds, detection->maxDelayMilliseconds, detection->pollCount);
+						publish([&](Snapshot& next) {
+							auto detections = std::make_shared<Array<PollingScheduler::TurnDetection>>(*next.turnDetections);
+							detections->push_back(*detection);
+							next.turnDetections = std::move(detections);
+							next.progress.lastDetection = *detection;
+						});
+					}
+
+					// 新しい行動ログだけを手元の局面に適用する
+					m_sync.update(m_response);
+
+					if (lastTurnProcessed != nextTurn) {
+						// 探索の前に記録を公開しておく（探索の間も GUI は新しい盤面を表示できる）
+						auto record = std::make_shared<const MatchRecord>(m_sync.record());
+						publish([&](Snapshot& next) { next.record = record; });
+
+						bool isMyTurn = nextTurn % 2 == (m_matchOverview.first ? 0 : 1);
+
+						// ほかの試合と探索の時間が重なるかを見積もれるように、手番の予定を伝える
+						auto turnZeroStart = m_pollingScheduler.expectedTurnStart(0);
+						if (m_scheduler && turnZeroStart) {
+							m_scheduler->setTimeline(m_matchOverview.id, *turnZeroStart, std::chrono::seconds(m_matchOverview.turnSeconds), m_matchOverview.first ? 0 : 1, m_matchOverview.turns);
+						}
+
+						if (isMyTurn && nextTurn < m_matchOverview.turns) {
+
+							auto gameState = m_sync.snapshot();
+
+							// ターンが終わる時刻から余裕を引いたものを、送り直してよい期限とする
+							auto turnEnd = m_pollingScheduler.expectedTurnStart(nextTurn + 1).value_or(receivedAt + std::chrono::seconds(m_matchOverview.turnSeconds));
+							auto deadline = turnEnd - std::chrono::milliseconds(PostSafetyMarginMilliseconds);
+
+							// 前に送ったものと違う指示だけを、期限までに送る（期限を過ぎていても、まだ何も送っていなければ送る）
+							std::string postedBody;
+							std::string body;
+							auto postIfChanged = [&](const TurnInstruction& instruction) {
+								if (!postedBody.empty() && PollingScheduler::Clock::now() > deadline) return;
+								body.clear();
+								instruction.appendJson(body);
+								if (body == postedBody) return;
+								if (postAgentActions(m_matchOverview.id, instruction, m_requestBuffers)) postedBody = body;
+							};
+
+							// 先読みが当たっていれば、その答えを送る
+							bool answered = false;
+							if (m_pondering) {
+								if (auto answer = m_pondering->take(gameState)) {
+									postIfChanged(answer->instruction);
+									m_solver = answer->solver;
+									answered = true;
+								}
+							}
+							if (!answered) {
+								// まず探索しない指示をすぐに送り、ソルバーがよりよい指示を見つけるたびに送り直す
+								postIfChanged(GreedyInstruction(gameState));
+
+								// 期限の早い試合の探索から順に、スレッドの割り当てを受けて解く
+								Optional<MatchScheduler::Ticket> ticket;
+								if (m_scheduler) ticket.emplace(m_scheduler->acquire(m_matchOverview.id, deadline));
+								Optional<uint32> concurrency = ticket ? Optional<uint32>(ticket->cores()) : none;
+
+								// 探索は別のスレッドで進め、このスレッドは見つかった指示を送る（送信の往復の間も探索を止めず、探索の時間にも数えない）
+								auto cancellationToken = std::make_shared<CancellationToken>(deadline);
+								PendingInstruction pending;
+								auto solved = std::async(std::launch::async, [&]() {
+									SolverExecutor::ScopedConcurrency scopedConcurrency(concurrency);
+									try {
+										auto res = m_solver->solveAnytime(gameState, cancellationToken, [&](const TurnInstruction& instruction) { pending.put(instruction); });
+										pending.finish();
+										return res;
+									}
+									catch (...) {
+										pending.finish();
+										throw;
+									}
+								});
+								while (auto instruction = pending.take()) postIfChanged(*instruction);
+								postIfChanged(solved.get());
+							}
+
+						}
+						else if (!isMyTurn && m_pondering && nextTurn + 1 < m_matchOverview.turns) {
+							// 相手の手番の間に、自分の次の手を読んでおく（手番の探索に割り当てられていないスレッドで）
+							Optional<uint32> concurrency;
+							if (m_scheduler) {
+								auto opponentTurnEnd = m_pollingScheduler.expectedTurnStart(nextTurn + 1).value_or(receivedAt + std::chrono::seconds(m_matchOverview.turnSeconds));
+								concurrency = m_scheduler->backgroundCores(m_matchOverview.id, opponentTurnEnd);
+							}
+							m_pondering->start(m_sync.snapshot(), concurrency);
+						}
+
+						lastTurnProcessed = nextTurn;
+						publish([&](Snapshot& next) { next.progress.lastTurn = nextTurn; });
+					}
+
+					// ターンの境目が近ければ細かく、遠ければ間を空けて問い合わせる
+					System::Sleep(Duration(m_pollingScheduler.nextWait(PollingScheduler::Clock::now())));
+				}
+			}
+			catch (const Error& e) {
+				String message = e.what();
+				publish([&](Snapshot& next) { next.lastError = message; });
+				Console << U"--- ";
+				Console << U"!!! ERROR !!!";
+				Console << message;
+				Console << U"--- ";
+			}
+			System::Sleep(500.0ms);
+		}
+	}
+
+
+	MatchInteractor::MatchInteractor(
+		MatchOverview matchOverview,
+		std::shared_ptr<SolverInterface> solver,
+		SolverFactory ponderSolverFactory,
+		std::shared_ptr<MatchScheduler> scheduler
+	)
+		: m_matchOverview(matchOverview)
+		, m_scheduler(scheduler)
+		, m_solver(solver)
+		, m_pondering(ponderSolverFactory ? std::make_unique<Pondering>(ponderSolverFactory, 2, (uint64)matchOverview.id) : nullptr)
+		, m_pollingScheduler(matchOverview.turnSeconds, matchOverview.turns)
+		, m_sync(matchOverview)
+		, m_snapshot(std::make_shared<const Snapshot>(Snapshot{
+			.progress = ProgressInfo{ .matchOverview = matchOverview, .lastTurn = -1, .lastDetection = none },
+			.record = std::make_shared<const MatchRecord>(),
+			.turnDetections = std::make_shared<const Array<PollingScheduler::TurnDetection>>(),
+			.lastError = U"",
+		}))
+		, m_messageToEnd(false)
+		, m_finished(false)
+	{
+		m_solverThread = std::thread(std::function<void()>([this]() { this->run(); }));
+	}
+
+	MatchInteractor::~MatchInteractor() {
+		stop();
+	}
+
+	String MatchInteractor::getErrorMessage() {
+		return snapshot()->lastError;
+	}
+
+	void MatchInteractor::stop() {
+		requestStop();
+		if (m_solverThread.joinable()) m_solverThread.join();
+	}
+
+	void MatchInteractor::requestStop() {
+		m_messageToEnd = true;
+	}
+
+	bool MatchInteractor::isFinished() const {
+		return m_finished;
+	}
+
+	std::shared_ptr<const MatchInteractor::Snapshot> MatchInteractor::snapshot() const {
+		return m_snapshot.load();
+	}
+
+	MatchInteractor::ProgressInfo MatchInteractor::getAllInfo() {
+		return snapshot()->progress;
+	}
+
+	Array<PollingScheduler::TurnDetection> MatchInteractor::getTurnDetections() {
+		return *snapshot()->turnDetections;
+	}
+
+	MatchRecord MatchInteractor::getMatchRecord() {
+		return *snapshot()->record;
+	}
+
+}
@@ -0,0 +1,109 @@
+﻿#pragma once
+#include "stdafx.h"
+#include "game_simulator.hpp"
+#include "request.hpp"
+#include "polling_scheduler.hpp"
+#include "match_sync.hpp"
+#include "match_scheduler.hpp"
+#include "solvers/solver_list.hpp"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+
+
+namespace Procon34 {
+
+	class Pondering;
+
+
+	// 1 つの試合についてサーバーの状態を取得し続け、自分の手番が来たらソルバーで指示を作って送る。
+	// 通信と探索は専用のスレッドで行う。
+	//
+	// 進み具合・記録・エラーは、変更しない Snapshot として専用のスレッドが丸ごと作り直して公開する（ atomic な shared_ptr ）。
+	// GUI から読む側はロックを待たず、探索はロックを持たずに走る。
+	class MatchInteractor {
+	public:
+
+		using SolverFactory = std::function<std::shared_ptr<SolverInterface>()>;
+
+		// ponderSolverFactory を与えると、相手の手番の間に相手の行動を予想して自分の手を先に解いておく（ Pondering ）。
+		// 予想が当たれば、 solver の代わりにその局面を解いたソルバーを以後の手番で使う。
+		// scheduler を与えると、ほかの試合と合わせて期限の早い順に探索し、探索ごとに使うスレッドの数を決めてもらう
+		MatchInteractor(
+			MatchOverview matchOverview,
+			std::shared_ptr<SolverInterface> solver,
+			SolverFactory ponderSolverFactory = nullptr,
+			std::shared_ptr<MatchScheduler> scheduler = nullptr
+		);
+
+		~MatchInteractor();
+
+		// 自分の手番では、ソルバーがよりよい指示を見つけるたびに送り直す。ターンが終わるこれだけ前からは送らない
+		static constexpr int32 PostSafetyMarginMilliseconds = 300;
+
+		String getErrorMessage();
+
+		// 止めて、スレッドが終わるまで待つ
+		void stop();
+
+		// 止めるよう伝えるだけで待たない。終わったかは isFinished で確かめる
+		void requestStop();
+
+		bool isFinished() const;
+
+		struct ProgressInfo {
+			MatchOverview matchOverview;
+			int32 lastTurn;
+			Optional<PollingScheduler::TurnDetection> lastDetection;
+		};
+
+		// ある時点での状態。公開したあとは変更しないので、受け取った側はいつまで持っていてもよい
+		struct Snapshot {
+			ProgressInfo progress;
+			std::shared_ptr<const MatchRecord> record;
+			std::shared_ptr<const Array<PollingScheduler::TurnDetection>> turnDetections; // ターンの変化を検出するまでにかかった時間（ターンごと）
+			String lastError;
+		};
+
+		// 最新の状態。待たずにすぐ返る
+		std::shared_ptr<const Snapshot> snapshot() const;
+
+		ProgressInfo getAllInfo();
+
+		// ターンの変化を検出するまでにかかった時間の記録（ターンごと）
+		Array<PollingScheduler::TurnDetection> getTurnDetections();
+
+		MatchRecord getMatchRecord();
+
+	private:
+
+		const MatchOverview m_matchOverview;
+		const std::shared_ptr<MatchScheduler> m_scheduler;
+
+		// これより上のメンバは、 readonly として、 mutex で保護されない。
+
+		// m_solver 、 m_pondering 、 m_pollingScheduler 、 m_sync 、 m_requestBuffers 、 m_response は m_solverThread だけが触る
+		std::shared_ptr<SolverInterface> m_solver;
+		std::unique_ptr<Pondering> m_pondering;
+		PollingScheduler m_pollingScheduler;
+		MatchSync m_sync;
+		HttpClient::Buffers m_requestBuffers;
+		MatchStateResponse m_response;
+
+		// 書くのは m_solverThread だけ（ publish ）。読むのはどのスレッドからでもよい
+		std::atomic<std::shared_ptr<const Snapshot>> m_snapshot;
+
+		std::atomic<bool> m_messageToEnd;
+		std::atomic<bool> m_finished;
+
+		std::thread m_solverThread;
+
+		void run();
+
+		// 最新の Snapshot を複製して update で書き換え、差し替える
+		template<class F>
+		void publish(F&& update);
+	};
+
+}
@@ -0,0 +1,116 @@
+﻿#include "match_scheduler.hpp"
+#include "solvers/solver_executor.hpp"
+#include <utility>
+
+namespace Procon34 {
+
+	MatchScheduler::MatchScheduler(Optional<uint32> coreCount, uint32 minCoresPerSolve)
+		: m_coreCount(Max<uint32>(1, coreCount.value_or(SolverExecutor::ThreadCount())))
+		, m_minCoresPerSolve(Clamp<uint32>(minCoresPerSolve, 1, m_coreCount))
+	{}
+
+	void MatchScheduler::setTimeline(int64 matchId, Clock::time_point turnZeroStart, Clock::duration turnLength, int32 myFirstTurn, int32 turnCount) {
+		if (turnLength <= Clock::duration::zero()) throw Error(U"error at MatchScheduler::setTimeline : turnLength must be positive");
+		std::lock_guard lock(m_mutex);
+		m_timelines[matchId] = Timeline{ .turnZeroStart = turnZeroStart, .turnLength = turnLength, .myFirstTurn = myFirstTurn, .turnCount = turnCount };
+	}
+
+	void MatchScheduler::removeMatch(int64 matchId) {
+		std::lock_guard lock(m_mutex);
+		m_timelines.erase(matchId);
+	}
+
+	MatchScheduler::Ticket::Ticket(Ticket&& other) noexcept
+		: m_owner(std::exchange(other.m_owner, nullptr))
+		, m_cores(other.m_cores)
+	{}
+
+	MatchScheduler::Ticket::~Ticket() {
+		if (m_owner) m_owner->release(m_cores);
+	}
+
+	MatchScheduler::Ticket MatchScheduler::acquire(int64 matchId, Clock::time_point deadline) {
+		auto requestedAt = Clock::now();
+		auto waitUntil = requestedAt + Max(Clock::duration::zero(), (deadline - requestedAt) / 2);
+
+		std::unique_lock lock(m_mutex);
+		uint64 sequence = m_nextSequence++;
+		m_waiters.push_back(Waiter{ .matchId = matchId, .deadline = deadline, .sequence = sequence });
+
+		// 期限が最も早く、空きがあれば始める
+		auto admissible = [&]() { return isFirstWaiter(sequence) && m_usedCores + m_minCoresPerSolve <= m_coreCount; };
+		bool waited = false;
+		while (!admissible()) {
+			waited = true;
+			if (m_released.wait_until(lock, waitUntil) == std::cv_status::timeout) break;
+		}
+		bool oversubscribed = !admissible();
+		m_waiters.remove_if([&](const Waiter& w) { return w.sequence == sequence; });
+
+		uint32 cores = oversubscribed ? m_minCoresPerSolve : shareOf(matchId, Clock::now(), deadline);
+		m_usedCores += cores;
+
+		m_statistics.solveCount++;
+		if (waited) m_statistics.waitedCount++;
+		if (oversubscribed) m_statistics.oversubscribedCount++;
+		m_statistics.maxWaitMilliseconds = Max(m_statistics.maxWaitMilliseconds, std::chrono::duration<double, std::milli>(Clock::now() - requestedAt).count());
+
+		// 次に期限の早いものが始められるかもしれない
+		m_released.notify_all();
+		return Ticket(this, cores);
+	}
+
+	uint32 MatchScheduler::backgroundCores(int64 matchId, Clock::time_point until) const {
+		std::lock_guard lock(m_mutex);
+		return shareOf(matchId, Clock::now(), until);
+	}
+
+	MatchScheduler::Statistics MatchScheduler::statistics() const {
+		std::lock_guard lock(m_mutex);
+		return m_statistics;
+	}
+
+	int32 MatchScheduler::overlappingMatchCount(int64 matchId, Clock::time_point from, Clock::time_point to) const {
+		int32 res = 1;
+		for (auto& [id, timeline] : m_timelines) {
+			if (id == matchId) continue;
+
+			// from と to を含むターンの番号（切り捨て）
+			auto turnAt = [&](Clock::time_point t) -> int64 {
+				int64 elapsed = (t - timeline.turnZeroStart).count();
+				int64 length = timeline.turnLength.count();
+				return elapsed >= 0 ? elapsed / length : -((-elapsed + length - 1) / length);
+			};
+			int64 first = Max<int64>(0, turnAt(from));
+			int64 last = Min<int64>(timeline.turnCount - 1, turnAt(to));
+			for (int64 turn = first; turn <= last; turn++) {
+				if (turn % 2 == timeline.myFirstTurn) {
+					res++;
+					break;
+				}
+			}
+		}
+		return res;
+	}
+
+	uint32 MatchScheduler::shareOf(int64 matchId, Clock::time_point from, Clock::time_point to) const {
+		uint32 equalShare = m_coreCount / (uint32)overlappingMatchCount(matchId, from, to);
+		uint32 idle = m_usedCores < m_coreCount ? m_coreCount - m_usedCores : 0;
+		return Max(m_minCoresPerSolve, Min(equalShare, idle));
+	}
+
+	bool MatchScheduler::isFirstWaiter(uint64 sequence) const {
+		const Waiter* first = nullptr;
+		for (auto& waiter : m_waiters) {
+			if (!first || waiter.deadline < first->deadline || (waiter.deadline == first->deadline && waiter.sequence < first->sequence)) first = &waiter;
+		}
+		return first && first->sequence == sequence;
+	}
+
+	void MatchScheduler::release(uint32 cores) {
+		std::lock_guard lock(m_mutex);
+		m_usedCores -= Min(cores, m_usedCores);
+		m_released.notify_all();
+	}
+
+}
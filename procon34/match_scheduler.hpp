@@ -0,0 +1,110 @@
+﻿#pragma once
+#include "stdafx.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace Procon34 {
+
+	// 同時に進んでいる複数の試合の探索に、共有のプール (SolverExecutor) のスレッドを割り当てる。
+	//
+	// 探索は答えを送る期限の早い順 (EDF) に始め、それぞれに同時に使うスレッドの数（割り当て）を決める。
+	// 割り当ては、その探索の間に自分の手番が重なる試合の数でスレッドを等分したもの（空いている分まで）。
+	// 試合ごとの手番の予定は、 MatchInteractor が検出したターンの開始時刻と turnSeconds から見積もる。
+	// 空きが足りなければ、期限の早いものから順に、ほかの探索が終わるのを待つ。
+	// プロセスで 1 つ持ち、すべての MatchInteractor に渡す。複数のスレッドから同時に使ってよい。
+	class MatchScheduler {
+	public:
+
+		using Clock = std::chrono::steady_clock;
+
+		// coreCount : 探索に使うスレッドの数。 none なら SolverExecutor::ThreadCount()
+		// minCoresPerSolve : 1 回の探索に割り当てる最小の数
+		MatchScheduler(Optional<uint32> coreCount = none, uint32 minCoresPerSolve = 1);
+
+		MatchScheduler(const MatchScheduler&) = delete;
+		MatchScheduler& operator=(const MatchScheduler&) = delete;
+
+		// 試合の手番の予定を伝える（ターンを検出するたびに呼んでよい）。
+		// turnZeroStart : ターン 0 が始まった時刻の見当
+		// myFirstTurn : 自分の最初の手番 (0 か 1)
+		void setTimeline(int64 matchId, Clock::time_point turnZeroStart, Clock::duration turnLength, int32 myFirstTurn, int32 turnCount);
+
+		// 試合をやめた。予定を忘れる
+		void removeMatch(int64 matchId);
+
+		// 探索 1 回ぶんの割り当て。破棄すると返す
+		class Ticket {
+		public:
+			Ticket(Ticket&& other) noexcept;
+			Ticket& operator=(Ticket&&) = delete;
+			Ticket(const Ticket&) = delete;
+			~Ticket();
+
+			// 同時に使ってよいスレッドの数（ SolverExecutor::ScopedConcurrency に渡す）
+			uint32 cores() const { return m_cores; }
+
+		private:
+			friend class MatchScheduler;
+			Ticket(MatchScheduler* owner, uint32 cores) : m_owner(owner), m_cores(cores) {}
+
+			MatchScheduler* m_owner;
+			uint32 m_cores;
+		};
+
+		// 試合 matchId の、 deadline までに答えが要る探索を始める。順番が来るまで待って割り当てを返す。
+		// 期限までの時間の半分を待っても順番が来なければ、空きがなくても最小の割り当てで始める（何も読まないよりよい）
+		Ticket acquire(int64 matchId, Clock::time_point deadline);
+
+		// 先読みなど急がない探索に、 until までの間使ってよいスレッドの数（予約はしない）
+		uint32 backgroundCores(int64 matchId, Clock::time_point until) const;
+
+		uint32 coreCount() const { return m_coreCount; }
+
+		struct Statistics {
+			int32 solveCount = 0;
+			int32 waitedCount = 0; // 空きを待った回数
+			int32 oversubscribedCount = 0; // 待ちきれずに空きがないまま始めた回数
+			double maxWaitMilliseconds = 0.0;
+		};
+		Statistics statistics() const;
+
+	private:
+
+		struct Timeline {
+			Clock::time_point turnZeroStart;
+			Clock::duration turnLength;
+			int32 myFirstTurn;
+			int32 turnCount;
+		};
+
+		struct Waiter {
+			int64 matchId;
+			Clock::time_point deadline;
+			uint64 sequence; // 期限が同じなら先に来たもの
+		};
+
+		uint32 m_coreCount;
+		uint32 m_minCoresPerSolve;
+
+		mutable std::mutex m_mutex;
+		std::condition_variable m_released;
+		HashTable<int64, Timeline> m_timelines;
+		Array<Waiter> m_waiters;
+		uint32 m_usedCores = 0;
+		uint64 m_nextSequence = 0;
+		Statistics m_statistics;
+
+		// [from, to) の間に自分の手番がある試合の数（ matchId を含む）。予定を伝えていない試合は数えない
+		int32 overlappingMatchCount(int64 matchId, Clock::time_point from, Clock::time_point to) const;
+
+		// matchId が [from, to) の間に使ってよい数（等分した数と空いている数の小さいほう）
+		uint32 shareOf(int64 matchId, Clock::time_point from, Clock::time_point to) const;
+
+		// 待っているもののうち期限が最も早いものか
+		bool isFirstWaiter(uint64 sequence) const;
+
+		void release(uint32 cores);
+	};
+
+}
@@ -0,0 +1,246 @@
+﻿#include "match_state_response.hpp"
+
+namespace Procon34 {
+
+	namespace {
+
+		// 応答の本体を先頭から読む。読めないところに来たら以降はすべて失敗する
+		class Reader {
+		public:
+
+			Reader(std::string_view text) : m_text(text) {}
+
+			bool ok() const { return m_ok; }
+
+			bool fail() { m_ok = false; return false; }
+
+			bool atEnd() {
+				skipWhitespace();
+				return m_pos == m_text.size();
+			}
+
+			// 次の文字が ch なら読み進めて true
+			bool consume(char ch) {
+				skipWhitespace();
+				if (m_ok && m_pos < m_text.size() && m_text[m_pos] == ch) {
+					m_pos++;
+					return true;
+				}
+				return false;
+			}
+
+			bool expect(char ch) {
+				return consume(ch) || fail();
+			}
+
+			// オブジェクトの各メンバについて、キーを渡して onMember を呼ぶ。 onMember は値を読み進める
+			template<class F>
+			bool readObject(F&& onMember) {
+				if (!expect('{')) return false;
+				if (consume('}')) return true;
+				do {
+					std::string_view key;
+					if (!readString(key) || !expect(':') || !onMember(key)) return fail();
+				} while (consume(','));
+				return expect('}');
+			}
+
+			// 配列の各要素について onElement を呼ぶ。 onElement は値を読み進める
+			template<class F>
+			bool readArray(F&& onElement) {
+				if (!expect('[')) return false;
+				if (consume(']')) return true;
+				do {
+					if (!onElement()) return fail();
+				} while (consume(','));
+				return expect(']');
+			}
+
+			// 文字列。エスケープはそのまま（キーの比較にしか使わない）
+			bool readString(std::string_view& out) {
+				if (!expect('"')) return false;
+				size_t begin = m_pos;
+				while (m_pos < m_text.size() && m_text[m_pos] != '"') {
+					if (m_text[m_pos] == '\\') m_pos++;
+					m_pos++;
+				}
+				if (m_pos >= m_text.size()) return fail();
+				out = m_text.substr(begin, m_pos - begin);
+				m_pos++;
+				return true;
+			}
+
+			// 整数。小数部や指数部があれば失敗する
+			template<class T>
+			bool readInteger(T& out) {
+				skipWhitespace();
+				bool negative = false;
+				if (m_pos < m_text.size() && m_text[m_pos] == '-') {
+					negative = true;
+					m_pos++;
+				}
+				size_t begin = m_pos;
+				int64 val = 0;
+				while (m_pos < m_text.size() && '0' <= m_text[m_pos] && m_text[m_pos] <= '9') {
+					val = val * 10 + (m_text[m_pos] - '0');
+					m_pos++;
+				}
+				if (m_pos == begin) return fail();
+				if (m_pos < m_text.size() && (m_text[m_pos] == '.' || m_text[m_pos] == 'e' || m_text[m_pos] == 'E')) return fail();
+				out = (T)(negative ? -val : val);
+				return true;
+			}
+
+			bool readBool(bool& out) {
+				skipWhitespace();
+				if (m_text.substr(m_pos, 4) == "true") {
+					m_pos += 4;
+					out = true;
+					return true;
+				}
+				if (m_text.substr(m_pos, 5) == "false") {
+					m_pos += 5;
+					out = false;
+					return true;
+				}
+				return fail();
+			}
+
+			// null なら読み進めて true
+			bool consumeNull() {
+				skipWhitespace();
+				if (m_ok && m_text.substr(m_pos, 4) == "null") {
+					m_pos += 4;
+					return true;
+				}
+				return false;
+			}
+
+			// 2 次元の整数の配列を行優先で out に書く。行の長さがそろっていなければ失敗する
+			bool readGrid(Array<int32>& out, int32& rows, int32& columns) {
+				out.clear();
+				rows = 0;
+				columns = -1;
+				return readArray([&]() {
+					size_t rowBegin = out.size();
+					bool res = readArray([&]() { return readInteger(out.emplace_back()); });
+					int32 length = (int32)(out.size() - rowBegin);
+					if (columns == -1) columns = length;
+					rows++;
+					return res && length == columns;
+				});
+			}
+
+			// 使わない値を読み飛ばす
+			bool skipValue(int32 depth = 0) {
+				if (depth > 64) return fail();
+				skipWhitespace();
+				if (m_pos >= m_text.size()) return fail();
+				char ch = m_text[m_pos];
+				if (ch == '{') {
+					return readObject([&](std::string_view) { return skipValue(depth + 1); });
+				}
+				if (ch == '[') {
+					return readArray([&]() { return skipValue(depth + 1); });
+				}
+				if (ch == '"') {
+					std::string_view dummy;
+					return readString(dummy);
+				}
+				// 数・ true ・ false ・ null
+				size_t begin = m_pos;
+				while (m_pos < m_text.size() && std::string_view(",}] \t\r\n").find(m_text[m_pos]) == std::string_view::npos) m_pos++;
+				return m_pos != begin || fail();
+			}
+
+		private:
+			std::string_view m_text;
+			size_t m_pos = 0;
+			bool m_ok = true;
+
+			void skipWhitespace() {
+				while (m_pos < m_text.size() && (m_text[m_pos] == ' ' || m_text[m_pos] == '\t' || m_text[m_pos] == '\r' || m_text[m_pos] == '\n')) m_pos++;
+			}
+		};
+
+	}
+
+
+	bool MatchStateResponse::parse(std::string_view body) {
+		startedAtUnixTime = none;
+		width = height = mason = 0;
+		structures.clear();
+		masons.clear();
+		walls.clear();
+		territories.clear();
+		logs.clear();
+		actions.clear();
+
+		bool hasTurn = false;
+		bool hasBoard = false;
+
+		// 盤面の各 2 次元配列の大きさ（ width と height に合うか後で確かめる）
+		struct Shape { int32 rows = 0; int32 columns = 0; };
+		Shape shapes[4];
+		Array<int32>* grids[4] = { &structures, &masons, &walls, &territories };
+
+		auto readBoard = [&](Reader& reader) {
+			hasBoard = true;
+			return reader.readObject([&](std::string_view key) {
+				if (key == "width") return reader.readInteger(width);
+				if (key == "height") return reader.readInteger(height);
+				if (key == "mason") return reader.readInteger(mason);
+				if (key == "structures") return reader.readGrid(*grids[0], shapes[0].rows, shapes[0].columns);
+				if (key == "masons") return reader.readGrid(*grids[1], shapes[1].rows, shapes[1].columns);
+				if (key == "walls") return reader.readGrid(*grids[2], shapes[2].rows, shapes[2].columns);
+				if (key == "territories") return reader.readGrid(*grids[3], shapes[3].rows, shapes[3].columns);
+				return reader.skipValue();
+			});
+		};
+
+		auto readAction = [&](Reader& reader) {
+			auto& action = actions.emplace_back(Action{ .type = 0, .dir = 0, .succeeded = false });
+			return reader.readObject([&](std::string_view key) {
+				if (key == "type") return reader.readInteger(action.type);
+				if (key == "dir") return reader.readInteger(action.dir);
+				if (key == "succeeded") return reader.readBool(action.succeeded);
+				return reader.skipValue();
+			});
+		};
+
+		auto readLogEntry = [&](Reader& reader) {
+			LogEntry entry{ .turn = 0, .actionBegin = (int32)actions.size(), .actionCount = 0 };
+			bool res = reader.readObject([&](std::string_view key) {
+				if (key == "turn") return reader.readInteger(entry.turn);
+				if (key == "actions") return reader.readArray([&]() { return readAction(reader); });
+				return reader.skipValue();
+			});
+			entry.actionCount = (int32)actions.size() - entry.actionBegin;
+			logs.push_back(entry);
+			return res;
+		};
+
+		Reader reader(body);
+		bool res = reader.readObject([&](std::string_view key) {
+			if (key == "id") return reader.readInteger(id);
+			if (key == "turn") return hasTurn = reader.readInteger(turn);
+			if (key == "startedAtUnixTime") {
+				// 開始前は null
+				if (reader.consumeNull()) return true;
+				return reader.readInteger(startedAtUnixTime.emplace());
+			}
+			if (key == "board") return readBoard(reader);
+			if (key == "logs") return reader.readArray([&]() { return readLogEntry(reader); });
+			return reader.skipValue();
+		});
+		if (!res || !reader.atEnd() || !hasTurn || !hasBoard) return false;
+
+		// 盤面の配列は、あればすべて height 行 width 列
+		for (int32 i = 0; i < 4; i++) {
+			if (grids[i]->empty()) continue;
+			if (shapes[i].rows != height || shapes[i].columns != width) return false;
+		}
+		return !structures.empty() && !masons.empty() && !walls.empty();
+	}
+
+}
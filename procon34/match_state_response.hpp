@@ -0,0 +1,49 @@
+﻿#pragma once
+#include "stdafx.h"
+#include <string_view>
+
+namespace Procon34 {
+
+	// 試合状態取得API (GET /matches/{id}) の応答。
+	//
+	// parse は本体の文字列を先頭から 1 回なめるだけで、 JSON の木を作らない。
+	// 盤面は行優先の 1 次元配列（ GameBoard の中身と同じ並び）に直接書く。
+	// 同じインスタンスで parse を繰り返すと、配列の領域を使い回す（試合ごとに 1 つ持つ）。
+	struct MatchStateResponse {
+
+		struct Action {
+			int32 type; // 0 : 滞在、 1 : 移動、 2 : 建築、 3 : 解体
+			int32 dir; // 1 から 8 （ 0 は無方向）
+			bool succeeded;
+		};
+
+		// 行動ログ 1 ターン分。行動は actions[actionBegin, actionBegin + actionCount)
+		struct LogEntry {
+			int32 turn;
+			int32 actionBegin;
+			int32 actionCount;
+		};
+
+		int64 id = 0;
+		int32 turn = 0;
+		Optional<int64> startedAtUnixTime;
+
+		int32 width = 0;
+		int32 height = 0;
+		int32 mason = 0;
+		Array<int32> structures; // 0 : なし、 1 : 池、 2 : 城
+		Array<int32> masons; // 味方は正、相手は負、いなければ 0
+		Array<int32> walls; // 0 : なし、 1 : 味方、 2 : 相手
+		Array<int32> territories; // 0 : なし、 1 : 味方、 2 : 相手、 3 : 両方
+
+		Array<LogEntry> logs;
+		Array<Action> actions;
+
+		// 盤面の配列での添え字
+		size_t cellIndex(int32 r, int32 c) const { return (size_t)r * width + c; }
+
+		// 本体 body を読む。形が違えば false を返し、中身は途中まで書かれている
+		bool parse(std::string_view body);
+	};
+
+}
@@ -0,0 +1,164 @@
+﻿#include "match_sync.hpp"
+
+namespace Procon34 {
+
+	namespace {
+
+		// 応答の行動 (type, dir) を AgentMove に直す。失敗した行動は滞在とする
+		AgentMove DecodeAction(const MatchStateResponse::Action& action, Agent agent) {
+			if (!action.succeeded) return AgentMove::GetStay(agent);
+			int32 type = action.type;
+			if (type == 0) return AgentMove::GetStay(agent);
+			auto dir = MoveDirection((12 - action.dir) % 8);
+			if (type == 1) return AgentMove::GetMove(agent, dir);
+			if (type == 2) return AgentMove::GetConstruct(agent, dir);
+			return AgentMove::GetDestroy(agent, dir);
+		}
+
+	}
+
+
+	MatchSync::MatchSync(MatchOverview overview)
+		: m_overview(overview)
+	{}
+
+	bool MatchSync::update(const MatchStateResponse& response) {
+		int32 turn = response.turn;
+		if (m_state && turn == m_turn) return false;
+
+		if (!m_state) initialize(response);
+
+		// 新しいログは後ろにあるので、後ろから見てまだ取り込んでいない最初のものを探す
+		const auto& logs = response.logs;
+		size_t begin = logs.size();
+		while (begin > 0 && logs[begin - 1].turn > m_recordedTurn) begin--;
+
+		for (size_t i = begin; i < logs.size(); i++) {
+			const auto& entry = logs[i];
+			record(response, entry);
+			m_recordedTurn = entry.turn;
+
+			if (entry.turn > turn) continue;
+			// ログが抜けているターンは全員滞在とする
+			while (m_state->getTurnIndex() + 1 < entry.turn) applyStay();
+			if (m_state->getTurnIndex() + 1 == entry.turn) apply(response, entry);
+		}
+		while (m_state->getTurnIndex() < turn && !m_state->isOver()) applyStay();
+
+		if (m_state->getTurnIndex() != turn || !matchesServerBoard(response)) {
+			Console << U"MatchSync : local state diverged from the server at turn {} , rebuilding"_fmt(turn);
+			m_state = GameState::FromResponse(response, m_overview);
+			m_resyncCount++;
+		}
+		m_turn = turn;
+		return true;
+	}
+
+	BoxPtr<GameState> MatchSync::snapshot() const {
+		if (!m_state) return nullptr;
+		return m_state->clone();
+	}
+
+	void MatchSync::initialize(const MatchStateResponse& response) {
+		GameInitialState initialState;
+		initialState.boardWidth = m_overview.boardWidth;
+		initialState.boardHeight = m_overview.boardHeight;
+		initialState.castleCoefficient = m_overview.bonusCastle;
+		initialState.teritorryCoefficient = m_overview.bonusTerritory;
+		initialState.wallCoefficient = m_overview.bonusWall;
+		initialState.turnCount = m_overview.turns;
+		initialState.turnTimeLimitInMiliseconds = m_overview.turnSeconds * 1000;
+		initialState.firstToMove = m_overview.first ? PlayerColor::Red : PlayerColor::Blue;
+		initialState.agentPos[PlayerColor::Red] = m_overview.myAgentPos;
+		initialState.agentPos[PlayerColor::Blue] = m_overview.opponentAgentPos;
+		initialState.biomeGrid.assign(Size(m_overview.boardWidth, m_overview.boardHeight), MassBiome::Normal);
+
+		if (response.width != m_overview.boardWidth || response.height != m_overview.boardHeight) {
+			throw Error(U"MatchSync : board size differs from the match overview");
+		}
+		for (int32 r = 0; r < m_overview.boardHeight; r++) {
+			for (int32 c = 0; c < m_overview.boardWidth; c++) {
+				int32 biome = response.structures[response.cellIndex(r, c)];
+				initialState.biomeGrid[r][c] = biome == 0 ? MassBiome::Normal : biome == 1 ? MassBiome::Pond : MassBiome::Castle;
+			}
+		}
+
+		m_state = GameState::FromInitialState(initialState);
+
+		m_record = MatchRecord();
+		m_record.initialState = initialState;
+		m_record.turns.resize(initialState.turnCount);
+		AgentInstructionRecord defval;
+		defval.type = U"Stay";
+		defval.direction = unspecified;
+		for (auto& a : m_record.turns) a.instructions.assign(initialState.agentPos[PlayerColor::Red].size(), defval);
+		m_recordedTurn = 0;
+	}
+
+	void MatchSync::record(const MatchStateResponse& response, const MatchStateResponse::LogEntry& entry) {
+		int32 turnId = entry.turn - 1;
+		if (turnId < 0 || (int32)m_record.turns.size() <= turnId) return;
+
+		auto& instructions = m_record.turns[turnId].instructions;
+		int32 i = 0;
+		for (int32 k = 0; k < entry.actionCount; k++) {
+			if ((int32)instructions.size() <= i) break;
+			const auto& action = response.actions[entry.actionBegin + k];
+			auto& result = instructions[i++];
+			result.type = U"Stay";
+			result.direction = unspecified;
+			if (!action.succeeded) continue;
+
+			int32 type = action.type;
+			if (type == 0) continue;
+			result.type = type == 1 ? U"Move" : type == 2 ? U"Construct" : U"Destroy";
+			result.direction = MoveDirection((12 - action.dir) % 8);
+		}
+	}
+
+	void MatchSync::apply(const MatchStateResponse& response, const MatchStateResponse::LogEntry& entry) {
+		auto player = m_state->whosTurn();
+		auto agents = m_state->getAgents(player);
+
+		TurnInstruction instruction(m_state, player);
+		size_t i = 0;
+		for (int32 k = 0; k < entry.actionCount; k++) {
+			if (agents.size() <= i) break;
+			instruction.insert(DecodeAction(response.actions[entry.actionBegin + k], agents[i]));
+			i++;
+		}
+		m_state->makeMove(player, instruction);
+	}
+
+	void MatchSync::applyStay() {
+		auto player = m_state->whosTurn();
+		m_state->makeMove(player, TurnInstruction(m_state, player));
+	}
+
+	bool MatchSync::matchesServerBoard(const MatchStateResponse& response) const {
+		int32 height = m_overview.boardHeight;
+		int32 width = m_overview.boardWidth;
+
+		// 職人はいる場所だけ比べ、残りは数で確かめる
+		int32 agentCount = 0;
+		for (auto color : { PlayerColor::Red, PlayerColor::Blue }) {
+			for (auto& agent : m_state->getAgents(color)) {
+				int32 expected = color == PlayerColor::Red ? agent.marker.index + 1 : -(agent.marker.index + 1);
+				if (response.masons[response.cellIndex(agent.pos.r, agent.pos.c)] != expected) return false;
+				agentCount++;
+			}
+		}
+
+		auto& localBoard = *m_state->getBoard();
+		for (int32 r = 0; r < height; r++) {
+			for (int32 c = 0; c < width; c++) {
+				size_t cell = response.cellIndex(r, c);
+				auto& wall = localBoard[BoardPos(r, c)].wall;
+				if (response.walls[cell] != (!wall ? 0 : wall->color == PlayerColor::Red ? 1 : 2)) return false;
+				if (response.masons[cell] != 0) agentCount--;
+			}
+		}
+		return agentCount == 0;
+	}
+
+}
@@ -0,0 +1,60 @@
+﻿#pragma once
+#include "stdafx.h"
+#include "game_state.hpp"
+#include "game_simulator.hpp"
+#include "request.hpp"
+#include "match_state_response.hpp"
+
+namespace Procon34 {
+
+	// 試合状態取得API の応答から、試合の局面と記録を手元で少しずつ更新する。
+	//
+	// 手元に GameState を 1 つ持ち、応答の logs のうちまだ適用していないターンだけを makeMove で進める。
+	// 応答の盤面（壁と職人）は確かめるだけに使い、合わなければ GameState::FromResponse で作り直す。
+	// 1 回の問い合わせでの手間は、試合が進んでも増えない（ターンが変わらなければ何もしない）。
+	class MatchSync {
+	public:
+
+		MatchSync(MatchOverview overview);
+
+		// 応答を取り込む。ターンが進んだ（または初めて取り込んだ）ら true
+		bool update(const MatchStateResponse& response);
+
+		// 取り込んだ最新のターン。まだ何も取り込んでいなければ -1
+		int32 turn() const { return m_turn; }
+
+		// 最新の局面の複製（ソルバーなどに渡してよい）。まだ何も取り込んでいなければ nullptr
+		BoxPtr<GameState> snapshot() const;
+
+		// これまでの行動ログを並べた試合の記録
+		const MatchRecord& record() const { return m_record; }
+
+		// 手元の局面がサーバーと合わず、作り直した回数
+		int32 resyncCount() const { return m_resyncCount; }
+
+	private:
+
+		MatchOverview m_overview;
+		BoxPtr<GameState> m_state;
+		MatchRecord m_record;
+		int32 m_turn = -1;
+		int32 m_recordedTurn = 0; // 記録に書いた行動ログの最後のターン
+		int32 m_resyncCount = 0;
+
+		// 試合開始時の局面を作る（盤面の地形は応答の structures から）
+		void initialize(const MatchStateResponse& response);
+
+		// 行動ログ 1 ターン分を記録に書く
+		void record(const MatchStateResponse& response, const MatchStateResponse::LogEntry& entry);
+
+		// 行動ログ 1 ターン分を手元の局面に適用する
+		void apply(const MatchStateResponse& response, const MatchStateResponse::LogEntry& entry);
+
+		// 手元の局面を 1 ターン進める（全員滞在）
+		void applyStay();
+
+		// 応答の盤面と手元の局面が同じか（壁と職人の位置を比べる）
+		bool matchesServerBoard(const MatchStateResponse& response) const;
+	};
+
+}
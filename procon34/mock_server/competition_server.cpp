@@ -0,0 +1,297 @@
+﻿#include "competition_server.hpp"
+#include "match_json.hpp"
+#include "../solvers/shorten_move.hpp"
+#include <charconv>
+
+namespace Procon34 {
+
+	namespace MockServer {
+
+		namespace {
+
+			HttpResponse ErrorResponse(int32 status, std::string_view message) {
+				return HttpResponse{ .status = status, .body = "{\"message\":\"" + std::string(message) + "\"}" };
+			}
+
+			// "/matches/{id}" の id 。形が違えば none
+			Optional<int64> ParseMatchId(std::string_view path) {
+				constexpr std::string_view Prefix = "/matches/";
+				if (!path.starts_with(Prefix)) return none;
+				path.remove_prefix(Prefix.size());
+				int64 id = 0;
+				auto [end, error] = std::from_chars(path.data(), path.data() + path.size(), id);
+				if (error != std::errc() || end != path.data() + path.size()) return none;
+				return id;
+			}
+
+			double MillisecondsBetween(CompetitionServer::Clock::time_point from, CompetitionServer::Clock::time_point to) {
+				return std::chrono::duration<double, std::milli>(to - from).count();
+			}
+
+			int64 UnixTimeNow() {
+				return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+			}
+
+		}
+
+
+		CompetitionServer::CompetitionServer(const Config& config)
+			: m_config(config)
+			, m_rng(config.seed)
+		{
+			m_server = std::make_unique<LocalHttpServer>(m_config.port, [this](const HttpRequest& request) { return handle(request); });
+			m_tickThread = std::thread([this]() { tickLoop(); });
+		}
+
+		CompetitionServer::~CompetitionServer() {
+			stop();
+		}
+
+		void CompetitionServer::stop() {
+			m_server->stop();
+			{
+				std::lock_guard lock(m_tickMutex);
+				m_stopping = true;
+			}
+			m_tickCondition.notify_all();
+			if (m_tickThread.joinable()) m_tickThread.join();
+		}
+
+		int64 CompetitionServer::addMatch(const GameInitialState& initialState, String opponent, std::chrono::milliseconds startDelay) {
+			auto match = std::make_shared<Match>();
+			match->opponent = opponent;
+			match->turnSeconds = Max(1, (initialState.turnTimeLimitInMiliseconds + 500) / 1000);
+			match->startedAt = Clock::now() + startDelay;
+			match->startedAtUnixTime = std::chrono::duration_cast<std::chrono::seconds>((std::chrono::system_clock::now() + startDelay).time_since_epoch()).count();
+			match->turnStartedAt = match->startedAt;
+			match->state = GameState::FromInitialState(initialState);
+			{
+				std::lock_guard lock(m_matchesMutex);
+				match->id = (int64)m_matches.size() + 1;
+				match->overviewBody = MatchOverviewToJson(match->id, *match->state, PlayerColor::Red, match->turnSeconds, opponent).formatUTF8();
+				UpdateStateBody(*match);
+				m_matches.push_back(match);
+			}
+
+			// 時刻を待っている tickLoop に、新しい試合を見させる
+			{
+				std::lock_guard lock(m_tickMutex);
+			}
+			m_tickCondition.notify_all();
+			return match->id;
+		}
+
+		bool CompetitionServer::isFinished() const {
+			std::lock_guard lock(m_matchesMutex);
+			return m_matches.all([](const std::shared_ptr<Match>& match) {
+				std::lock_guard matchLock(match->mutex);
+				return match->state->isOver();
+			});
+		}
+
+		CompetitionServer::Statistics CompetitionServer::statistics() const {
+			std::lock_guard lock(m_statisticsMutex);
+			return m_statistics;
+		}
+
+		HttpResponse CompetitionServer::handle(const HttpRequest& request) {
+			// 落とす要求と遅れは、処理する前に決める
+			bool drop = false;
+			int32 delayMilliseconds = m_config.latencyMilliseconds;
+			{
+				std::lock_guard lock(m_statisticsMutex);
+				m_statistics.requestCount++;
+				if (m_config.dropRate > 0.0 && std::uniform_real_distribution<double>(0.0, 1.0)(m_rng) < m_config.dropRate) {
+					m_statistics.droppedCount++;
+					drop = true;
+				}
+				if (m_config.jitterMilliseconds > 0) delayMilliseconds += (int32)(m_rng() % (uint64)m_config.jitterMilliseconds);
+			}
+			if (drop) return HttpResponse{ .drop = true };
+			if (delayMilliseconds > 0) std::this_thread::sleep_for(std::chrono::milliseconds(delayMilliseconds));
+
+			auto token = request.headers.find("procon-token");
+			if (token == request.headers.end() || token->second != m_config.token) return ErrorResponse(401, "invalid token");
+
+			std::string_view path = request.target;
+			path = path.substr(0, path.find('?'));
+
+			if (path == "/matches") {
+				if (request.method != "GET") return ErrorResponse(400, "unsupported method");
+				return getMatches();
+			}
+
+			auto id = ParseMatchId(path);
+			if (!id) return ErrorResponse(404, "not found");
+			auto match = findMatch(*id);
+			if (!match) return ErrorResponse(404, "match not found");
+
+			if (request.method == "GET") return getMatch(*match);
+			if (request.method == "POST") return postMatch(*match, request.body);
+			return ErrorResponse(400, "unsupported method");
+		}
+
+		HttpResponse CompetitionServer::getMatches() {
+			HttpResponse res;
+			res.body = "{\"matches\":[";
+			std::lock_guard lock(m_matchesMutex);
+			for (size_t i = 0; i < m_matches.size(); i++) {
+				if (i != 0) res.body += ',';
+				// overviewBody は作ったあと変わらない
+				res.body += m_matches[i]->overviewBody;
+			}
+			res.body += "]}";
+			return res;
+		}
+
+		HttpResponse CompetitionServer::getMatch(Match& match) {
+			std::lock_guard lock(match.mutex);
+			if (Clock::now() < match.startedAt) return ErrorResponse(425, "the match has not started yet");
+			return HttpResponse{ .body = match.stateBody };
+		}
+
+		HttpResponse CompetitionServer::postMatch(Match& match, const std::string& body) {
+			auto reject = [&](std::string_view message) {
+				std::lock_guard lock(m_statisticsMutex);
+				m_statistics.rejectedPostCount++;
+				return ErrorResponse(400, message);
+			};
+
+			JSON json = JSON::Parse(Unicode::FromUTF8(body));
+			if (json.isInvalid() || !json[U"actions"].isArray()) return reject("invalid body");
+
+			std::lock_guard lock(match.mutex);
+			auto now = Clock::now();
+			if (now < match.startedAt) return ErrorResponse(425, "the match has not started yet");
+
+			auto& state = match.state;
+			if (state->isOver() || state->whosTurn() != PlayerColor::Red) return reject("not your turn");
+
+			TurnInstruction instruction(state, PlayerColor::Red);
+			try {
+				if (json[U"turn"].get<int32>() != state->getTurnIndex() + 1) return reject("wrong turn");
+
+				auto agents = state->getAgents(PlayerColor::Red);
+				auto actions = json[U"actions"].arrayView();
+				if (actions.size() != agents.size()) return reject("wrong number of actions");
+
+				for (size_t i = 0; i < agents.size(); i++) {
+					int32 type = actions[i][U"type"].get<int32>();
+					int32 dir = actions[i][U"dir"].get<int32>();
+					if (type == 0) {
+						instruction.insert(AgentMove::GetStay(agents[i]));
+						continue;
+					}
+					if (type < 0 || 3 < type || dir < 1 || 8 < dir) return reject("invalid action");
+
+					// 建築と解体は上下左右だけ
+					auto moveDir = MoveDirection((12 - dir) % 8);
+					if (type != 1 && moveDir.value() % 2 != 0) return reject("invalid action");
+
+					if (type == 1) instruction.insert(AgentMove::GetMove(agents[i], moveDir));
+					else if (type == 2) instruction.insert(AgentMove::GetConstruct(agents[i], moveDir));
+					else instruction.insert(AgentMove::GetDestroy(agents[i], moveDir));
+				}
+			}
+			catch (const Error&) {
+				return reject("invalid body");
+			}
+
+			match.pending = instruction;
+			double sinceTurnStart = MillisecondsBetween(match.turnStartedAt, now);
+			if (!match.firstPostMilliseconds) match.firstPostMilliseconds = sinceTurnStart;
+			match.lastPostMilliseconds = sinceTurnStart;
+			{
+				std::lock_guard statisticsLock(m_statisticsMutex);
+				m_statistics.postCount++;
+			}
+			return HttpResponse{ .body = "{\"accepted_at\":" + std::to_string(UnixTimeNow()) + "}" };
+		}
+
+		std::shared_ptr<CompetitionServer::Match> CompetitionServer::findMatch(int64 id) const {
+			std::lock_guard lock(m_matchesMutex);
+			if (id < 1 || (int64)m_matches.size() < id) return nullptr;
+			return m_matches[(size_t)(id - 1)];
+		}
+
+		void CompetitionServer::tickLoop() {
+			std::unique_lock lock(m_tickMutex);
+			while (!m_stopping) {
+				Array<std::shared_ptr<Match>> matches;
+				{
+					std::lock_guard matchesLock(m_matchesMutex);
+					matches = m_matches;
+				}
+
+				// 時刻が来たターンを終わらせ、次にターンが終わる時刻を求める
+				auto now = Clock::now();
+				Optional<Clock::time_point> nextTurnEnd;
+				for (auto& match : matches) {
+					std::lock_guard matchLock(match->mutex);
+					while (!match->state->isOver()) {
+						auto turnEnd = match->startedAt + std::chrono::seconds(match->turnSeconds) * (match->state->getTurnIndex() + 1);
+						if (now < turnEnd) {
+							nextTurnEnd = nextTurnEnd ? Min(*nextTurnEnd, turnEnd) : turnEnd;
+							break;
+						}
+						advanceTurn(*match);
+					}
+				}
+
+				// 相手の手番になった試合では、相手の行動を決めておく（盤面を写してから、試合の mutex を持たずに）
+				for (auto& match : matches) {
+					BoxPtr<GameState> state;
+					{
+						std::lock_guard matchLock(match->mutex);
+						if (match->state->isOver() || match->state->whosTurn() != PlayerColor::Blue || match->pending) continue;
+						state = match->state->clone();
+					}
+					auto instruction = GreedyInstruction(state);
+					std::lock_guard matchLock(match->mutex);
+					if (match->state->getTurnIndex() == state->getTurnIndex()) match->pending = instruction;
+				}
+
+				if (nextTurnEnd) m_tickCondition.wait_until(lock, *nextTurnEnd);
+				else m_tickCondition.wait(lock);
+			}
+		}
+
+		void CompetitionServer::advanceTurn(Match& match) {
+			auto& state = match.state;
+			auto player = state->whosTurn();
+
+			// 行動計画がなければ全員滞在
+			TurnInstruction instruction(state, player);
+			if (match.pending) instruction = *match.pending;
+			else for (auto& agent : state->getAgents(player)) instruction.insert(AgentMove::GetStay(agent));
+
+			match.logs.push_back(MakeMoveWithLog(*state, player, instruction));
+
+			if (player == PlayerColor::Red) {
+				std::lock_guard lock(m_statisticsMutex);
+				m_statistics.ownTurnCount++;
+				if (match.firstPostMilliseconds) {
+					m_statistics.firstPostMilliseconds.push_back(*match.firstPostMilliseconds);
+					m_statistics.lastPostMilliseconds.push_back(*match.lastPostMilliseconds);
+				}
+				else {
+					m_statistics.missedTurnCount++;
+				}
+			}
+
+			match.pending.reset();
+			match.firstPostMilliseconds.reset();
+			match.lastPostMilliseconds.reset();
+			UpdateStateBody(match);
+			match.turnStartedAt = Clock::now();
+		}
+
+		void CompetitionServer::UpdateStateBody(Match& match) {
+			JSON json = MatchStateToJson(match.id, *match.state, PlayerColor::Red, match.logs);
+			json[U"startedAtUnixTime"] = match.startedAtUnixTime;
+			match.stateBody = json.formatUTF8();
+		}
+
+	}
+
+}
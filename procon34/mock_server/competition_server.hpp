@@ -0,0 +1,129 @@
+﻿#pragma once
+#include "../stdafx.h"
+#include "../game_state.hpp"
+#include "local_http_server.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+
+// 競技サーバーの代わりをするローカルのサーバー。 MatchInteractor を通信も含めて負荷試験するために使う。
+//
+//   GET /matches         : 試合一覧（ MatchOverview::FromJson で読む形）
+//   GET /matches/{id}    : 試合状態（ MatchStateResponse::parse で読む形）。開始前は 425
+//   POST /matches/{id}   : 行動計画。手番のターンのものだけ受け付け、そのターンの終わりに最後に受け付けたものを行う
+//
+// こちら（ request.cpp のクライアント）は常に赤の陣営で、相手（青）は GreedyInstruction で指す。
+// 試合は GameState で進め、ターン k は開始時刻 + k * turnSeconds に始まる。
+// 要求ごとに遅れ・揺らぎを入れたり、応答せずに切ったりできる。
+
+namespace Procon34 {
+
+	namespace MockServer {
+
+		class CompetitionServer {
+		public:
+
+			using Clock = std::chrono::steady_clock;
+
+			struct Config {
+				uint16 port = 3000; // request.cpp の接続先
+				std::string token = "token"; // procon-token ヘッダ。違えば 401
+				int32 latencyMilliseconds = 0; // 要求を受けてから処理するまでの遅れ
+				int32 jitterMilliseconds = 0; // 遅れに足す一様乱数の幅 [0, jitterMilliseconds)
+				double dropRate = 0.0; // 処理せずに接続を切る要求の割合
+				uint64 seed = 0;
+			};
+
+			// 待ち受けを始める。待ち受けられなければ例外を投げる
+			explicit CompetitionServer(const Config& config);
+
+			CompetitionServer(CompetitionServer&&) = delete;
+			CompetitionServer(const CompetitionServer&) = delete;
+
+			~CompetitionServer();
+
+			// 試合を足して id を返す。 startDelay 後に始まる。
+			// 1 ターンの長さは initialState.turnTimeLimitInMiliseconds を秒に丸めたもの（ API の turnSeconds は整数）
+			int64 addMatch(const GameInitialState& initialState, String opponent, std::chrono::milliseconds startDelay);
+
+			// すべての試合が終わったか
+			bool isFinished() const;
+
+			// 待ち受けをやめ、試合を進めるのもやめる
+			void stop();
+
+			struct Statistics {
+				int32 requestCount = 0;
+				int32 droppedCount = 0;
+				int32 ownTurnCount = 0; // 終わった自分の手番の数
+				int32 missedTurnCount = 0; // そのうち行動計画を 1 つも受け付けなかったもの
+				int32 postCount = 0; // 受け付けた行動計画の数（送り直しを含む）
+				int32 rejectedPostCount = 0;
+				Array<double> firstPostMilliseconds; // 手番のターンが始まってから、最初の行動計画を受け付けるまで（手番ごと）
+				Array<double> lastPostMilliseconds; // 同じく最後の行動計画を受け付けるまで
+			};
+			Statistics statistics() const;
+
+		private:
+
+			struct Match {
+				int64 id;
+				String opponent;
+				int32 turnSeconds;
+				Clock::time_point startedAt;
+				int64 startedAtUnixTime;
+
+				// これより下は mutex で保護する
+				mutable std::mutex mutex;
+				BoxPtr<GameState> state;
+				Array<JSON> logs;
+				std::string stateBody; // 試合状態取得API の応答。ターンが進むたびに作り直す
+				std::string overviewBody; // 試合一覧の要素
+				Clock::time_point turnStartedAt; // 今のターンを公開した時刻
+				Optional<TurnInstruction> pending; // 今のターンの終わりに行う行動
+				Optional<double> firstPostMilliseconds;
+				Optional<double> lastPostMilliseconds;
+			};
+
+			const Config m_config;
+
+			mutable std::mutex m_matchesMutex;
+			Array<std::shared_ptr<Match>> m_matches; // id - 1 番目
+
+			mutable std::mutex m_statisticsMutex;
+			Statistics m_statistics;
+			std::mt19937_64 m_rng;
+
+			std::mutex m_tickMutex;
+			std::condition_variable m_tickCondition;
+			bool m_stopping = false;
+			std::thread m_tickThread;
+
+			std::unique_ptr<LocalHttpServer> m_server;
+
+			HttpResponse handle(const HttpRequest& request);
+
+			HttpResponse getMatches();
+
+			HttpResponse getMatch(Match& match);
+
+			HttpResponse postMatch(Match& match, const std::string& body);
+
+			std::shared_ptr<Match> findMatch(int64 id) const;
+
+			// 時刻が来たターンを終わらせる
+			void tickLoop();
+
+			// 今のターンを終わらせて次のターンを公開する。 match.mutex を持って呼ぶ
+			void advanceTurn(Match& match);
+
+			// 今の局面から試合状態取得API の応答を作る。 match.mutex を持って呼ぶ
+			static void UpdateStateBody(Match& match);
+		};
+
+	}
+
+}
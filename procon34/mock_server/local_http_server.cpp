@@ -0,0 +1,170 @@
+﻿#include "local_http_server.hpp"
+#include <cctype>
+#include <cstring>
+
+namespace Procon34 {
+
+	namespace MockServer {
+
+		namespace {
+
+			std::string ToLower(std::string s) {
+				for (auto& ch : s) ch = (char)std::tolower((unsigned char)ch);
+				return s;
+			}
+
+			std::string Trim(const std::string& s) {
+				size_t begin = s.find_first_not_of(" \t");
+				if (begin == std::string::npos) return "";
+				size_t end = s.find_last_not_of(" \t");
+				return s.substr(begin, end - begin + 1);
+			}
+
+			const char* ReasonPhrase(int32 status) {
+				switch (status) {
+				case 200: return "OK";
+				case 400: return "Bad Request";
+				case 401: return "Unauthorized";
+				case 403: return "Forbidden";
+				case 404: return "Not Found";
+				case 425: return "Too Early";
+				case 500: return "Internal Server Error";
+				default: return "Unknown";
+				}
+			}
+
+		}
+
+
+		LocalHttpServer::LocalHttpServer(uint16 port, Handler handler)
+			: m_handler(std::move(handler))
+			, m_listenSocket(TcpSocket::Listen(port))
+		{
+			if (!m_listenSocket) throw Error(U"error at LocalHttpServer : cannot listen on port {}"_fmt(port));
+			m_port = m_listenSocket.localPort();
+			m_acceptThread = std::thread([this]() { acceptLoop(); });
+		}
+
+		LocalHttpServer::~LocalHttpServer() {
+			stop();
+		}
+
+		void LocalHttpServer::stop() {
+			if (!m_running.exchange(false)) return;
+
+			// 自分で 1 つ接続して accept を戻す（ Windows では待ち受けのソケットを shutdown しても戻らない）
+			TcpSocket::Connect("127.0.0.1", m_port, 1000);
+			m_acceptThread.join();
+			m_listenSocket.close();
+
+			// 読み込み中の接続は shutdown で recv が戻る
+			std::lock_guard lock(m_connectionsMutex);
+			for (auto& connection : m_connections) connection.socket.shutdown();
+			for (auto& connection : m_connections) connection.thread.join();
+			m_connections.clear();
+		}
+
+		void LocalHttpServer::acceptLoop() {
+			while (true) {
+				auto socket = m_listenSocket.accept();
+				if (!m_running.load()) return;
+				if (!socket) continue;
+
+				// 応答は小さく何度も送るので、まとめずにすぐ送る
+				socket.setNoDelay();
+
+				std::lock_guard lock(m_connectionsMutex);
+
+				// 終わった接続のスレッドを片付ける（ソケットは Connection と一緒に閉じる）
+				for (auto it = m_connections.begin(); it != m_connections.end();) {
+					if (it->finished.load()) {
+						it->thread.join();
+						it = m_connections.erase(it);
+					}
+					else {
+						++it;
+					}
+				}
+
+				auto& connection = m_connections.emplace_back();
+				connection.socket = std::move(socket);
+				connection.thread = std::thread([this, &connection]() { serve(connection); });
+			}
+		}
+
+		void LocalHttpServer::serve(Connection& connection) {
+			auto& socket = connection.socket;
+			std::string buffer;
+			std::string responseText;
+
+			while (m_running.load()) {
+				// ヘッダの終わりまで読む
+				size_t headerEnd;
+				bool connected = true;
+				while ((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+					if (!(connected = socket.receiveMore(buffer))) break;
+				}
+				if (!connected) break;
+
+				HttpRequest request;
+				bool keepAlive = true;
+				size_t contentLength = 0;
+				{
+					size_t lineEnd = buffer.find("\r\n");
+					std::string requestLine = buffer.substr(0, lineEnd);
+					size_t firstSpace = requestLine.find(' ');
+					size_t secondSpace = requestLine.find(' ', firstSpace + 1);
+					if (firstSpace == std::string::npos || secondSpace == std::string::npos) break;
+					request.method = requestLine.substr(0, firstSpace);
+					request.target = requestLine.substr(firstSpace + 1, secondSpace - firstSpace - 1);
+					if (requestLine.substr(secondSpace + 1) == "HTTP/1.0") keepAlive = false;
+
+					size_t pos = lineEnd + 2;
+					while (pos < headerEnd) {
+						size_t end = buffer.find("\r\n", pos);
+						size_t colon = buffer.find(':', pos);
+						if (colon != std::string::npos && colon < end) {
+							request.headers[ToLower(buffer.substr(pos, colon - pos))] = Trim(buffer.substr(colon + 1, end - colon - 1));
+						}
+						pos = end + 2;
+					}
+				}
+				if (auto it = request.headers.find("content-length"); it != request.headers.end()) contentLength = std::stoul(it->second);
+				if (auto it = request.headers.find("connection"); it != request.headers.end()) keepAlive = ToLower(it->second) != "close";
+
+				// 本体を読む
+				size_t bodyBegin = headerEnd + 4;
+				while (buffer.size() < bodyBegin + contentLength) {
+					if (!(connected = socket.receiveMore(buffer))) break;
+				}
+				if (!connected) break;
+				request.body = buffer.substr(bodyBegin, contentLength);
+				buffer.erase(0, bodyBegin + contentLength);
+
+				HttpResponse response;
+				try {
+					response = m_handler(request);
+				}
+				catch (...) {
+					response = HttpResponse{ .status = 500, .contentType = "text/plain", .body = "internal error" };
+				}
+				if (response.drop) break;
+
+				responseText.clear();
+				responseText += "HTTP/1.1 " + std::to_string(response.status) + " " + ReasonPhrase(response.status) + "\r\n";
+				responseText += "Content-Type: " + response.contentType + "\r\n";
+				responseText += "Content-Length: " + std::to_string(response.body.size()) + "\r\n";
+				responseText += keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+				if (!socket.sendAll(responseText.data(), responseText.size())) break;
+				if (!socket.sendAll(response.body.data(), response.body.size())) break;
+				if (!keepAlive) break;
+			}
+
+			// 閉じるのは join する側（ stop と重なっても、閉じた番号を別の接続が使い回さないように）
+			socket.shutdown();
+			connection.finished.store(true);
+		}
+
+	}
+
+}
@@ -0,0 +1,79 @@
+﻿#pragma once
+#include "../stdafx.h"
+#include "../tcp_socket.hpp"
+#include <atomic>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// 127.0.0.1 だけで待ち受ける、ごく小さな HTTP/1.1 サーバー。
+// 競技サーバーの代わりにして、通信部分のベンチマークや試験に使う。
+// 接続ごとにスレッドを 1 つ使い、 Connection: close が来るまで同じ接続で続けて要求を受ける（ keep-alive ）。
+
+namespace Procon34 {
+
+	namespace MockServer {
+
+		struct HttpRequest {
+			std::string method;
+			std::string target; // "/matches/1" など（クエリを含む）
+			HashTable<std::string, std::string> headers; // 名前は小文字にしてある
+			std::string body;
+		};
+
+		struct HttpResponse {
+			int32 status = 200;
+			std::string contentType = "application/json";
+			std::string body;
+			bool drop = false; // true なら応答せずに接続を切る（要求が途中で失われたことにする）
+		};
+
+		class LocalHttpServer {
+		public:
+
+			// 要求 1 つに対して応答を返す。複数のスレッドから同時に呼ばれる。
+			// 例外を投げると 500 を返す
+			using Handler = std::function<HttpResponse(const HttpRequest&)>;
+
+			// 127.0.0.1:port で待ち受けを始める。 port が 0 なら空いているものを使う。
+			// 待ち受けられなければ例外を投げる
+			LocalHttpServer(uint16 port, Handler handler);
+
+			LocalHttpServer(LocalHttpServer&&) = delete;
+			LocalHttpServer(const LocalHttpServer&) = delete;
+
+			~LocalHttpServer();
+
+			// 待ち受けをやめ、すべての接続を切って、スレッドの終わりを待つ
+			void stop();
+
+			// 実際に待ち受けているポート
+			uint16 port() const { return m_port; }
+
+		private:
+
+			struct Connection {
+				TcpSocket socket;
+				std::thread thread;
+				std::atomic<bool> finished = false;
+			};
+
+			Handler m_handler;
+			uint16 m_port = 0;
+			TcpSocket m_listenSocket;
+			std::atomic<bool> m_running = true;
+			std::thread m_acceptThread;
+
+			std::mutex m_connectionsMutex;
+			std::list<Connection> m_connections;
+
+			void acceptLoop();
+
+			void serve(Connection& connection);
+		};
+
+	}
+
+}
@@ -0,0 +1,127 @@
+﻿#include "match_json.hpp"
+
+namespace Procon34 {
+
+	namespace MockServer {
+
+		JSON MatchStateToJson(int64 id, const GameState& state, PlayerColor self, const Array<JSON>& logs) {
+			auto board = state.getBoard();
+			int32 height = board->getHeight();
+			int32 width = board->getWidth();
+			auto opponent = GameState::OpponentOf(self);
+
+			// 職人の番号は 1 から。味方は正、相手は負
+			Grid<int32> masons(Size(width, height), 0);
+			for (auto& agent : state.getAgents(self)) masons[agent.pos.asPoint()] = agent.marker.index + 1;
+			for (auto& agent : state.getAgents(opponent)) masons[agent.pos.asPoint()] = -(agent.marker.index + 1);
+
+			JSON res;
+			res[U"id"] = id;
+			res[U"turn"] = state.getTurnIndex();
+
+			JSON boardJson;
+			boardJson[U"width"] = width;
+			boardJson[U"height"] = height;
+			boardJson[U"mason"] = (int32)state.getAgents(self).size();
+			for (int32 r = 0; r < height; r++) {
+				for (int32 c = 0; c < width; c++) {
+					auto pos = BoardPos(r, c);
+					auto& mass = (*board)[pos];
+					boardJson[U"structures"][r][c] = mass.biome == MassBiome::Pond ? 1 : mass.biome == MassBiome::Castle ? 2 : 0;
+					boardJson[U"masons"][r][c] = masons[pos.asPoint()];
+					boardJson[U"walls"][r][c] = !mass.wall ? 0 : mass.wall->color == self ? 1 : 2;
+					boardJson[U"territories"][r][c] = (state.isAreaOf(self, pos) ? 1 : 0) + (state.isAreaOf(opponent, pos) ? 2 : 0);
+				}
+			}
+			res[U"board"] = boardJson;
+
+			res[U"logs"] = JSON::Parse(U"[]");
+			for (auto& log : logs) res[U"logs"].push_back(log);
+			return res;
+		}
+
+		JSON LogEntryToJson(int32 turn, const TurnInstruction& instruction, const Array<bool>& succeeded) {
+			JSON res = instruction.toJson();
+			res[U"turn"] = turn;
+			for (size_t i = 0; i < instruction.size(); i++) {
+				res[U"actions"][i][U"succeeded"] = succeeded[i];
+			}
+			return res;
+		}
+
+		JSON MatchOverviewToJson(int64 id, const GameState& state, PlayerColor self, int32 turnSeconds, StringView opponent) {
+			auto initialState = state.getInitialState();
+			auto board = state.getBoard();
+			int32 height = board->getHeight();
+			int32 width = board->getWidth();
+
+			JSON res;
+			res[U"id"] = id;
+			res[U"turns"] = state.getAllTurnNumber();
+			res[U"turnSeconds"] = turnSeconds;
+			res[U"opponent"] = opponent;
+			res[U"bonus"][U"wall"] = initialState->wallCoefficient;
+			res[U"bonus"][U"territory"] = initialState->teritorryCoefficient;
+			res[U"bonus"][U"castle"] = initialState->castleCoefficient;
+			res[U"first"] = initialState->firstToMove == self;
+
+			// 盤面は試合状態取得API と同じ形（ structures と masons だけ）
+			JSON stateJson = MatchStateToJson(id, state, self, {});
+			JSON boardJson;
+			boardJson[U"width"] = width;
+			boardJson[U"height"] = height;
+			boardJson[U"mason"] = (int32)state.getAgents(self).size();
+			boardJson[U"structures"] = stateJson[U"board"][U"structures"];
+			boardJson[U"masons"] = stateJson[U"board"][U"masons"];
+			res[U"board"] = boardJson;
+			return res;
+		}
+
+		JSON MakeMoveWithLog(GameState& state, PlayerColor player, const TurnInstruction& instruction) {
+			auto agents = state.getAgents(player);
+			auto before = state.clone();
+			auto log = LogEntryToJson(state.getTurnIndex() + 1, instruction, Array<bool>(agents.size(), true));
+			state.makeMove(player, instruction);
+			auto after = state.getAgents(player);
+			for (size_t i = 0; i < agents.size(); i++) {
+				auto& move = instruction[i];
+				bool succeeded = true;
+				if (move.isMove()) succeeded = after[i].pos.asPoint() != agents[i].pos.asPoint();
+				else if (move.isConstruct()) {
+					auto pos = agents[i].pos.movedAlong(move.asConstruct().dir);
+					succeeded = state.getBoard()->isOnBoard(pos) && !(*before->getBoard())[pos].wall && (*state.getBoard())[pos].wall;
+				}
+				else if (move.isDestroy()) {
+					auto pos = agents[i].pos.movedAlong(move.asDestroy().dir);
+					succeeded = state.getBoard()->isOnBoard(pos) && (*before->getBoard())[pos].wall && !(*state.getBoard())[pos].wall;
+				}
+				log[U"actions"][i][U"succeeded"] = succeeded;
+			}
+			return log;
+		}
+
+		PlayedMatch PlayRandomly(BoxPtr<GameState> state, int32 turns, uint64 seed) {
+			SmallRNG rng(seed);
+			PlayedMatch res{ .state = state, .logs = {} };
+			for (int32 t = 0; t < turns && !state->isOver(); t++) {
+				auto player = state->whosTurn();
+				auto agents = state->getAgents(player);
+
+				TurnInstruction instruction(state, player);
+				for (auto& agent : agents) {
+					switch (rng() % 4) {
+					case 0: instruction.insert(AgentMove::GetStay(agent)); break;
+					case 1: instruction.insert(AgentMove::GetMove(agent, MoveDirection((int32)(rng() % 8)))); break;
+					case 2: instruction.insert(AgentMove::GetConstruct(agent, MoveDirection((int32)(rng() % 4) * 2))); break;
+					default: instruction.insert(AgentMove::GetDestroy(agent, MoveDirection((int32)(rng() % 4) * 2))); break;
+					}
+				}
+
+				res.logs.push_back(MakeMoveWithLog(*state, player, instruction));
+			}
+			return res;
+		}
+
+	}
+
+}
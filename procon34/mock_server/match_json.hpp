@@ -0,0 +1,37 @@
+﻿#pragma once
+#include "../stdafx.h"
+#include "../game_state.hpp"
+
+// 競技サーバーの応答と同じ形の JSON を GameState から作る（ローカルのサーバーやベンチマークで使う）。
+
+namespace Procon34 {
+
+	namespace MockServer {
+
+		// 試合状態取得API (GET /matches/{id}) の応答。
+		// self の陣営を味方（職人は正、壁は 1 ）として書く。
+		// logs : LogEntryToJson で作った行動ログ（古いものから順）
+		JSON MatchStateToJson(int64 id, const GameState& state, PlayerColor self, const Array<JSON>& logs);
+
+		// 行動ログ 1 ターン分。 turn は行動したターン（ TurnInstruction::toJson の turn と同じ）
+		// succeeded[i] は職人 i の行動が成功したか
+		JSON LogEntryToJson(int32 turn, const TurnInstruction& instruction, const Array<bool>& succeeded);
+
+		// 試合一覧取得API (GET /matches) の matches の要素 1 つ（ MatchOverview::FromJson で読む形）。
+		// state は試合開始時の局面。 self の陣営を味方として書く
+		JSON MatchOverviewToJson(int64 id, const GameState& state, PlayerColor self, int32 turnSeconds, StringView opponent);
+
+		// player が instruction の行動をして state を 1 ターン進め、そのターンの行動ログを返す。
+		// 職人が動いたか・壁が変わったかで成否を決める（ makeMove は失敗した行動を滞在にする）
+		JSON MakeMoveWithLog(GameState& state, PlayerColor player, const TurnInstruction& instruction);
+
+		// 両者がランダムな行動を turns ターン続けた局面と、その行動ログ
+		struct PlayedMatch {
+			BoxPtr<GameState> state;
+			Array<JSON> logs;
+		};
+		PlayedMatch PlayRandomly(BoxPtr<GameState> state, int32 turns, uint64 seed);
+
+	}
+
+}
@@ -0,0 +1,85 @@
+﻿#include "polling_scheduler.hpp"
+
+
+namespace Procon34 {
+
+
+	PollingScheduler::PollingScheduler(int32 turnSeconds, int32 turnCount, Config config)
+		: m_turnLength(std::chrono::seconds(turnSeconds))
+		, m_turnCount(turnCount)
+		, m_config(config)
+	{
+		if (turnSeconds <= 0) throw Error(U"error at PollingScheduler : turnSeconds must be positive");
+	}
+
+	void PollingScheduler::setStartedAtUnixTime(int64 unixSeconds) {
+		// Unix 時間は秒単位なので、本当の開始時刻は [unixSeconds, unixSeconds + 1) のどこか
+		auto sinceStart = std::chrono::system_clock::now() - std::chrono::system_clock::time_point(std::chrono::seconds(unixSeconds));
+		auto lower = Clock::now() - std::chrono::duration_cast<Clock::duration>(sinceStart);
+		m_evidence.push_front(Evidence{ .turn = m_lastTurn.value_or(0), .lower = lower, .upper = lower + std::chrono::seconds(1) });
+		updateOrigin();
+	}
+
+	Optional<PollingScheduler::TurnDetection> PollingScheduler::onResponse(int32 turn, Clock::time_point sentAt, Clock::time_point receivedAt) {
+		// 試合が終わっていれば次のターンは始まらないので、下限は得られない
+		Evidence evidence{ .turn = turn, .lower = none, .upper = receivedAt - m_turnLength * turn };
+		if (turn < m_turnCount) evidence.lower = sentAt - m_turnLength * (turn + 1);
+		m_evidence.remove_if([&](const Evidence& e) { return e.turn + EvidenceTurns < turn; });
+		m_evidence.push_back(evidence);
+		updateOrigin();
+
+		m_pollCount++;
+		Optional<TurnDetection> res;
+		if (m_lastTurn && *m_lastTurn != turn && m_originLower) {
+			auto toMilliseconds = [](Clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+			auto earliestStart = *m_originLower + m_turnLength * turn;
+			auto latestStart = *m_originUpper + m_turnLength * turn;
+			res = TurnDetection{
+				.turn = turn,
+				.minDelayMilliseconds = Max(0.0, toMilliseconds(receivedAt - latestStart)),
+				.maxDelayMilliseconds = Max(0.0, toMilliseconds(receivedAt - earliestStart)),
+				.pollCount = m_pollCount,
+			};
+			m_detections.push_back(*res);
+			m_pollCount = 0;
+		}
+		m_lastTurn = turn;
+		return res;
+	}
+
+	void PollingScheduler::updateOrigin() {
+		m_originLower = none;
+		m_originUpper = none;
+		for (auto it = m_evidence.rbegin(); it != m_evidence.rend(); ++it) {
+			auto lower = m_originLower;
+			if (it->lower) lower = lower ? Max(*lower, *it->lower) : *it->lower;
+			auto upper = m_originUpper ? Min(*m_originUpper, it->upper) : it->upper;
+			if (lower && *lower >= upper) break;
+			m_originLower = lower;
+			m_originUpper = upper;
+		}
+		// 下限がない（試合が終わった後の応答しかない）なら、範囲は作らない
+		if (!m_originLower) m_originUpper = none;
+	}
+
+	PollingScheduler::Clock::duration PollingScheduler::nextWait(Clock::time_point now) const {
+		if (m_lastTurn && *m_lastTurn >= m_turnCount) return m_config.maxBackoff;
+		if (!m_lastTurn || !m_originLower) return m_config.fallbackInterval;
+
+		// 次のターンが始まりうる範囲
+		int32 nextTurn = *m_lastTurn + 1;
+		auto windowBegin = *m_originLower + m_turnLength * nextTurn - m_config.guard;
+		auto windowEnd = *m_originUpper + m_turnLength * nextTurn + m_config.guard;
+
+		if (now < windowBegin) return Min<Clock::duration>(windowBegin - now, m_config.maxBackoff);
+		// 範囲が広すぎるうちは細かく問い合わせない（問い合わせるうちに狭まる）
+		if (now <= windowEnd && windowEnd - windowBegin <= m_turnLength / 2) return m_config.tightInterval;
+		return m_config.fallbackInterval;
+	}
+
+	Optional<PollingScheduler::Clock::time_point> PollingScheduler::expectedTurnStart(int32 turn) const {
+		if (!m_originLower) return none;
+		return *m_originLower + (*m_originUpper - *m_originLower) / 2 + m_turnLength * turn;
+	}
+
+}
@@ -0,0 +1,88 @@
+﻿#pragma once
+#include "stdafx.h"
+#include <chrono>
+
+
+namespace Procon34 {
+
+	// PollingScheduler の設定
+	struct PollingConfig {
+		std::chrono::steady_clock::duration tightInterval = std::chrono::milliseconds(50); // ターンの境目の近くでの間隔
+		std::chrono::steady_clock::duration fallbackInterval = std::chrono::milliseconds(200); // 境目の見当がつかないときの間隔
+		std::chrono::steady_clock::duration maxBackoff = std::chrono::milliseconds(1000); // 境目から遠いときに一度に待つ最大の時間
+		std::chrono::steady_clock::duration guard = std::chrono::milliseconds(100); // 境目がありうる範囲の前後に足す余裕
+	};
+
+	// 試合状態取得API を問い合わせる間隔を決める。
+	//
+	// ターン k は T0 + k * turnSeconds に始まるとして、 T0 のありうる範囲を問い合わせのたびに狭める。
+	// 要求を送った時刻を sentAt 、応答を受け取った時刻を receivedAt として、ターン k が返ってきたら
+	//     sentAt - (k + 1) * turnSeconds < T0 <= receivedAt - k * turnSeconds
+	// である（サーバーが状態を読んだのは sentAt と receivedAt の間）。
+	// サーバーのターンの間隔が少しずつずれても追従するように、最近の数ターンの応答だけを使い、矛盾したら新しいほうを信じる。
+	//
+	// 次のターンが始まりうる範囲の近くでは細かく問い合わせ、それ以外では間を空ける。
+	class PollingScheduler {
+	public:
+
+		using Clock = std::chrono::steady_clock;
+
+		using Config = PollingConfig;
+
+		// ターンの変化を検出したときの記録
+		struct TurnDetection {
+			int32 turn;
+			double minDelayMilliseconds; // ターンが始まってから検出するまでの時間の下限
+			double maxDelayMilliseconds; // 同じく上限
+			int32 pollCount; // 前のターンを検出してから、このターンを検出するまでに問い合わせた回数
+		};
+
+		// turnSeconds : 1 ターンの長さ（ MatchOverview::turnSeconds ）
+		// turnCount : 試合全体のターン数
+		PollingScheduler(int32 turnSeconds, int32 turnCount, Config config = Config());
+
+		// 応答に試合の開始時刻 (startedAtUnixTime) があれば与える。 T0 の範囲の最初の見当になる
+		void setStartedAtUnixTime(int64 unixSeconds);
+
+		// 問い合わせの結果を伝える。ターンが変わっていたら、その記録を返す
+		Optional<TurnDetection> onResponse(int32 turn, Clock::time_point sentAt, Clock::time_point receivedAt);
+
+		// now から次に問い合わせるまで待つ時間
+		Clock::duration nextWait(Clock::time_point now) const;
+
+		// ターン turn が始まる時刻の見当（範囲の中央）。まだ見当がつかなければ none
+		Optional<Clock::time_point> expectedTurnStart(int32 turn) const;
+
+		// これまでに検出したターンの記録
+		const Array<TurnDetection>& detections() const { return m_detections; }
+
+	private:
+
+		Clock::duration m_turnLength;
+		int32 m_turnCount;
+		Config m_config;
+
+		// これより前のターンの応答は T0 の範囲に使わない
+		static constexpr int32 EvidenceTurns = 4;
+
+		// 1 回の応答からわかる T0 の範囲 (lower, upper] 。試合が終わった後の応答には下限がない
+		struct Evidence {
+			int32 turn;
+			Optional<Clock::time_point> lower;
+			Clock::time_point upper;
+		};
+		Array<Evidence> m_evidence; // 新しいものほど後ろ
+
+		// T0 のありうる範囲 (m_originLower, m_originUpper] 。 m_evidence から作る
+		Optional<Clock::time_point> m_originLower;
+		Optional<Clock::time_point> m_originUpper;
+
+		// m_evidence を新しい順に、矛盾しない限り重ねて m_originLower と m_originUpper を作る
+		void updateOrigin();
+
+		Optional<int32> m_lastTurn;
+		int32 m_pollCount = 0;
+		Array<TurnDetection> m_detections;
+	};
+
+}
@@ -1,4 +1,7 @@
 ﻿#include "request.hpp"
+#include "game_instructions.hpp"
+#include "match_state_response.hpp"
+#include <cstdio>
 
 
 namespace Procon34 {
@@ -49,18 +52,54 @@ namespace Procon34 {
 
 	const String token = U"token";
 	const URL host = U"http://localhost:3000";
-	const HashTable<String, String> header = { { U"procon-token", U"{}"_fmt(token)}};
-	const HashTable<String, String> headerForPost = { { U"procon-token", U"{}"_fmt(token)}, { U"Content-Type", U"application/json" } };
-	const FilePath path = U"temp.json";
+
+	HttpClient& matchApiClient() {
+		static HttpClient client(host, { { U"procon-token", token } });
+		return client;
+	}
+
+	namespace {
+
+		// 試合ごとのバッファを渡されなかったときに使う。スレッドごとに 1 つ持ち、要求のたびに使い回す
+		HttpClient::Buffers& threadBuffers() {
+			thread_local HttpClient::Buffers buffers;
+			return buffers;
+		}
+
+		// "/matches/{id}" を buf に書く
+		std::string_view matchEndpoint(int64 id, char (&buf)[32]) {
+			return std::string_view(buf, std::snprintf(buf, sizeof(buf), "/matches/%lld", (long long)id));
+		}
+
+		// 受け取った応答の本体を、ファイルを通さずにそのまま JSON として読む
+		JSON parseResponse(const HttpClient::Buffers& buffers) {
+			auto body = buffers.body();
+			return JSON::Load(MemoryViewReader(body.data(), body.size()));
+		}
+
+		// [POST] /matches/{id} の応答を表示する
+		bool reportPostResult(const Optional<HttpClient::Result>& response, const HttpClient::Buffers& buffers) {
+			if (!response) {
+				Console << U"Bad request";
+				return false;
+			}
+			if (!response->isOK()) {
+				Console << U"Request is NOT accepted ({:.1f} ms)"_fmt(response->latencyMilliseconds);
+				return false;
+			}
+			JSON data = parseResponse(buffers);
+			Console << U"Request is accepted at {} ({:.1f} ms)"_fmt(data[U"accepted_at"].get<uint64>(), response->latencyMilliseconds); // Unix Time が帰ってくるが、可読性を考えるとどうにか変換したほうがよいか？
+			return true;
+		}
+
+	}
 
 	// [GET] /matches
 	Optional<JSON> getMatchesList() {
-		const URL endpoint = U"/matches";
-
-		// try
-		if (const auto response = SimpleHTTP::Get(host + endpoint, header, path)) {
-			if (response.isOK()) {
-				const JSON data = JSON::Load(path);
+		auto& buffers = threadBuffers();
+		if (const auto response = matchApiClient().get("/matches", buffers)) {
+			if (response->isOK()) {
+				const JSON data = parseResponse(buffers);
 				return data;
 			}
 			return none; // 漏れてた
@@ -74,12 +113,16 @@ namespace Procon34 {
 
 	// [GET] /matches/{id}
 	Optional<JSON> getMatchesState(int64 id) {
-		const URL endpoint = U"/matches/{}"_fmt(id);
+		return getMatchesState(id, threadBuffers());
+	}
+
+	Optional<JSON> getMatchesState(int64 id, HttpClient::Buffers& buffers) {
+		char buf[32];
+		auto endpoint = matchEndpoint(id, buf);
 
-		// try
-		if (const auto response = SimpleHTTP::Get(host + endpoint, header, path)) {
-			if (response.isOK()) {
-				const JSON data = JSON::Load(path);
+		if (const auto response = matchApiClient().get(endpoint, buffers)) {
+			if (response->isOK()) {
+				const JSON data = parseResponse(buffers);
 				return data;
 			}
 			return none;
@@ -91,21 +134,39 @@ namespace Procon34 {
 		}
 	}
 
-	// [POST] /matches/{id}
-	void postAgentActions(int64 id, JSON json) {
-		const URL endpoint = U"/matches/{}"_fmt(id);
-		// try
-		std::string buf = json.formatUTF8();
-		if (auto response = SimpleHTTP::Post(host + endpoint, headerForPost, buf.data(), buf.size(), path)) {
-			if (response.isOK()) {
-				JSON data = JSON::Load(path);
-				Console << U"Request is accepted at {}"_fmt(data[U"accepted_at"].get<uint64>()); // Unix Time が帰ってくるが、可読性を考えるとどうにか変換したほうがよいか？
-			}
-			else {
-				Console << U"Request is NOT accepted";
+	bool getMatchesState(int64 id, HttpClient::Buffers& buffers, MatchStateResponse& out) {
+		char buf[32];
+		auto endpoint = matchEndpoint(id, buf);
+
+		if (const auto response = matchApiClient().get(endpoint, buffers)) {
+			if (!response->isOK()) return false;
+			if (!out.parse(buffers.body())) {
+				Console << U"Malformed match state";
+				return false;
 			}
+			return true;
+		}
+
+		else {
+			Console << U"Bad request";
+			return false;
 		}
+	}
+
+	// [POST] /matches/{id}
+	void postAgentActions(int64 id, JSON json) {
+		char buf[32];
+		auto& buffers = threadBuffers();
+		auto response = matchApiClient().post(matchEndpoint(id, buf), [&](std::string& out) { out += json.formatUTF8(); }, buffers);
+		reportPostResult(response, buffers);
+	}
+
+	bool postAgentActions(int64 id, const TurnInstruction& instruction, HttpClient::Buffers& buffers) {
+		char buf[32];
+		auto endpoint = matchEndpoint(id, buf);
 
-		else Console << U"Bad request";
+		// JSON を組み立てずに、要求のバッファへ直接書く
+		auto response = matchApiClient().post(endpoint, [&](std::string& out) { instruction.appendJson(out); }, buffers);
+		return reportPostResult(response, buffers);
 	}
 }
@@ -1,13 +1,29 @@
 ﻿#pragma once
 #include "stdafx.h"
 #include "game_util.hpp"
+#include "http_client.hpp"
 
 
 namespace Procon34 {
+	struct TurnInstruction;
+	struct MatchStateResponse;
+
+	// 競技サーバーへのクライアント。プロセス全体で 1 つを使い、接続を使い回す
+	HttpClient& matchApiClient();
+
 	Optional<JSON> getMatchesList();
 	Optional<JSON> getMatchesState(int64 id);
 	void postAgentActions(int64 id, JSON json);
 
+	// 試合ごとのバッファを使う版。 MatchInteractor はこちらを使う
+	Optional<JSON> getMatchesState(int64 id, HttpClient::Buffers& buffers);
+
+	// JSON の木を作らずに out へ直接読む。受け取れて形も正しければ true
+	bool getMatchesState(int64 id, HttpClient::Buffers& buffers, MatchStateResponse& out);
+
+	// instruction.toJson() と同じものを、 JSON を組み立てずに送る。受け付けられれば true
+	bool postAgentActions(int64 id, const TurnInstruction& instruction, HttpClient::Buffers& buffers);
+
 
 	struct MatchOverview {
 		int64 id;
@@ -0,0 +1,50 @@
+﻿#include "cancellation.hpp"
+
+namespace Procon34 {
+
+	CancellationToken::CancellationToken()
+		: m_cancelled(false)
+		, m_deadline(none)
+	{
+	}
+
+	CancellationToken::CancellationToken(Clock::time_point deadline)
+		: m_cancelled(false)
+		, m_deadline(deadline)
+	{
+	}
+
+	std::shared_ptr<CancellationToken> CancellationToken::WithTimeLimit(std::chrono::milliseconds timeLimit, std::shared_ptr<const CancellationToken> parent) {
+		auto res = std::make_shared<CancellationToken>(Clock::now() + timeLimit);
+		res->m_parent = std::move(parent);
+		return res;
+	}
+
+	std::shared_ptr<CancellationToken> CancellationToken::ChildOf(std::shared_ptr<const CancellationToken> parent) {
+		auto res = std::make_shared<CancellationToken>();
+		res->m_parent = std::move(parent);
+		return res;
+	}
+
+	void CancellationToken::cancel() {
+		m_cancelled.store(true, std::memory_order_relaxed);
+	}
+
+	bool CancellationToken::isCancelled() const {
+		if (m_cancelled.load(std::memory_order_relaxed)) return true;
+		if (m_deadline.has_value() && Clock::now() >= *m_deadline) return true;
+		if (m_parent && m_parent->isCancelled()) return true;
+		return false;
+	}
+
+	Optional<std::chrono::milliseconds> CancellationToken::remainingTime() const {
+		Optional<std::chrono::milliseconds> res = m_parent ? m_parent->remainingTime() : none;
+		if (m_deadline.has_value()) {
+			auto rest = std::chrono::duration_cast<std::chrono::milliseconds>(*m_deadline - Clock::now());
+			rest = std::max(rest, std::chrono::milliseconds(0));
+			res = res.has_value() ? std::min(*res, rest) : rest;
+		}
+		return res;
+	}
+
+}
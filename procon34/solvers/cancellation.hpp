@@ -0,0 +1,44 @@
+﻿#pragma once
+#include "../stdafx.h"
+#include <atomic>
+#include <chrono>
+
+namespace Procon34 {
+
+	// 探索の打ち切りを伝える。
+	// 手動の打ち切り（ cancel ）と、期限の時刻の両方を扱う。
+	// 親を持つトークンは、親が打ち切られると自分も打ち切られる（逆は伝わらない）。
+	// 複数のスレッドから同時に参照してよい。
+	class CancellationToken {
+	public:
+
+		using Clock = std::chrono::steady_clock;
+
+		// 期限なし
+		CancellationToken();
+
+		// 期限の時刻を指定
+		CancellationToken(Clock::time_point deadline);
+
+		// 現在時刻から timeLimit だけ経過した時刻を期限とする。 parent を与えると、 parent が打ち切られたときにも打ち切られる
+		static std::shared_ptr<CancellationToken> WithTimeLimit(std::chrono::milliseconds timeLimit, std::shared_ptr<const CancellationToken> parent = nullptr);
+
+		// parent が打ち切られると打ち切られるトークン。 parent が nullptr なら期限なしのトークンと同じ
+		static std::shared_ptr<CancellationToken> ChildOf(std::shared_ptr<const CancellationToken> parent);
+
+		// 打ち切りを要求する
+		void cancel();
+
+		// 打ち切りが要求されたか、期限を過ぎたか（親についても調べる）
+		bool isCancelled() const;
+
+		// 期限までの残り時間（親の期限も含めて最も早いもの）。期限がないなら none 。過ぎていたら 0 。
+		Optional<std::chrono::milliseconds> remainingTime() const;
+
+	private:
+		std::atomic<bool> m_cancelled;
+		Optional<Clock::time_point> m_deadline;
+		std::shared_ptr<const CancellationToken> m_parent;
+	};
+
+}
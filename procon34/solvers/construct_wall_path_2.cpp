@@ -1,5 +1,8 @@
 ﻿#pragma once
 #include "construct_wall_path_2.hpp"
+#include "profiler.hpp"
+#include "ranked_plans.hpp"
+#include "task_group.hpp"
 
 namespace Procon34 {
 
@@ -16,35 +19,63 @@ namespace Procon34 {
 
 
 	Array<ConstructWallPath2::Answer> ConstructWallPath2::solve(Agent agent, int32 maxTurn, Array<int64> turnProfit) {
+		if (maxTurn < 0) throw Error(U"error at ConstructWallPath2::solve : maxTurn < 0");
+		return solve(agent, maxTurn, std::move(turnProfit), m_gridWalking->solve(agent, maxTurn));
+	}
+
+	Array<ConstructWallPath2::Answer> ConstructWallPath2::solve(Agent agent, int32 maxTurn, Array<int64> turnProfit, const GridWalking::Answer& gridWalkingAnswer) {
 		if (maxTurn < 0) throw Error(U"error at ConstructWallPath2::solve : maxTurn < 0");
 		if(turnProfit.size() < (size_t)(maxTurn + 1)) throw Error(U"error at ConstructWallPath2::solve : turnProfit.size() < maxTurn + 1");
+		if (gridWalkingAnswer.maxTurnCount < maxTurn) throw Error(U"error at ConstructWallPath2::solve : gridWalkingAnswer.maxTurnCount < maxTurn");
+		PROCON34_PROFILE_SCOPE("ConstructWallPath2::solve");
 
-		auto gridWalkingAnswer = m_gridWalking->solve(agent, maxTurn);
-		Array<Answer> result;
+		const int64 NEGINF = -1001001001001001001;
 
-		for (auto wallPath : m_wallPathInstances) {
+		// 壁の始点を BatchSize 個ずつまとめて WallPath2 に渡す。 1 まとまりが 1 つのタスク
+		constexpr size_t BatchSize = 16;
+		struct Batch {
+			size_t wallPathIndex;
+			size_t begin;
+			size_t end;
+		};
+		Array<Array<Array<BoardPos>>> validAgentPos(m_wallPathInstances.size());
+		Array<Array<int32>> fromBases(m_wallPathInstances.size());
+		Array<Batch> batches;
+
+		for (size_t wallPathIndex = 0; wallPathIndex < m_wallPathInstances.size(); wallPathIndex++) {
+			auto& wallPath = m_wallPathInstances[wallPathIndex];
 
 			// その base と組になれる agentPos を列挙。
-			Array<Array<BoardPos>> validAgentPos(getNumberOfBases());
+			validAgentPos[wallPathIndex].resize(getNumberOfBases());
 			for (auto node : wallPath->nodes) {
 				if (gridWalkingAnswer.positionToListIndex[node.agentPos.asPoint()] >= 0) {
-					validAgentPos[node.baseId].push_back(node.agentPos);
+					validAgentPos[wallPathIndex][node.baseId].push_back(node.agentPos);
 				}
 			}
 
-			Array<std::pair<int64, ShortenMove::Type>> resultBuffer;
-			const int64 NEGINF = -1001001001001001001;
-			std::pair<int64, ShortenMove::Type> bufferDefaultVal = { NEGINF, ShortenMove::Stay() };
-			resultBuffer.assign(getNumberOfBases(), bufferDefaultVal);
-
 			// 壁の始点
-			for (int32 from = 0; from < (int32)validAgentPos.size(); from++) if (validAgentPos[from].size() >= 1) {
+			for (int32 from = 0; from < (int32)validAgentPos[wallPathIndex].size(); from++) if (validAgentPos[wallPathIndex][from].size() >= 1) {
+				if (m_isStartBase && !(*m_isStartBase)[from]) continue;
+				fromBases[wallPathIndex].push_back(from);
+			}
 
-				// 壁構築の経路問題の入力を構築
-				//   壁の始点からノードを検索し、職人の位置を決定
+			for (size_t batchBegin = 0; batchBegin < fromBases[wallPathIndex].size(); batchBegin += BatchSize) {
+				batches.push_back(Batch{ wallPathIndex, batchBegin, Min(batchBegin + BatchSize, fromBases[wallPathIndex].size()) });
+			}
+		}
+
+		auto solveBatch = [&](const Batch& batch, Array<Answer>& result) {
+			auto& wallPath = m_wallPathInstances[batch.wallPathIndex];
+			auto& batchFromBases = fromBases[batch.wallPathIndex];
+			auto resultBuffer = RankedPlanTable<ShortenMove::Type>(getNumberOfBases(), m_planCount, NEGINF, ShortenMove::Stay());
+
+			// 壁構築の経路問題の入力を構築
+			//   壁の始点からノードを検索し、職人の位置を決定
+			Array<Array<WallPath2::MovingState>> starterSets;
+			for (size_t batchIndex = batch.begin; batchIndex < batch.end; batchIndex++) {
 				Array<WallPath2::MovingState> starters;
-				auto base = from;
-				for (auto agentPos : validAgentPos[from]) {
+				auto base = batchFromBases[batchIndex];
+				for (auto agentPos : validAgentPos[batch.wallPathIndex][base]) {
 					int32 gridWalkingPosId = gridWalkingAnswer.positionToListIndex[agentPos.asPoint()];
 					for (int32 t = 0; t <= maxTurn; t++) {
 						if ((int32)gridWalkingAnswer.shortPath[t].size() <= gridWalkingPosId) continue;
@@ -56,46 +87,67 @@ namespace Procon34 {
 						starters.push_back(tmp);
 					}
 				}
+				starterSets.push_back(std::move(starters));
+			}
 
-				// 壁構築の経路問題のアルゴリズムを実行
-				starters = wallPath->solve(maxTurn, std::move(starters));
+			// 壁構築の経路問題のアルゴリズムを実行
+			auto solvedSets = wallPath->solve(maxTurn, starterSets);
+
+			for (size_t batchIndex = batch.begin; batchIndex < batch.end; batchIndex++) {
+				int32 from = batchFromBases[batchIndex];
 
 				// 出力にターン数のペナルティを追加して集約
-				for (auto& st : starters) {
+				for (auto& st : solvedSets[batchIndex - batch.begin]) {
 					int32 baseId = wallPath->nodes[st.nodeId].baseId;
 					int64 profit = st.offsetProfit + turnProfit[st.turnCount];
-					if (resultBuffer[baseId].first >= profit) continue;
-					resultBuffer[baseId].first = profit;
-					resultBuffer[baseId].second = st.firstMove;
+					resultBuffer.push(baseId, profit, st.firstMove);
 				}
 
 				// 出力に追記
 				//     しながら resultBuffer をリセット
 				for (int32 to = 0; to < (int32)resultBuffer.size(); to++) {
-					if (resultBuffer[to].first > NEGINF) {
+					for (auto plan = resultBuffer.begin(to); plan != resultBuffer.end(to); plan++) {
+						if (plan->profit <= NEGINF) continue;
 						if (wallPath->isReversed()) {
 							result.push_back(Answer{
 								.from = to,
 								.to = from,
-								.profit = resultBuffer[to].first,
-								.firstMove = ShortenMove::Decode(resultBuffer[to].second, agent)
+								.profit = plan->profit,
+								.firstMove = ShortenMove::Decode(plan->key, agent)
 							});
 						}
 						else {
 							result.push_back(Answer{
 								.from = from,
 								.to = to,
-								.profit = resultBuffer[to].first,
-								.firstMove = ShortenMove::Decode(resultBuffer[to].second, agent)
+								.profit = plan->profit,
+								.firstMove = ShortenMove::Decode(plan->key, agent)
 							});
 						}
-						resultBuffer[to] = bufferDefaultVal;
 					}
+					resultBuffer.reset(to);
 				}
 			}
-
+		};
+
+		// まとまりごとの答えを、並列にしないときと同じ順に連結する
+		Array<Array<Answer>> batchResults(batches.size());
+		if (m_threadPool) {
+			TaskGroup group(*m_threadPool, m_cancellationToken);
+			for (size_t i = 0; i < batches.size(); i++) {
+				group.run([&, i] { solveBatch(batches[i], batchResults[i]); });
+			}
+			group.wait();
+		}
+		else {
+			for (size_t i = 0; i < batches.size(); i++) {
+				if (m_cancellationToken && m_cancellationToken->isCancelled()) break;
+				solveBatch(batches[i], batchResults[i]);
+			}
 		}
 
+		Array<Answer> result;
+		for (auto& batchResult : batchResults) result.append(batchResult);
 		return result;
 	}
 
@@ -103,6 +155,35 @@ namespace Procon34 {
 		return m_diagGraph->numberOfBases();
 	}
 
+	void ConstructWallPath2::setPlanCount(int32 planCount) {
+		if (planCount < 1 || RankedPlanTable<ShortenMove::Type>::MaxPlanCount < planCount) throw Error(U"error at ConstructWallPath2::setPlanCount : planCount is out of range");
+		m_planCount = planCount;
+	}
+
+	int32 ConstructWallPath2::getPlanCount() const {
+		return m_planCount;
+	}
+
+	void ConstructWallPath2::setCancellationToken(std::shared_ptr<const CancellationToken> cancellationToken) {
+		m_cancellationToken = cancellationToken;
+	}
+
+	void ConstructWallPath2::setThreadPool(ThreadPool* threadPool) {
+		m_threadPool = threadPool;
+	}
+
+	void ConstructWallPath2::setStartBases(Optional<Array<int32>> startBases) {
+		if (!startBases) {
+			m_isStartBase = none;
+			return;
+		}
+		m_isStartBase = Array<bool>(getNumberOfBases(), false);
+		for (int32 base : *startBases) {
+			if (base < 0 || getNumberOfBases() <= base) throw Error(U"error at ConstructWallPath2::setStartBases : base is out of range");
+			(*m_isStartBase)[base] = true;
+		}
+	}
+
 
 }
 
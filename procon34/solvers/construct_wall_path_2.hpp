@@ -3,6 +3,8 @@
 #include "grid_walking.hpp"
 #include "diag_graph.hpp"
 #include "grid_shortpath_2.hpp"
+#include "cancellation.hpp"
+#include "thread_pool.hpp"
 
 namespace Procon34 {
 
@@ -25,14 +27,37 @@ namespace Procon34 {
 		// turnProfit[k] : k ターンかかるときの追加利得（ k について単調減少を想定）
 		// 
 		// from から to まで壁を作るときの最大利得と最初の操作、をたくさん返す。
+		// (from, to) ごとに、最初の操作が異なるものを利得の大きい順に最大 getPlanCount() 個返す（先頭が最良）。
 		Array<Answer> solve(Agent agent, int32 maxTurn, Array<int64> turnProfit);
 
+		// GridWalking の結果を外から与える（ GridWalking::solveAll でまとめて求めたものを使い回す）
+		Array<Answer> solve(Agent agent, int32 maxTurn, Array<int64> turnProfit, const GridWalking::Answer& gridWalkingAnswer);
+
 		int32 getNumberOfBases();
 
+		// (from, to) ごとに返す答えの個数の上限。初期値は 1
+		void setPlanCount(int32 planCount);
+		int32 getPlanCount() const;
+
+		// 打ち切られると、 solve はそれまでに求まったぶんだけを返す
+		void setCancellationToken(std::shared_ptr<const CancellationToken> cancellationToken);
+
+		// 与えると、 solve は壁の始点のまとまりごとにタスクに分けて threadPool で解く（ solve を同時に呼んでもよい）。
+		// nullptr なら呼んだスレッドで解く。初期値は nullptr
+		void setThreadPool(ThreadPool* threadPool);
+
+		// 与えると、 solve は壁を作り始める base がこれらのものだけを解く（逆向きの WallPath2 では Answer::to が作り始める base ）。
+		// none ならすべて。初期値は none
+		void setStartBases(Optional<Array<int32>> startBases);
+
 	private:
 		std::shared_ptr<DiagonalGraph> m_diagGraph;
 		std::shared_ptr<GridWalking> m_gridWalking;
 		Array<std::shared_ptr<WallPath2>> m_wallPathInstances;
+		std::shared_ptr<const CancellationToken> m_cancellationToken;
+		ThreadPool* m_threadPool = nullptr;
+		Optional<Array<bool>> m_isStartBase;
+		int32 m_planCount = 1;
 	};
 
 }
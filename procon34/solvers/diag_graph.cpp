@@ -1,6 +1,7 @@
 ﻿#pragma once
 #include "diag_graph.hpp"
 #include "../dsu_fast.hpp"
+#include "profiler.hpp"
 
 namespace Procon34 {
 
@@ -12,6 +13,8 @@ namespace Procon34 {
 		: m_game(game)
 		, m_territoryScore(std::move(territoryScore))
 	{
+		PROCON34_PROFILE_SCOPE("DiagonalGraph::DiagonalGraph");
+
 		auto board = m_game->getBoard();
 		auto boardSize = board->getSize();
 		int32 height = board->getHeight();
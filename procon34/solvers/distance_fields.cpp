@@ -0,0 +1,91 @@
+﻿#include "distance_fields.hpp"
+#include "profiler.hpp"
+
+namespace Procon34 {
+
+	DistanceFields::DistanceFields(const GameState& state) {
+		PROCON34_PROFILE_SCOPE("DistanceFields::DistanceFields");
+
+		auto board = state.getBoard();
+		int32 h = board->getHeight();
+		int32 w = board->getWidth();
+		m_paddedWidth = w + 2;
+		m_cellCount = (h + 2) * (w + 2);
+
+		for (int32 d = 0; d < 8; d++) {
+			auto moved = BoardPos(0, 0).movedAlong(MoveDirection(d));
+			m_offset[d] = moved.r * m_paddedWidth + moved.c;
+		}
+
+		for (auto player : GameState::AllPlayers()) {
+			auto opponent = GameState::OpponentOf(player);
+			auto& enterCost = m_enterCost[player];
+			auto& agentCount = m_agentCountAround8[player];
+			auto& wallCount = m_wallCountAround4[player];
+			enterCost.assign(m_cellCount, 0);
+			agentCount.assign(m_cellCount, 0);
+			wallCount.assign(m_cellCount, 0);
+
+			for (int32 r = 0; r < h; r++) for (int32 c = 0; c < w; c++) {
+				auto pos = BoardPos(r, c);
+				const Mass& mass = (*board)[pos];
+				int32 idx = toIndex(pos);
+				if (mass.biome == MassBiome::Pond) enterCost[idx] = 0;
+				else if (mass.hasWallOf(opponent)) enterCost[idx] = 2;
+				else enterCost[idx] = 1;
+
+				if (mass.hasWallOf(player)) {
+					for (int32 d = 0; d < 8; d += 2) wallCount[idx + m_offset[d]]++;
+				}
+			}
+
+			Array<int32> sources;
+			for (auto& agent : state.getAgents(player)) {
+				int32 idx = toIndex(agent.pos);
+				for (int32 d = 0; d < 8; d++) agentCount[idx + m_offset[d]]++;
+				sources.push_back(idx);
+				m_agentDistance[player].push_back(bucketedBfs(player, { idx }));
+			}
+			m_nearestDistance[player] = bucketedBfs(player, sources);
+		}
+	}
+
+	std::shared_ptr<const DistanceFields> DistanceFields::Of(const BoxPtr<const GameState>& state) {
+		return state->getComputed<DistanceFields>();
+	}
+
+	Array<int32> DistanceFields::bucketedBfs(PlayerColor color, const Array<int32>& sources) const {
+		const auto& enterCost = m_enterCost[color];
+		Array<int32> dist(m_cellCount, Unreachable);
+		std::array<Array<int32>, 3> buckets;
+
+		for (int32 s : sources) {
+			dist[s] = 0;
+			buckets[0].push_back(s);
+		}
+
+		size_t pending = sources.size();
+		for (int32 d = 0; pending > 0; d++) {
+			auto& bucket = buckets[d % 3];
+			// ここで追加されるのは d + 1 , d + 2 のバケットだけなので、 bucket は伸びない
+			for (int32 v : bucket) {
+				if (dist[v] != d) continue;
+				for (int32 dir = 0; dir < 8; dir++) {
+					int32 u = v + m_offset[dir];
+					int32 cost = enterCost[u];
+					if (cost == 0) continue;
+					if (cost == 2 && dir % 2 != 0) continue; // 相手の壁には 4 方向からだけ
+					if (dist[u] <= d + cost) continue;
+					dist[u] = d + cost;
+					buckets[(d + cost) % 3].push_back(u);
+					pending++;
+				}
+			}
+			pending -= bucket.size();
+			bucket.clear();
+		}
+
+		return dist;
+	}
+
+}
@@ -0,0 +1,80 @@
+﻿#pragma once
+#include "../stdafx.h"
+#include "../game_state.hpp"
+
+namespace Procon34 {
+
+	// 1 ターンの間、複数の解法で共有する距離の情報。
+	// DistanceFields::Of(state) で取得すると、同じ盤面に対しては 1 回だけ計算される。
+	//
+	// 距離は職人の移動に必要なターン数で、
+	//  - 8 方向に 1 ターンで移動できる
+	//  - 盤外と池には入れない
+	//  - 相手の壁には 4 方向からだけ入れて、解体と移動で 2 ターンかかる
+	// とする。他の職人は動くので障害物とはみなさない。
+	class DistanceFields {
+	public:
+
+		// 到達できないマスの距離
+		static constexpr int32 Unreachable = 1 << 28;
+
+		explicit DistanceFields(const GameState& state);
+
+		// state に保存されたものを返す。なければ計算する
+		static std::shared_ptr<const DistanceFields> Of(const BoxPtr<const GameState>& state);
+
+		// 職人 agent から pos までの距離
+		int32 distance(AgentMarker agent, BoardPos pos) const { return m_agentDistance[agent.color][agent.index][toIndex(pos)]; }
+
+		// 色 color の職人のうち、最も近いものから pos までの距離
+		int32 nearestDistance(PlayerColor color, BoardPos pos) const { return m_nearestDistance[color][toIndex(pos)]; }
+
+		// 色 color の職人が pos から dir の方向へ進むのにかかるターン数。進めないなら 0
+		int32 moveCost(PlayerColor color, BoardPos pos, MoveDirection dir) const {
+			int32 cost = m_enterCost[color][toIndex(pos) + m_offset[dir.value()]];
+			if (cost == 2 && !dir.is4Direction()) return 0;
+			return cost;
+		}
+
+		// pos の周囲 8 マスにいる色 color の職人の数
+		int32 agentCountAround8(PlayerColor color, BoardPos pos) const { return m_agentCountAround8[color][toIndex(pos)]; }
+
+		// pos の周囲 4 マスにある色 color の壁の数
+		int32 wallCountAround4(PlayerColor color, BoardPos pos) const { return m_wallCountAround4[color][toIndex(pos)]; }
+
+		// ---- 外周に 1 マスずつ足した盤面を 1 次元の配列として参照する ----
+
+		// pos の添え字
+		int32 toIndex(BoardPos pos) const { return (pos.r + 1) * m_paddedWidth + (pos.c + 1); }
+
+		int32 paddedWidth() const { return m_paddedWidth; }
+
+		int32 paddedCellCount() const { return m_cellCount; }
+
+		// MoveDirection ごとの添え字の差
+		const std::array<int32, 8>& indexOffsets() const { return m_offset; }
+
+		// 色 color の職人がそのマスに入るのにかかるターン数（ 0 : 入れない , 2 : 4 方向からだけ入れる）
+		const Array<uint8>& enterCostPlane(PlayerColor color) const { return m_enterCost[color]; }
+
+		// 職人 agent からの距離
+		const Array<int32>& distancePlane(AgentMarker agent) const { return m_agentDistance[agent.color][agent.index]; }
+
+	private:
+
+		// 距離が 1 か 2 だけ増える辺しかないので、 3 つのバケットを使い回す BFS
+		Array<int32> bucketedBfs(PlayerColor color, const Array<int32>& sources) const;
+
+		int32 m_paddedWidth;
+		int32 m_cellCount;
+		std::array<int32, 8> m_offset; // MoveDirection ごとの添え字の差
+
+		EachPlayer<Array<uint8>> m_enterCost; // 0 : 入れない , 1 : 通常 , 2 : 相手の壁
+		EachPlayer<Array<Array<int32>>> m_agentDistance;
+		EachPlayer<Array<int32>> m_nearestDistance;
+		EachPlayer<Array<int32>> m_agentCountAround8;
+		EachPlayer<Array<int32>> m_wallCountAround4;
+
+	};
+
+}
@@ -334,23 +334,76 @@ namespace Procon34 {
 		}
 
 		NodeId node = getNodeId(agent.pos, agent.pos);
-		Array<Array<std::pair<int64, int32>>> dp(turnCount + 1, Array<std::pair<int64, int32>>(nodes.size(), std::make_pair(-1001001001001001001, -1)));
+		if (node < 0) return {};
+
+		// dp[turn][v] = (利得, 最後に使った辺) の最大値。
+		// 到達できた状態だけを、ターンの小さい順に広げていく。
+		// 値は直近 3 ターンぶん（辺の所要ターン数は 2 以下）の配列を使いまわし、
+		// 経路復元のために、確定した状態の (ノード, 辺) の組だけを全ターンぶん残す。
+		constexpr int32 LayerCount = 3;
+		constexpr int64 Unreached = std::numeric_limits<int64>::min();
+		const std::pair<int64, int32> unreachedValue = { Unreached, -1 };
+
+		struct BackPointer {
+			NodeId node;
+			int32 edgeIndex;
+		};
+
+		std::array<Array<std::pair<int64, int32>>, LayerCount> dp;
+		std::array<Array<NodeId>, LayerCount> frontiers;
+		for (auto& layer : dp) layer.assign(nodes.size(), unreachedValue);
+		Array<Array<BackPointer>> backPointers(turnCount + 1);
+
 		dp[0][node] = { 0, -1 };
-		for (int32 turn = 0; turn < turnCount; turn++) {
-			for (int32 ei = 0; ei < (int32)edges.size(); ei++) {
-				auto e = edges[ei];
-				if (usedNode[e.from] == 0) continue;
-				if (usedNode[e.to] == 0) continue;
-				if (e.turns + turn <= turnCount) {
-					dp[e.turns + turn][e.to] = std::max(dp[e.turns + turn][e.to], std::make_pair(dp[turn][e.from].first + e.cost, ei));
+		frontiers[0].push_back(node);
+		for (int32 turn = 0; turn <= turnCount; turn++) {
+			auto& current = dp[turn % LayerCount];
+			auto& frontier = frontiers[turn % LayerCount];
+
+			// このターンの状態は確定した
+			frontier.sort();
+			backPointers[turn].reserve(frontier.size());
+			for (NodeId v : frontier) backPointers[turn].push_back(BackPointer{ v, current[v].second });
+
+			if (turn < turnCount) {
+				for (NodeId v : frontier) {
+					if (usedNode[v] == 0) continue;
+					int64 profit = current[v].first;
+					for (int32 ei = edgesSeparators[v]; ei < edgesSeparators[v + 1]; ei++) {
+						auto& e = edges[ei];
+						if (usedNode[e.to] == 0) continue;
+						if (e.turns + turn > turnCount) continue;
+						auto& next = dp[(turn + e.turns) % LayerCount][e.to];
+						auto candidate = std::make_pair(profit + e.cost, ei);
+						if (next.first == Unreached) {
+							frontiers[(turn + e.turns) % LayerCount].push_back(e.to);
+							next = candidate;
+						}
+						else {
+							next = std::max(next, candidate);
+						}
+					}
 				}
 			}
+
+			// 3 ターン後の層として使いまわす
+			for (NodeId v : frontier) current[v] = unreachedValue;
+			frontier.clear();
 		}
+
+		auto findBackPointer = [&](int32 turn, NodeId v) -> int32 {
+			auto& list = backPointers[turn];
+			auto iter = std::lower_bound(list.begin(), list.end(), v, [](const BackPointer& l, NodeId r) { return l.node < r; });
+			if (iter == list.end() || iter->node != v) return -1;
+			return iter->edgeIndex;
+		};
+
 		auto pos = node;
 		Array<AgentMove> res;
-		for (int32 turn = turnCount; turn > 0; turn--) {
-			if (dp[turn][pos].second < 0) break;
-			auto edge = edges[dp[turn][pos].second];
+		for (int32 turn = turnCount; turn > 0; ) {
+			int32 edgeIndex = findBackPointer(turn, pos);
+			if (edgeIndex < 0) break;
+			auto edge = edges[edgeIndex];
 			switch (edge.type) {
 				// type 0 : 職人が移動
 				// type 1 : 壁を建設
@@ -362,16 +415,18 @@ namespace Procon34 {
 			case 1:
 				res.push_back(AgentMove::GetConstruct(agent, edge.direction));
 				break;
+			// 最後に反転するので、後に行う操作から入れる
 			case 2:
-				res.push_back(AgentMove::GetDestroy(agent, edge.direction));
 				res.push_back(AgentMove::GetMove(agent, edge.direction));
+				res.push_back(AgentMove::GetDestroy(agent, edge.direction));
 				break;
 			case 3:
-				res.push_back(AgentMove::GetDestroy(agent, edge.direction));
 				res.push_back(AgentMove::GetConstruct(agent, edge.direction));
+				res.push_back(AgentMove::GetDestroy(agent, edge.direction));
 				break;
 			}
 			pos = edge.from;
+			turn -= edge.turns;
 		}
 		res.reverse();
 
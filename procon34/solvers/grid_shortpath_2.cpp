@@ -1,9 +1,225 @@
 ﻿#pragma once
 #include "grid_shortpath_2.hpp"
 #include "../game_state.hpp"
+#include "profiler.hpp"
+#include <bit>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 namespace Procon34 {
 
+	namespace {
+
+		// 最初のターンにその辺を使ったときの行動
+		ShortenMove::Type FirstMoveOf(const WallPath2::EdgeDesc& edge) {
+			switch (edge.type) {
+			case 0:
+				return ShortenMove::Move(edge.direction);
+			case 1:
+				return ShortenMove::Construct(edge.direction);
+			default:
+				return ShortenMove::Destroy(edge.direction);
+			}
+		}
+
+		constexpr int32 Unvisited = std::numeric_limits<int32>::max();
+
+		// solve の作業領域。呼び出しごとに確保しなおさないよう、スレッドごとに使いまわす。
+		// visited は使い終わったら触ったところだけ Unvisited に戻す。
+		struct SolveWorkspace {
+			Array<int32> visited; // [元のノード番号] = 距離
+			Array<uint16> compressedId; // [元のノード番号] = 圧縮後のノード番号（今の BFS で訪れたノードだけ有効）
+			Array<int32> nx0, nx1, nx2;
+			Array<std::pair<int32, int32>> starters;
+			WallPath2::CompressedByDistance compressed;
+			Array<size_t> distanceArrayOffset;
+			Array<int64> profitTable;
+			Array<uint8> firstMoveTable;
+
+			void prepare(size_t nodeCount) {
+				if (visited.size() < nodeCount) {
+					visited.resize(nodeCount, Unvisited);
+					compressedId.resize(nodeCount);
+				}
+			}
+		};
+
+		thread_local SolveWorkspace t_solveWorkspace;
+
+		// ws.starters から距離ごとの層に分け、 ws.compressed と ws.compressedId に書く
+		void CompressByDistance(const WallPath2& wallPath, int32 maxDistance, SolveWorkspace& ws) {
+			auto& starters = ws.starters;
+			auto& visited = ws.visited;
+			auto& nx0 = ws.nx0;
+			auto& nx1 = ws.nx1;
+			auto& nx2 = ws.nx2;
+			auto& nodesMapping = ws.compressed.nodesMapping;
+			auto& distanceSeparator = ws.compressed.distanceSeparator;
+
+			starters.sort_by([](auto l, auto r) { return l.second < r.second; });
+			size_t starterPointer = 0;
+
+			nodesMapping.clear();
+			distanceSeparator.assign(1, 0);
+			nx1.clear();
+			nx2.clear();
+
+			for (int32 dist = 0; dist <= maxDistance; dist++) {
+				while (starterPointer < starters.size() && starters[starterPointer].second <= dist) {
+					int pos = starters[starterPointer].first;
+					if (visited[pos] > dist) {
+						nx1.push_back(pos);
+						visited[pos] = dist;
+					}
+					starterPointer++;
+				}
+
+				// nx0 = nx1, nx1 = nx2, nx2 = {} を、確保しなおさずに行う
+				std::swap(nx0, nx1);
+				std::swap(nx1, nx2);
+				nx2.clear();
+
+				for (int32 v : nx0) if (visited[v] == dist) {
+					ws.compressedId[v] = (uint16)nodesMapping.size();
+					nodesMapping.push_back(v);
+					for (int32 turns = 1; turns <= 2; turns++) {
+						int32 nxdist = turns + dist;
+						if (nxdist > maxDistance) continue;
+						auto& edges = wallPath.edgesByTurns[turns - 1];
+						auto& nx = (turns == 2 ? nx2 : nx1);
+						for (int32 ei = edges.separator[v]; ei < edges.separator[v + 1]; ei++) {
+							int32 to = edges.to[ei];
+							if (nxdist >= visited[to]) continue;
+							nx.push_back(to);
+							visited[to] = nxdist;
+						}
+					}
+				}
+
+				distanceSeparator.push_back((int32)nodesMapping.size());
+			}
+
+			for (int32 v : nodesMapping) visited[v] = Unvisited;
+		}
+
+		// 1 つのノードから出る辺 [0, count) について、 candidates[i] = srcValue + cost[i] と targets[i] = compressedId[to[i]] を求め、
+		// candidates[i] > dstProfit[targets[i]] となる辺のビットを立てて返す（ count <= 64 ）。
+		// dstProfit は緩和で増えるだけなので、ここで立たなかった辺は書き込みでも更新しない
+		uint64 GatherImproved(
+			const uint16* to, const int64* cost, int32 count, const uint16* compressedId,
+			int64 srcValue, const int64* dstProfit,
+			int32* targets, int64* candidates
+		) {
+			uint64 improved = 0;
+			for (int32 i = 0; i < count; i++) targets[i] = compressedId[to[i]];
+			int32 i = 0;
+#ifdef __AVX2__
+			__m256i source = _mm256_set1_epi64x(srcValue);
+			for (; i + 4 <= count; i += 4) {
+				__m128i index = _mm_loadu_si128(reinterpret_cast<const __m128i*>(targets + i));
+				__m256i current = _mm256_i32gather_epi64(reinterpret_cast<const long long*>(dstProfit), index, 8);
+				__m256i candidate = _mm256_add_epi64(source, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cost + i)));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(candidates + i), candidate);
+				uint64 mask = (uint64)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(candidate, current)));
+				improved |= mask << i;
+			}
+#endif
+			for (; i < count; i++) {
+				candidates[i] = srcValue + cost[i];
+				if (candidates[i] > dstProfit[targets[i]]) improved |= (uint64)1 << i;
+			}
+			return improved;
+		}
+
+		// 圧縮後のノード [0, nodeCount) から出る辺で、 src の層から dst の層へ緩和する。
+		// 候補値と更新先の値はノードの辺の範囲ごとにまとめて集め、書き込みは辺の順に行う（同じ値なら先の辺・既存の値を優先するため）。
+		void RelaxEdges(
+			const WallPath2::EdgeArrays& edges,
+			const int32* nodesMapping, int32 nodeCount, const uint16* compressedId,
+			const int64* srcProfit, const uint8* srcFirstMove,
+			int64* dstProfit, uint8* dstFirstMove,
+			bool isFirstTurn
+		) {
+			constexpr int32 BatchSize = 64;
+			alignas(32) int64 candidates[BatchSize];
+			alignas(32) int32 targets[BatchSize];
+			const uint16* to = edges.to.data();
+			const int64* cost = edges.cost.data();
+			for (int32 node = 0; node < nodeCount; node++) {
+				int32 v = nodesMapping[node];
+				int64 srcValue = srcProfit[node];
+				// 最初のターンは具体的に行動を入力、それ以外は引き継ぐ
+				uint8 inheritedMove = srcFirstMove[node];
+				int32 edgeEnd = edges.separator[v + 1];
+				for (int32 begin = edges.separator[v]; begin < edgeEnd; begin += BatchSize) {
+					int32 count = Min(BatchSize, edgeEnd - begin);
+					uint64 improved = GatherImproved(to + begin, cost + begin, count, compressedId, srcValue, dstProfit, targets, candidates);
+					// 同じ範囲に同じ更新先の辺があると、集めた値より後で増えていることがあるので、書き込む前に比べなおす
+					for (; improved != 0; improved &= improved - 1) {
+						int32 i = std::countr_zero(improved);
+						int32 target = targets[i];
+						if (candidates[i] <= dstProfit[target]) continue;
+						dstProfit[target] = candidates[i];
+						dstFirstMove[target] = isFirstTurn ? edges.firstMove[begin + i] : inheritedMove;
+					}
+				}
+			}
+		}
+
+		// ws.starters （ nodeId と turnCount ）は呼ぶ前に書いておく
+		Array<WallPath2::MovingState> SolveWith(const WallPath2& wallPath, int32 maxTurn, const Array<WallPath2::MovingState>& starters, SolveWorkspace& ws) {
+			CompressByDistance(wallPath, maxTurn, ws);
+			auto& compressedGraph = ws.compressed;
+
+			auto& distanceArrayOffset = ws.distanceArrayOffset;
+			distanceArrayOffset.assign(maxTurn + 2, 0);
+			for (int32 d = 0; d <= maxTurn; d++) distanceArrayOffset[d + 1] = distanceArrayOffset[d] + compressedGraph.distanceSeparator[d + 1];
+
+			// DP 表は利得と最初の行動を別々の平坦な配列で持つ
+			auto& profitTable = ws.profitTable;
+			auto& firstMoveTable = ws.firstMoveTable;
+			profitTable.assign(distanceArrayOffset.back(), -1001001001001001);
+			firstMoveTable.assign(distanceArrayOffset.back(), (uint8)ShortenMove::Stay());
+
+			// 初期状態を反映
+			for (auto& starter : starters) {
+				size_t resultArrayIndex = distanceArrayOffset[starter.turnCount] + ws.compressedId[starter.nodeId];
+				profitTable[resultArrayIndex] = starter.offsetProfit;
+				firstMoveTable[resultArrayIndex] = (uint8)starter.firstMove;
+			}
+
+			// 動的計画法で表全体を計算
+
+			for (int32 turnId = 0; turnId < maxTurn; turnId++) {
+				for (int32 turns = 1; turns <= 2; turns++) {
+					if (turnId + turns > maxTurn) continue;
+					RelaxEdges(
+						wallPath.edgesByTurns[turns - 1],
+						compressedGraph.nodesMapping.data(), compressedGraph.distanceSeparator[turnId + 1], ws.compressedId.data(),
+						profitTable.data() + distanceArrayOffset[turnId], firstMoveTable.data() + distanceArrayOffset[turnId],
+						profitTable.data() + distanceArrayOffset[turnId + turns], firstMoveTable.data() + distanceArrayOffset[turnId + turns],
+						turnId == 0
+					);
+				}
+			}
+
+			Array<WallPath2::MovingState> result(distanceArrayOffset.back());
+			for (int32 turnId = 0; turnId <= maxTurn; turnId++) {
+				for (int32 nodeId = 0; nodeId < compressedGraph.distanceSeparator[turnId + 1]; nodeId++) {
+					size_t index = distanceArrayOffset[turnId] + nodeId;
+					result[index].nodeId = compressedGraph.nodesMapping[nodeId];
+					result[index].turnCount = turnId;
+					result[index].firstMove = firstMoveTable[index];
+					result[index].offsetProfit = profitTable[index];
+				}
+			}
+
+			return result;
+		}
+
+	}
+
 	WallPath2::NodeId WallPath2::getNodeId(BoardPos agentPos, int32 baseId) {
 		auto& ref = nodesIndexedByAgentPos[agentPos.asPoint()];
 		auto iter = std::lower_bound(ref.begin(), ref.end(), std::make_pair(baseId, -1));
@@ -29,6 +245,7 @@ namespace Procon34 {
 		, enabledDifference(_enabledDifference)
 		, m_asReversed(asReversed)
 	{
+		PROCON34_PROFILE_SCOPE("WallPath2::WallPath2");
 
 		// 既存の壁の連結成分の計算
 
@@ -183,11 +400,30 @@ namespace Procon34 {
 		for (auto& e : edges) edgesSeparators[e.from + 1]++;
 		for (size_t i = 0; i < nodes.size(); i++) edgesSeparators[i + 1] += edgesSeparators[i];
 
+		// 緩和のループ用に、所要ターン数ごとに分けた SoA も作る
+		if (nodes.size() > MaxNodeCount) throw Error(U"error at WallPath2::WallPath2 : too many nodes");
+		for (int32 turns = 1; turns <= 2; turns++) {
+			auto& edgesOut = edgesByTurns[turns - 1];
+			edgesOut.separator.assign(nodes.size() + 1, 0);
+			for (auto& e : edges) if (e.turns == turns) {
+				edgesOut.to.push_back((uint16)e.to);
+				edgesOut.firstMove.push_back((uint8)FirstMoveOf(e));
+				edgesOut.cost.push_back(e.cost);
+				edgesOut.separator[e.from + 1]++;
+			}
+			for (size_t i = 0; i < nodes.size(); i++) edgesOut.separator[i + 1] += edgesOut.separator[i];
+		}
+
 	}
 
 	Array<Point> WallPath2::EnabledDifferenceDefaultValue() {
+		return EnabledDifferenceWithRadius(5);
+	}
+
+	Array<Point> WallPath2::EnabledDifferenceWithRadius(int32 radius) {
 		Array<Point> res;
-		for (int32 dx = -1; dx <= 2; dx++) for (int32 dy = -1; dy <= 2; dy++) if (abs(dx * 2 - 1) + abs(dy * 2 - 1) <= 5) {
+		int32 range = (radius + 1) / 2;
+		for (int32 dx = 1 - range; dx <= range; dx++) for (int32 dy = 1 - range; dy <= range; dy++) if (abs(dx * 2 - 1) + abs(dy * 2 - 1) <= radius) {
 			res.push_back(Point(dx, dy));
 		}
 		return res;
@@ -195,136 +431,36 @@ namespace Procon34 {
 
 
 	WallPath2::CompressedByDistance WallPath2::compressGraphsByDistance(int32 maxDistance, Array<std::pair<int32, int32>> starters) const {
-		starters.sort_by([](auto l, auto r) { return l.second < r.second; });
-		size_t starterPointer = 0;
-
-		Array<int32> nodesMapping;
-		Array<int32> distanceSeparator = { 0 };
-		Array<EdgeDesc> newEdges;
-		Array<int32> newEdgesSeparators;
-
-		Array<int32> visited(nodes.size(), maxDistance + 1);
-		Array<int32> nx1, nx2;
-		for (int32 dist = 0; dist <= maxDistance; dist++) {
-			while (starterPointer < starters.size() && starters[starterPointer].second <= dist) {
-				int pos = starters[starterPointer].first;
-				if (visited[pos] > dist) {
-					nx1.push_back(pos);
-					visited[pos] = dist;
-				}
-				starterPointer++;
-			}
-
-			auto nx0 = std::move(nx1);
-			nx1 = std::move(nx2);
-			nx2 = {};
-
-			for (int32 v : nx0) if (visited[v] == dist) {
-				nodesMapping.push_back(v);
-				for (int32 ei = edgesSeparators[v]; ei < edgesSeparators[v + 1]; ei++) {
-					auto& e = edges[ei];
-					newEdges.push_back(e);
-					int32 nxdist = e.turns + dist;
-					if (nxdist >= visited[e.to]) continue;
-					(e.turns == 2 ? nx2 : nx1).push_back(e.to);
-					visited[e.to] = nxdist;
-				}
-			}
-
-			newEdgesSeparators.push_back((int32)newEdges.size());
-
-
-			distanceSeparator.push_back((int32)nodesMapping.size());
-		}
-
-		Array<int32> nodesInverseMapping(nodes.size());
-		for (int32 i = 0; i < (int32)nodesMapping.size(); i++) {
-			nodesInverseMapping[nodesMapping[i]] = i;
-		}
-		for (auto& e : newEdges) {
-			e.from = nodesInverseMapping[e.from];
-			e.to = nodesInverseMapping[e.to];
-		}
-
-		CompressedByDistance res;
-		res.distanceSeparator = std::move(distanceSeparator);
-		res.edges = std::move(newEdges);
-		res.edgesSeparator = std::move(newEdgesSeparators);
-		res.nodesMapping = std::move(nodesMapping);
-
-		return res;
+		auto& ws = t_solveWorkspace;
+		ws.prepare(nodes.size());
+		ws.starters = std::move(starters);
+		CompressByDistance(*this, maxDistance, ws);
+		return ws.compressed;
 	}
 
 
 	Array<WallPath2::MovingState> WallPath2::solve(int32 maxTurn, Array<MovingState> starters) {
-		auto callCompressGraphsByDistance = [&]() -> WallPath2::CompressedByDistance {
-			Array<std::pair<int32, int32>> newStarters;
-			for (auto& start : starters) {
-				newStarters.push_back(std::make_pair(start.nodeId, start.turnCount));
-			}
-			return compressGraphsByDistance(maxTurn, std::move(newStarters));
-		};
-		auto compressedGraph = callCompressGraphsByDistance();
-
-		Array<size_t> distanceArrayOffset(maxTurn + 2, 0);
-		for (int32 d = 0; d <= maxTurn; d++) distanceArrayOffset[d + 1] = distanceArrayOffset[d] + compressedGraph.distanceSeparator[d + 1];
-
-		WallPath2::MovingState ini;
-		ini.offsetProfit = -1001001001001001;
-		Array<WallPath2::MovingState> result(distanceArrayOffset.back(), ini);
-
-		// 初期状態を result に反映
-		{
-			Array<int32> originalToCompressed(nodes.size());
-			for (int32 i = 0; i < (int32)compressedGraph.nodesMapping.size(); i++) {
-				originalToCompressed[compressedGraph.nodesMapping[i]] = i;
-			}
-			for (auto& starter : starters) {
-				size_t resultArrayIndex = distanceArrayOffset[starter.turnCount] + originalToCompressed[starter.nodeId];
-				result[resultArrayIndex] = starter;
-			}
+		auto& ws = t_solveWorkspace;
+		ws.prepare(nodes.size());
+		ws.starters.clear();
+		for (auto& start : starters) {
+			ws.starters.push_back(std::make_pair(start.nodeId, start.turnCount));
 		}
+		return SolveWith(*this, maxTurn, starters, ws);
+	}
 
-		// 動的計画法で result 全体を計算
-
-		for (int32 turnId = 0; turnId <= maxTurn; turnId++) {
-			for (int32 nodeId = 0; nodeId < compressedGraph.distanceSeparator[turnId + 1]; nodeId++) {
-				result[distanceArrayOffset[turnId] + nodeId].turnCount = turnId;
-				result[distanceArrayOffset[turnId] + nodeId].nodeId = compressedGraph.nodesMapping[nodeId];
-			}
-			if (turnId != maxTurn) {
-				for (int32 edgeId = 0; edgeId < compressedGraph.edgesSeparator[turnId]; edgeId++) {
-					auto& edge = compressedGraph.edges[edgeId];
-					if (turnId + edge.turns > maxTurn) continue;
-					size_t prevIndex = distanceArrayOffset[turnId] + edge.from;
-					size_t toIndex = distanceArrayOffset[turnId + edge.turns] + edge.to;
-					int64 nextProfit = result[prevIndex].offsetProfit + edge.cost;
-					if (nextProfit <= result[toIndex].offsetProfit) continue;
-					result[toIndex].offsetProfit = nextProfit;
-
-					// 最初のターンは具体的に行動を入力、それ以外は引き継ぐ
-					if (turnId == 0) {
-						switch (edge.type) {
-						case 0:
-							result[toIndex].firstMove = ShortenMove::Move(edge.direction);
-							break;
-						case 1:
-							result[toIndex].firstMove = ShortenMove::Construct(edge.direction);
-							break;
-						case 2:
-						case 3:
-							result[toIndex].firstMove = ShortenMove::Destroy(edge.direction);
-							break;
-						}
-					}
-					else {
-						result[toIndex].firstMove = result[prevIndex].firstMove;
-					}
-				}
+	Array<Array<WallPath2::MovingState>> WallPath2::solve(int32 maxTurn, const Array<Array<MovingState>>& starterSets) {
+		auto& ws = t_solveWorkspace;
+		ws.prepare(nodes.size());
+		Array<Array<MovingState>> results(starterSets.size());
+		for (size_t i = 0; i < starterSets.size(); i++) {
+			ws.starters.clear();
+			for (auto& start : starterSets[i]) {
+				ws.starters.push_back(std::make_pair(start.nodeId, start.turnCount));
 			}
+			results[i] = SolveWith(*this, maxTurn, starterSets[i], ws);
 		}
-
-		return result;
+		return results;
 	}
 
 
@@ -36,6 +36,14 @@ namespace Procon34 {
 		// type 2 : 壁を破壊して職人が移動
 		// type 3 : 壁を破壊して壁を建設
 
+		// 辺の SoA 。 BFS と緩和のループで読む値だけを、 from の順に並べて持つ。
+		struct EdgeArrays {
+			Array<uint16> to;
+			Array<uint8> firstMove; // 最初のターンにこの辺を使ったときの行動（ ShortenMove::Type ）
+			Array<int64> cost;
+			Array<int32> separator; // [v] = ノード v より前のノードから出る辺の個数
+		};
+
 
 		// input
 		std::shared_ptr<DiagonalGraph> diagGraph;
@@ -48,6 +56,7 @@ namespace Procon34 {
 		Grid<Array<std::pair<int32, NodeId>>> nodesIndexedByAgentPos;
 		Array<Array<NodeId>> nodesIndexedByBaseid;
 		Array<int32> edgesSeparators;
+		std::array<EdgeArrays, 2> edgesByTurns; // [turns-1] = 所要ターン数が turns の辺
 		bool m_asReversed;
 
 		NodeId getNodeId(BoardPos agentPos, int32 baseId);
@@ -64,14 +73,20 @@ namespace Procon34 {
 
 		static Array<Point> EnabledDifferenceDefaultValue();
 
+		// 職人の座標から見た base の相対位置のうち、マスの中心からの距離（の 2 倍）のマンハッタン距離が radius 以下のもの。
+		// radius = 5 で EnabledDifferenceDefaultValue と一致する。
+		static Array<Point> EnabledDifferenceWithRadius(int32 radius);
+
 
 		struct CompressedByDistance {
 			Array<int32> nodesMapping; // 距離が小さい順にならべたもの。圧縮したグラフではこの順にノードの番号を 0,1,... と振りなおす。
 			Array<int32> distanceSeparator; // [d+1] = 距離 d 以下で行けるノードの個数。ノードのリストは nodesMapping から得られる
-			Array<EdgeDesc> edges; // 圧縮してノード番号を振りなおしたあとの辺
-			Array<int32> edgesSeparator; // [d] = 距離 d 以下のノードから出る辺の個数
+			// 辺はコピーしない。圧縮したグラフのノード i から出る辺は、 edgesByTurns の nodesMapping[i] の範囲。
 		};
 
+		// ノード番号を uint16 で持つので、ノードはこれ以下の個数でなければならない
+		static constexpr size_t MaxNodeCount = 65536;
+
 		// starters : list of (node id, offset distance)
 		CompressedByDistance compressGraphsByDistance(int32 maxDistance, Array<std::pair<int32, int32>> starters) const;
 
@@ -84,6 +99,10 @@ namespace Procon34 {
 
 		Array<MovingState> solve(int32 maxTurn, Array<MovingState> starters);
 
+		// starterSets のそれぞれについて solve と同じ結果を返す。
+		// BFS の作業領域と DP 表を使いまわし、辺は edgesByTurns をそのまま読む。
+		Array<Array<MovingState>> solve(int32 maxTurn, const Array<Array<MovingState>>& starterSets);
+
 	};
 
 }
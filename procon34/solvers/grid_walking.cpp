@@ -1,5 +1,8 @@
 ﻿#pragma once
 #include "grid_walking.hpp"
+#include "profiler.hpp"
+#include "distance_fields.hpp"
+#include "shorten_move.hpp"
 
 namespace Procon34 {
 
@@ -21,96 +24,168 @@ namespace Procon34 {
 	}
 
 	GridWalking::Answer GridWalking::solve(Agent agent, int32 maxTurnCount) {
-		if (maxTurnCount > capableTurnCount) throw Error(U"Error at GridWalking::Answer GridWalking::solve(Agent agent, int32 maxTurnCount) : maxTurnCount > capableTurnCount");
-
-		auto board = game->getBoard();
-		ShortPathAnswer defaultAnswer = ShortPathAnswer{ .firstMove = AgentMove::GetStay(agent), .profit = INT64_MIN / 3 };
-		ShortPathAnswer answerAtInitialPosition = ShortPathAnswer{ .firstMove = AgentMove::GetStay(agent), .profit = 0 };
-		Grid<int32> massRegistoration(boardSize, -1);
-		Array<Array<ShortPathAnswer>> buffer(maxTurnCount + 1);
-
-		Array<BoardPos> positions;
-
-		Array<Array<std::pair<BoardPos, ShortPathAnswer>>> nextBuffer(2);
-		nextBuffer[0].push_back(std::make_pair(agent.pos, answerAtInitialPosition));
-
-		for (int32 turn = 0; turn <= maxTurnCount; turn++) {
-			auto nowBuffer = std::move(nextBuffer[0]);
-			for (size_t i = 1; i < nextBuffer.size(); i++) std::swap(nextBuffer[i - 1], nextBuffer[i]);
-
-			// 今のターンのコスト最善の方法を記録
-			// 新しく登場した座標を登録
-			if(turn != 0) buffer[turn].assign(buffer[turn - 1].size(), defaultAnswer);
-			for (auto& [pos, ans] : nowBuffer) {
-				int massid = massRegistoration[pos.asPoint()];
-				if (massid < 0) {
-					massRegistoration[pos.asPoint()] = (int32)positions.size();
-					positions.push_back(pos);
-					buffer[turn].push_back(ans);
-				}
-				else {
-					if (ans.profit <= buffer[turn][massid].profit) continue;
-					buffer[turn][massid] = ans;
-				}
-			}
-
-			// 次の手も考慮しなければならないなら、
-			//     記録した解をもとにつぎの手を求める
-			if (turn < maxTurnCount) {
+		return solveAll({ agent }, maxTurnCount).front();
+	}
 
-				for (size_t nowPostitionIndex = 0; nowPostitionIndex < positions.size(); nowPostitionIndex++) {
-					auto nowPosition = positions[nowPostitionIndex];
-					ShortPathAnswer prevAns = buffer[turn][nowPostitionIndex];
+	// 各職人について、ターンごとに「そのターンちょうどに各マスにいるときの最大利得」と「最初の行動」を
+	// 外周つきの平坦な配列（値の面）で持ち、方向ごとに行単位でまとめて緩和する。
+	//
+	// 結果は以前の実装（座標と候補を可変長配列に積む方式）と完全に一致させる。
+	//  - 座標の登録順は、その職人からの距離の順で、同じ距離の中では以前の候補の生成順
+	//  - 同じ利得の候補が複数あるときは、生成順で先のものを採用する
+	//  - そのターンちょうどには到達できない登録済みのマスは INT64_MIN / 3 ( Stay )
+	Array<GridWalking::Answer> GridWalking::solveAll(const Array<Agent>& agents, int32 maxTurnCount) {
+		if (maxTurnCount > capableTurnCount) throw Error(U"Error at GridWalking::Answer GridWalking::solveAll(const Array<Agent>& agents, int32 maxTurnCount) : maxTurnCount > capableTurnCount");
+		PROCON34_PROFILE_SCOPE("GridWalking::solveAll");
+
+		const int64 DefaultProfit = INT64_MIN / 3;
+		const int32 NotRegistered = -1;
+		const int32 ExistingKey = -1; // 登録済みのマスにもともとある値は、同じ利得の候補に置き換えられない
+		const int32 NewKey = INT32_MAX;
+
+		auto distanceFields = DistanceFields::Of(game);
+		const int32 height = boardSize.y;
+		const int32 width = boardSize.x;
+		const int32 paddedWidth = distanceFields->paddedWidth();
+		const int32 cellCount = distanceFields->paddedCellCount();
+		const auto& offsets = distanceFields->indexOffsets();
+		const int32 agentCount = (int32)agents.size();
+		const size_t planeCount = (size_t)maxTurnCount + 1;
+
+		// 訪問の利得を外周つきの配列に並べ直す
+		Array<int64> paddedVisitingProfit(planeCount * cellCount, 0);
+		for (int32 t = 0; t <= maxTurnCount; t++) {
+			for (int32 r = 0; r < height; r++) for (int32 c = 0; c < width; c++) {
+				paddedVisitingProfit[t * cellCount + (r + 1) * paddedWidth + (c + 1)] = visitingProfit[t][Point(c, r)];
+			}
+		}
 
-					for (int32 directionVal = 0; directionVal < 8; directionVal++) {
+		// 各職人の座標の登録順を求める（値によらない）
+		Array<Array<int32>> registrationOrder(agentCount); // [agent][登録番号] = 添え字
+		Array<Array<int32>> rank(agentCount, Array<int32>(cellCount, NotRegistered)); // [agent][添え字] = 登録番号
+		Array<Array<int32>> registeredCount(agentCount, Array<int32>(planeCount, 0)); // [agent][turn] = そのターンまでに登録された数
+		for (int32 a = 0; a < agentCount; a++) {
+			const auto& enterCost = distanceFields->enterCostPlane(agents[a].marker.color);
+			auto& order = registrationOrder[a];
+			int32 start = distanceFields->toIndex(agents[a].pos);
+			rank[a][start] = 0;
+			order.push_back(start);
+			registeredCount[a][0] = 1;
+			for (int32 turn = 1; turn <= maxTurnCount; turn++) {
+				// 2 ターン前からの相手の壁を壊して進む候補が先、 1 ターン前からの移動の候補が後
+				// 距離 turn - 3 以下のマスの隣はすべて登録済みなので、それより後に登録されたマスだけ見ればよい
+				int32 frontierBegin = (turn >= 3) ? registeredCount[a][turn - 3] : 0;
+				for (int32 consumeTurns = 2; consumeTurns >= 1; consumeTurns--) {
+					int32 from = turn - consumeTurns;
+					if (from < 0) continue;
+					for (int32 i = frontierBegin; i < registeredCount[a][from]; i++) {
+						int32 q = order[i];
+						for (int32 dir = 0; dir < 8; dir++) {
+							int32 p = q + offsets[dir];
+							if (enterCost[p] != consumeTurns || (consumeTurns == 2 && dir % 2 != 0)) continue;
+							if (rank[a][p] != NotRegistered) continue;
+							rank[a][p] = (int32)order.size();
+							order.push_back(p);
+						}
+					}
+				}
+				registeredCount[a][turn] = (int32)order.size();
+			}
+		}
 
-						auto direction = MoveDirection(directionVal);
-						auto newPosition = nowPosition.movedAlong(direction);
-						if (!board->isOnBoard(newPosition)) continue;   // 盤外に出たらだめ
-						auto newPositionMass = board->getMass(newPosition);
-						if (newPositionMass.biome == MassBiome::Pond) continue; // 池だったらだめ
+		// 値の面 [agent][turn][添え字] と、最初の行動 ( ShortenMove::Type ) の面
+		Array<Array<int64>> profitPlanes(agentCount, Array<int64>(planeCount * cellCount, DefaultProfit));
+		Array<Array<uint8>> firstMovePlanes(agentCount, Array<uint8>(planeCount * cellCount, (uint8)ShortenMove::Stay()));
+		Array<int32> bestKey(cellCount);
 
-						bool hasOpponentWall = newPositionMass.hasWallOf(game->OpponentOf(agent.marker.color));
-						if (!direction.is4Direction() && hasOpponentWall) continue; // 4 方向以外で、敵の壁には進めない
-						ShortPathAnswer nextAnswer = ShortPathAnswer{ .firstMove = buffer[turn][nowPostitionIndex].firstMove, .profit = 0 };
+		for (int32 a = 0; a < agentCount; a++) {
+			int32 start = distanceFields->toIndex(agents[a].pos);
+			profitPlanes[a][start] = 0;
+		}
 
-						// 消費ターン数
-						int32 consumeTurns = hasOpponentWall ? 2 : 1;
-						if (turn + consumeTurns > maxTurnCount) continue; // ターン数オーバー
+		for (int32 turn = 1; turn <= maxTurnCount; turn++) {
+			const int64* visiting = paddedVisitingProfit.data() + (size_t)turn * cellCount;
+
+			for (int32 a = 0; a < agentCount; a++) {
+				const auto& enterCost = distanceFields->enterCostPlane(agents[a].marker.color);
+				const auto& dist = distanceFields->distancePlane(agents[a].marker);
+
+				// turn ターンで届くのは、チェビシェフ距離が turn 以下の範囲だけ
+				auto agentPos = agents[a].pos;
+				int32 rowMin = Max(0, agentPos.r - turn), rowMax = Min(height - 1, agentPos.r + turn);
+				int32 colMin = Max(0, agentPos.c - turn), colMax = Min(width - 1, agentPos.c + turn);
+				const auto& agentRank = rank[a];
+				int64* profit = profitPlanes[a].data() + (size_t)turn * cellCount;
+				uint8* firstMove = firstMovePlanes[a].data() + (size_t)turn * cellCount;
+
+				// このターンに初めて登録されるマスは、最初の候補を必ず採用する
+				for (int32 r = rowMin; r <= rowMax; r++) {
+					int32 rowBegin = (r + 1) * paddedWidth + (colMin + 1);
+					int32 rowEnd = (r + 1) * paddedWidth + (colMax + 1);
+					for (int32 p = rowBegin; p <= rowEnd; p++) {
+						bool isNew = dist[p] == turn;
+						profit[p] = isNew ? INT64_MIN : DefaultProfit;
+						bestKey[p] = isNew ? NewKey : ExistingKey;
+					}
+				}
 
-						// firstMove を計算
-						if (turn == 0) {
-							if (hasOpponentWall) {
-								nextAnswer.firstMove = AgentMove::GetDestroy(agent, direction);
-							}
-							else {
-								nextAnswer.firstMove = AgentMove::GetMove(agent, direction);
+				for (int32 consumeTurns = 2; consumeTurns >= 1; consumeTurns--) {
+					int32 from = turn - consumeTurns;
+					if (from < 0) continue;
+					const int64* fromProfit = profitPlanes[a].data() + (size_t)from * cellCount;
+					const uint8* fromFirstMove = firstMovePlanes[a].data() + (size_t)from * cellCount;
+					// 候補の生成順は (消費ターン数 2 → 1 , 移動元の登録番号)
+					int32 keyBase = (consumeTurns == 2) ? 0 : cellCount;
+
+					for (int32 dir = 0; dir < 8; dir++) {
+						if (consumeTurns == 2 && dir % 2 != 0) continue; // 敵の壁には 4 方向からだけ
+						int32 offset = offsets[dir];
+						uint8 initialMove = (uint8)(consumeTurns == 2 ? ShortenMove::Destroy(MoveDirection(dir)) : ShortenMove::Move(MoveDirection(dir)));
+
+						// 行ごとに、移動先 p と移動元 q = p - offset をまとめて緩和する
+						for (int32 r = rowMin; r <= rowMax; r++) {
+							int32 rowBegin = (r + 1) * paddedWidth + (colMin + 1);
+							int32 rowEnd = (r + 1) * paddedWidth + (colMax + 1);
+							for (int32 p = rowBegin; p <= rowEnd; p++) {
+								int32 q = p - offset;
+								bool valid = enterCost[p] == consumeTurns && dist[q] <= from;
+								int64 candidate = fromProfit[q] + visiting[p];
+								int32 key = keyBase + agentRank[q];
+								bool better = valid && (profit[p] < candidate || (profit[p] == candidate && key < bestKey[p]));
+								profit[p] = better ? candidate : profit[p];
+								bestKey[p] = better ? key : bestKey[p];
+								firstMove[p] = better ? (from == 0 ? initialMove : fromFirstMove[q]) : firstMove[p];
 							}
 						}
-						else {
-							nextAnswer.firstMove = buffer[turn][nowPostitionIndex].firstMove;
-						}
-
-						// 利得計算
-						nextAnswer.profit = prevAns.profit + visitingProfit[turn + consumeTurns][newPosition.asPoint()];
-
-						// 登録
-						nextBuffer[consumeTurns - 1].push_back(std::make_pair(newPosition, nextAnswer));
-
 					}
 				}
-
 			}
-
 		}
 
-		GridWalking::Answer resultBuffer;
-		resultBuffer.maxTurnCount = maxTurnCount;
-		resultBuffer.shortPath = std::move(buffer);
-		resultBuffer.posistions = std::move(positions);
-		resultBuffer.positionToListIndex = std::move(massRegistoration);
-		return resultBuffer;
+		// 以前と同じ形に並べ直す
+		Array<Answer> results(agentCount);
+		for (int32 a = 0; a < agentCount; a++) {
+			auto& result = results[a];
+			const auto& order = registrationOrder[a];
+			result.maxTurnCount = maxTurnCount;
+			result.positionToListIndex = Grid<int32>(boardSize, -1);
+			result.posistions = order.map([&](int32 idx) { return BoardPos(idx / paddedWidth - 1, idx % paddedWidth - 1); });
+			for (int32 i = 0; i < (int32)order.size(); i++) {
+				result.positionToListIndex[result.posistions[i].asPoint()] = i;
+			}
+			result.shortPath.resize(planeCount);
+			for (int32 turn = 0; turn <= maxTurnCount; turn++) {
+				const int64* profit = profitPlanes[a].data() + (size_t)turn * cellCount;
+				const uint8* firstMove = firstMovePlanes[a].data() + (size_t)turn * cellCount;
+				auto& answers = result.shortPath[turn];
+				answers.reserve(registeredCount[a][turn]);
+				for (int32 i = 0; i < registeredCount[a][turn]; i++) {
+					int32 idx = order[i];
+					answers.push_back(ShortPathAnswer{ .firstMove = ShortenMove::Decode(firstMove[idx], agents[a]), .profit = profit[idx] });
+				}
+			}
+		}
+		return results;
 	}
 
 }
-
@@ -32,6 +32,10 @@ namespace Procon34 {
 
 		Answer solve(Agent agent, int32 maxTurnCount);
 
+		// agents のそれぞれについて solve と同じ結果を返す。
+		// 全員ぶんをターンごとにまとめて、盤面と同じ形の配列の上で計算する。
+		Array<Answer> solveAll(const Array<Agent>& agents, int32 maxTurnCount);
+
 	};
 
 }
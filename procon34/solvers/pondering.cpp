@@ -0,0 +1,124 @@
+﻿#include "pondering.hpp"
+#include "shorten_move.hpp"
+#include "solver_executor.hpp"
+
+namespace Procon34 {
+
+
+	namespace {
+
+		// ランダムに予想するとき、職人ごとに上位のいくつの行動から選ぶか
+		constexpr size_t SampleCandidateCount = 3;
+
+	}
+
+
+	Pondering::Pondering(SolverFactory solverFactory, int32 sampleCount, uint64 seed)
+		: m_solverFactory(std::move(solverFactory))
+		, m_sampleCount(sampleCount)
+		, m_rng(seed)
+	{
+		if (!m_solverFactory) throw Error(U"error at Pondering : solverFactory is empty");
+	}
+
+	Pondering::~Pondering() {
+		clear();
+	}
+
+	void Pondering::start(BoxPtr<const GameState> state, Optional<uint32> concurrency) {
+		clear();
+
+		// 相手の手番の後に自分の手番がなければ読まない
+		if (state->isOver() || state->getTurnIndex() + 1 >= state->getAllTurnNumber()) return;
+
+		auto color = state->whosTurn();
+		auto agents = state->getAgents(color);
+		auto ranked = RankAgentMovesByScore(*state);
+
+		Array<Array<ShortenMove::Type>> predictions;
+		predictions.push_back(Array<ShortenMove::Type>(agents.size(), ShortenMove::Stay()));
+		predictions.push_back(ranked.map([](const Array<ShortenMove::Type>& moves) { return moves.front(); }));
+		for (int32 k = 0; k < m_sampleCount; k++) {
+			Array<ShortenMove::Type> moves(agents.size());
+			for (size_t i = 0; i < agents.size(); i++) {
+				size_t candidateCount = Min(SampleCandidateCount, ranked[i].size());
+				moves[i] = ranked[i][UniformIntDistribution<size_t>(0, candidateCount - 1)(m_rng)];
+			}
+			predictions.push_back(moves);
+		}
+
+		// 同じ局面になる予想は 1 つにまとめる
+		for (auto& moves : predictions) {
+			auto next = state->clone();
+			TurnInstruction inst(next, color);
+			for (size_t i = 0; i < agents.size(); i++) inst.insert(ShortenMove::Decode(moves[i], agents[i]));
+			next->makeMove(color, inst);
+
+			uint64 hash = next->hash();
+			if (m_entryOfHash.contains(hash)) continue;
+			m_entryOfHash.emplace(hash, m_entries.size());
+
+			auto entry = std::make_unique<Entry>();
+			entry->predicted = next;
+			entry->solver = m_solverFactory();
+			entry->cancellationToken = std::make_shared<CancellationToken>();
+			m_entries.push_back(std::move(entry));
+		}
+
+		Optional<uint32> concurrencyPerEntry;
+		if (concurrency) concurrencyPerEntry = Max<uint32>(1, *concurrency / (uint32)Max<size_t>(1, m_entries.size()));
+
+		for (auto& entry : m_entries) {
+			Entry* e = entry.get();
+			e->thread = std::thread([e, concurrencyPerEntry]() {
+				SolverExecutor::ScopedConcurrency scopedConcurrency(concurrencyPerEntry);
+				try {
+					e->instruction = e->solver->solve(e->predicted, e->cancellationToken);
+				}
+				catch (const Error& err) {
+					Console << U"Pondering : {}"_fmt(err.what());
+				}
+			});
+		}
+	}
+
+	Optional<Pondering::Answer> Pondering::take(BoxPtr<const GameState> state) {
+		if (m_entryOfHash.empty()) return none;
+
+		// 答えを返すのは 1 回だけ
+		auto entryOfHash = std::move(m_entryOfHash);
+		m_entryOfHash.clear();
+
+		auto it = entryOfHash.find(state->hash());
+		if (it == entryOfHash.end()) {
+			cancel();
+			m_missCount++;
+			Console << U"Pondering : miss at turn #{} ({} / {} hit)"_fmt(state->getTurnIndex(), m_hitCount, m_hitCount + m_missCount);
+			return none;
+		}
+
+		auto& entry = *m_entries[it->second];
+		for (auto& other : m_entries) if (other.get() != &entry) other->cancellationToken->cancel();
+		if (entry.thread.joinable()) entry.thread.join();
+		if (!entry.instruction.has_value()) {
+			m_missCount++;
+			return none;
+		}
+
+		m_hitCount++;
+		Console << U"Pondering : hit at turn #{} ({} / {} hit)"_fmt(state->getTurnIndex(), m_hitCount, m_hitCount + m_missCount);
+		return Answer{ .instruction = *entry.instruction, .solver = entry.solver };
+	}
+
+	void Pondering::cancel() {
+		for (auto& entry : m_entries) entry->cancellationToken->cancel();
+	}
+
+	void Pondering::clear() {
+		cancel();
+		for (auto& entry : m_entries) if (entry->thread.joinable()) entry->thread.join();
+		m_entries.clear();
+		m_entryOfHash.clear();
+	}
+
+}
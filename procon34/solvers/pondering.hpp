@@ -0,0 +1,73 @@
+﻿#pragma once
+#include "../stdafx.h"
+#include "solver_list.hpp"
+#include "cancellation.hpp"
+#include <functional>
+#include <thread>
+
+namespace Procon34 {
+
+	// 相手の手番の間に、相手の行動をいくつか予想して、それぞれの後の自分の手を先に解いておく（先読み）。
+	//
+	// 予想は「全員滞在」「職人ごとに 1 手で点差が最もよくなる行動（貪欲）」と、職人ごとに上位の行動から選んだものをいくつか。
+	// 予想した局面ごとにソルバーを作り、別々のスレッドから同時に解く（探索の中身は共有のプールで動く）。
+	// 結果は予想した局面の GameState::hash で引く。
+	class Pondering {
+	public:
+
+		using SolverFactory = std::function<std::shared_ptr<SolverInterface>()>;
+
+		// solverFactory : 予想した局面ごとに使うソルバーを作る。同時に解くので、呼ぶたびに別のインスタンスを返すこと
+		// sampleCount : 滞在と貪欲のほかに試す予想の数
+		Pondering(SolverFactory solverFactory, int32 sampleCount = 2, uint64 seed = 0);
+
+		Pondering(Pondering&&) = delete;
+		Pondering(const Pondering&) = delete;
+
+		// 解いている途中のものを打ち切って待つ
+		~Pondering();
+
+		// 相手の手番の局面 state から先読みを始める。前の先読みは捨てる。
+		// concurrency : すべての予想で合わせて同時に使うスレッドの数（予想ごとに等分する）。 none なら制限しない
+		void start(BoxPtr<const GameState> state, Optional<uint32> concurrency = none);
+
+		struct Answer {
+			TurnInstruction instruction;
+			std::shared_ptr<SolverInterface> solver; // この局面を解いたソルバー（前の手番の計画を持っている）
+		};
+
+		// 自分の手番の実際の局面 state を予想していれば、その局面の答えを返す（解き終わっていなければ待つ）。
+		// 予想していなければ none 。どちらの場合も、ほかの予想の探索は打ち切る
+		Optional<Answer> take(BoxPtr<const GameState> state);
+
+		// すべての予想の探索を打ち切る（終わるのは待たない）
+		void cancel();
+
+		int32 hitCount() const { return m_hitCount; }
+		int32 missCount() const { return m_missCount; }
+
+	private:
+
+		struct Entry {
+			BoxPtr<const GameState> predicted; // 相手の行動を予想した後の、自分の手番の局面
+			std::shared_ptr<SolverInterface> solver;
+			std::shared_ptr<CancellationToken> cancellationToken;
+			Optional<TurnInstruction> instruction; // スレッドが書き、 join した後に読む
+			std::thread thread;
+		};
+
+		SolverFactory m_solverFactory;
+		int32 m_sampleCount;
+		SmallRNG m_rng;
+
+		Array<std::unique_ptr<Entry>> m_entries;
+		HashTable<uint64, size_t> m_entryOfHash;
+
+		int32 m_hitCount = 0;
+		int32 m_missCount = 0;
+
+		// 打ち切ったうえで、すべてのスレッドの終わりを待って捨てる
+		void clear();
+	};
+
+}
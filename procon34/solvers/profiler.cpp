@@ -0,0 +1,163 @@
+﻿#include "profiler.hpp"
+
+#ifdef PROCON34_ENABLE_PROFILER
+
+#include <atomic>
+#include <mutex>
+
+namespace Procon34 {
+
+	namespace Profiler {
+
+		namespace {
+
+			struct Span {
+				const char* name;
+				int64 beginInMicroseconds;
+				int64 durationInMicroseconds;
+			};
+
+			// 1 つのスレッドだけが書き込み、 1 つのスレッドだけが読み出すリングバッファ。
+			// 書き込み側も読み出し側もロックを取らない。
+			class SpanRingBuffer {
+			public:
+
+				static constexpr size_t Capacity = size_t(1) << 16;
+
+				SpanRingBuffer(uint32 threadIndex)
+					: m_threadIndex(threadIndex), m_spans(Capacity), m_head(0), m_tail(0), m_dropped(0), m_alive(true) {}
+
+				// 持ち主のスレッドから呼ぶ
+				void push(const Span& span) {
+					uint64 head = m_head.load(std::memory_order_relaxed);
+					if (head - m_tail.load(std::memory_order_acquire) >= Capacity) {
+						m_dropped.fetch_add(1, std::memory_order_relaxed);
+						return;
+					}
+					m_spans[head % Capacity] = span;
+					m_head.store(head + 1, std::memory_order_release);
+				}
+
+				// 読み出し側のスレッドから呼ぶ。溜まっている区間をすべて取り出す
+				template<class F>
+				void consume(F&& f) {
+					uint64 tail = m_tail.load(std::memory_order_relaxed);
+					uint64 head = m_head.load(std::memory_order_acquire);
+					for (uint64 i = tail; i < head; i++) f(m_spans[i % Capacity]);
+					m_tail.store(head, std::memory_order_release);
+				}
+
+				bool empty() const {
+					return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+				}
+
+				uint32 threadIndex() const { return m_threadIndex; }
+
+				uint64 takeDroppedCount() { return m_dropped.exchange(0, std::memory_order_relaxed); }
+
+				void markDead() { m_alive.store(false, std::memory_order_release); }
+
+				bool isAlive() const { return m_alive.load(std::memory_order_acquire); }
+
+			private:
+				const uint32 m_threadIndex;
+				Array<Span> m_spans;
+				std::atomic<uint64> m_head; // 書き込んだ個数
+				std::atomic<uint64> m_tail; // 読み出した個数
+				std::atomic<uint64> m_dropped;
+				std::atomic<bool> m_alive;
+			};
+
+			// スレッドごとのバッファの一覧。登録と書き出しのときだけロックを取る
+			struct Registry {
+				std::mutex mutex;
+				Array<std::shared_ptr<SpanRingBuffer>> buffers;
+				uint32 nextThreadIndex = 0;
+				const Clock::time_point epoch = Clock::now();
+			};
+
+			Registry& GetRegistry() {
+				static Registry registry;
+				return registry;
+			}
+
+			// スレッドの終了時にバッファを回収できるよう印をつける
+			struct ThreadLocalBuffer {
+				std::shared_ptr<SpanRingBuffer> buffer;
+
+				ThreadLocalBuffer() {
+					auto& registry = GetRegistry();
+					std::lock_guard lock(registry.mutex);
+					buffer = std::make_shared<SpanRingBuffer>(registry.nextThreadIndex++);
+					registry.buffers.push_back(buffer);
+				}
+
+				~ThreadLocalBuffer() { buffer->markDead(); }
+			};
+
+			SpanRingBuffer& GetThreadLocalBuffer() {
+				thread_local ThreadLocalBuffer threadLocalBuffer;
+				return *threadLocalBuffer.buffer;
+			}
+
+			int64 ToMicroseconds(Clock::duration d) {
+				return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+			}
+
+		}
+
+		void Record(const char* name, Clock::time_point begin, Clock::time_point end) {
+			auto epoch = GetRegistry().epoch;
+			GetThreadLocalBuffer().push(Span{
+				.name = name,
+				.beginInMicroseconds = ToMicroseconds(begin - epoch),
+				.durationInMicroseconds = ToMicroseconds(end - begin)
+			});
+		}
+
+		void DumpChromeTrace(FilePathView path) {
+			auto& registry = GetRegistry();
+			std::lock_guard lock(registry.mutex);
+
+			TextWriter writer(path);
+			if (!writer) throw Error(U"Error at Profiler::DumpChromeTrace : failed to open {}"_fmt(path));
+
+			writer.writeln(U"{\"traceEvents\":[");
+			bool first = true;
+			for (auto& buffer : registry.buffers) {
+				buffer->consume([&](const Span& span) {
+					if (!first) writer.writeln(U",");
+					first = false;
+					writer.write(U"{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":0,\"tid\":{},\"ts\":{},\"dur\":{}}}"_fmt(
+						Unicode::Widen(span.name), buffer->threadIndex(), span.beginInMicroseconds, span.durationInMicroseconds));
+				});
+				// 捨てた区間があれば、その数を記録しておく
+				uint64 dropped = buffer->takeDroppedCount();
+				if (dropped != 0) {
+					if (!first) writer.writeln(U",");
+					first = false;
+					writer.write(U"{{\"name\":\"dropped {} spans\",\"ph\":\"i\",\"s\":\"t\",\"pid\":0,\"tid\":{},\"ts\":{}}}"_fmt(
+						dropped, buffer->threadIndex(), ToMicroseconds(Clock::now() - registry.epoch)));
+				}
+			}
+			writer.writeln(U"\n]}");
+
+			// 終了したスレッドのバッファは、読み終えたら捨てる
+			registry.buffers.remove_if([](const std::shared_ptr<SpanRingBuffer>& buffer) { return !buffer->isAlive() && buffer->empty(); });
+		}
+
+		void Clear() {
+			auto& registry = GetRegistry();
+			std::lock_guard lock(registry.mutex);
+			for (auto& buffer : registry.buffers) {
+				buffer->consume([](const Span&) {});
+				buffer->takeDroppedCount();
+			}
+			registry.buffers.remove_if([](const std::shared_ptr<SpanRingBuffer>& buffer) { return !buffer->isAlive(); });
+		}
+
+	}
+
+} // namespace Procon34
+
+#endif
@@ -0,0 +1,73 @@
+﻿#pragma once
+#include "../stdafx.h"
+#include <chrono>
+
+// 探索の各段階にかかった時間を記録する。
+// PROCON34_ENABLE_PROFILER を定義したときだけ有効になり、
+// 定義しなければ PROCON34_PROFILE_SCOPE は何も生成しない。
+//
+// 使い方 :
+//     { PROCON34_PROFILE_SCOPE("GridWalking::solve"); ... }
+//     Profiler::DumpChromeTrace(U"profile/turn_001.json");
+// 出力は chrome://tracing や https://ui.perfetto.dev で開ける。
+
+namespace Procon34 {
+
+	namespace Profiler {
+
+		using Clock = std::chrono::steady_clock;
+
+#ifdef PROCON34_ENABLE_PROFILER
+
+		// 現在のスレッドのリングバッファに区間を追加する。
+		// name は文字列リテラルなど、寿命が十分に長いものを渡すこと。
+		// バッファがいっぱいなら捨てる。
+		void Record(const char* name, Clock::time_point begin, Clock::time_point end);
+
+		// スコープを抜けるときに区間を記録する
+		class ScopedTimer {
+		public:
+
+			explicit ScopedTimer(const char* name) : m_name(name), m_begin(Clock::now()) {}
+
+			~ScopedTimer() { Record(m_name, m_begin, Clock::now()); }
+
+			ScopedTimer(const ScopedTimer&) = delete;
+			ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+		private:
+			const char* m_name;
+			Clock::time_point m_begin;
+		};
+
+		// すべてのスレッドの記録を取り出し、 Chrome trace 形式で path に書き出す。
+		// 取り出した記録は消える。
+		void DumpChromeTrace(FilePathView path);
+
+		// すべてのスレッドの記録を捨てる
+		void Clear();
+
+#else
+
+		inline void DumpChromeTrace(FilePathView) {}
+
+		inline void Clear() {}
+
+#endif
+
+	}
+
+} // namespace Procon34
+
+
+#ifdef PROCON34_ENABLE_PROFILER
+
+#define PROCON34_PROFILE_CONCAT_INNER(a, b) a##b
+#define PROCON34_PROFILE_CONCAT(a, b) PROCON34_PROFILE_CONCAT_INNER(a, b)
+#define PROCON34_PROFILE_SCOPE(name) ::Procon34::Profiler::ScopedTimer PROCON34_PROFILE_CONCAT(procon34ProfileScope, __LINE__)(name)
+
+#else
+
+#define PROCON34_PROFILE_SCOPE(name) ((void)0)
+
+#endif
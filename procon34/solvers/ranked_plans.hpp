@@ -0,0 +1,92 @@
+﻿#pragma once
+#include "../stdafx.h"
+
+namespace Procon34 {
+
+	template<class Key>
+	struct RankedPlan {
+		int64 profit;
+		Key key;
+	};
+
+	// 添え字ごとに、 key が異なる計画を利得の大きい順に最大 K 個まで持つ表
+	//
+	// どの添え字にも最初から { floorProfit, floorKey } が 1 つ入っていて、 floorProfit 以下の計画は入らない。
+	// 利得が同じなら先に入れたものを前に置くので、 K = 1 なら「真に大きいときだけ置き換える」と同じ結果になる。
+	// 領域は cellCount * K 個ぶんを最初に確保し、それ以上は増えない。
+	template<class Key>
+	class RankedPlanTable {
+	public:
+
+		static constexpr int32 MaxPlanCount = 16;
+
+		RankedPlanTable() = default;
+
+		RankedPlanTable(size_t cellCount, int32 planCount, int64 floorProfit, Key floorKey)
+			: m_planCount(planCount)
+			, m_floor({ floorProfit, floorKey })
+		{
+			if (planCount < 1 || MaxPlanCount < planCount) throw Error(U"error at RankedPlanTable : planCount is out of range");
+			m_counts.assign(cellCount, 1);
+			m_thresholds.assign(cellCount, floorProfit);
+			m_plans.assign(cellCount * planCount, m_floor);
+		}
+
+		size_t size() const { return m_counts.size(); }
+
+		int32 planCount() const { return m_planCount; }
+
+		const RankedPlan<Key>* begin(size_t cell) const { return m_plans.data() + cell * m_planCount; }
+		const RankedPlan<Key>* end(size_t cell) const { return begin(cell) + m_counts[cell]; }
+
+		// 最もよい計画
+		const RankedPlan<Key>& best(size_t cell) const { return *begin(cell); }
+
+		// これ以下の利得の計画は push しても入らない
+		int64 threshold(size_t cell) const {
+			return m_thresholds[cell];
+		}
+
+		// 入ったら true
+		bool push(size_t cell, int64 profit, Key key) {
+			if (profit <= threshold(cell)) return false;
+			auto plans = m_plans.data() + cell * m_planCount;
+			int32 count = m_counts[cell];
+
+			// 同じ key があれば、利得の大きいほうだけを残す
+			for (int32 i = 0; i < count; i++) if (plans[i].key == key) {
+				if (plans[i].profit >= profit) return false;
+				for (int32 k = i; k + 1 < count; k++) plans[k] = plans[k + 1];
+				count--;
+				break;
+			}
+
+			// 溢れたら最後のものを捨てる
+			int32 pos = Min(count, m_planCount - 1);
+			count = Min(count + 1, m_planCount);
+			while (pos > 0 && plans[pos - 1].profit < profit) {
+				plans[pos] = plans[pos - 1];
+				pos--;
+			}
+			plans[pos] = { profit, key };
+			m_counts[cell] = (uint16)count;
+			if (count == m_planCount) m_thresholds[cell] = plans[count - 1].profit;
+			return true;
+		}
+
+		// 最初の状態に戻す
+		void reset(size_t cell) {
+			m_counts[cell] = 1;
+			m_thresholds[cell] = m_floor.profit;
+			m_plans[cell * m_planCount] = m_floor;
+		}
+
+	private:
+		int32 m_planCount = 1;
+		RankedPlan<Key> m_floor = {};
+		Array<uint16> m_counts; // uint8 だと何にでも別名になりうるので、呼び出し側のループが最適化されにくい
+		Array<int64> m_thresholds; // 毎回 m_plans を見なくて済むように持っておく
+		Array<RankedPlan<Key>> m_plans;
+	};
+
+}
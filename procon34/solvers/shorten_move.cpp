@@ -38,6 +38,37 @@ namespace Procon34 {
 		// return AgentMove::GetStay(agent);
 	}
 
+	Array<ShortenMove::Type> ShortenMove::EnumerateValid(const GameBoard& board, Agent agent) {
+		std::array<Type, MaxValidCount> buffer;
+		int32 count = EnumerateValid(board, agent, buffer);
+		return Array<Type>(buffer.begin(), buffer.begin() + count);
+	}
+
+	int32 ShortenMove::EnumerateValid(const GameBoard& board, Agent agent, std::array<Type, MaxValidCount>& out) {
+		int32 count = 0;
+		out[count++] = Stay();
+		auto myColor = agent.marker.color;
+		for (int32 d = 0; d < 8; d++) {
+			auto dir = MoveDirection(d);
+			auto pos = agent.pos.movedAlong(dir);
+			if (!board.isOnBoard(pos)) continue;
+			const Mass& mass = board[pos];
+			if (mass.biome != MassBiome::Pond && !mass.hasAgent() && (!mass.hasWall() || mass.hasWallOf(myColor))) {
+				out[count++] = Move(dir);
+			}
+			if (!dir.is4Direction()) continue;
+			if (!mass.hasWall()) {
+				if (mass.biome != MassBiome::Castle && !(mass.hasAgent() && mass.agent->color != myColor)) {
+					out[count++] = Construct(dir);
+				}
+			}
+			else if (!mass.hasWallOf(myColor)) {
+				out[count++] = Destroy(dir);
+			}
+		}
+		return count;
+	}
+
 
 
 
@@ -51,5 +82,99 @@ namespace Procon34 {
 	}
 
 
-}
 
+	ShortenMoveConflicts::ShortenMoveConflicts(const Array<Agent>& agents)
+		: m_agentCount((int32)agents.size())
+	{
+		// 行動の種類と対象のマス
+		enum Kind { KindStay, KindMove, KindConstruct, KindDestroy };
+		auto kindOf = [](ShortenMove::Type move) -> int32 { return (int32)(move >> 3); };
+		auto targetOf = [](Agent agent, ShortenMove::Type move) -> BoardPos { return agent.pos.movedAlong(MoveDirection(move & 7)); };
+		auto isSamePos = [](BoardPos a, BoardPos b) -> bool { return a.r == b.r && a.c == b.c; };
+
+		m_table.assign((size_t)m_agentCount * MoveCount * m_agentCount * MoveCount, 0);
+		for (int32 a = 0; a < m_agentCount; a++) for (int32 b = 0; b < m_agentCount; b++) if (a != b) {
+			for (ShortenMove::Type moveA = 0; moveA < (ShortenMove::Type)MoveCount; moveA++) {
+				int32 kindA = kindOf(moveA);
+				if (kindA == KindStay) continue;
+				auto targetA = targetOf(agents[a], moveA);
+				for (ShortenMove::Type moveB = 0; moveB < (ShortenMove::Type)MoveCount; moveB++) {
+					int32 kindB = kindOf(moveB);
+					bool conflict = false;
+					if (kindA == KindMove && isSamePos(targetA, agents[b].pos)) conflict = true;
+					if (kindB != KindStay) {
+						auto targetB = targetOf(agents[b], moveB);
+						if (kindB == KindMove && isSamePos(targetB, agents[a].pos)) conflict = true;
+						if (kindA == kindB && isSamePos(targetA, targetB)) conflict = true;
+					}
+					if (conflict) {
+						m_table[((a * MoveCount + moveA) * m_agentCount + b) * MoveCount + moveB] = 1;
+						m_table[((b * MoveCount + moveB) * m_agentCount + a) * MoveCount + moveA] = 1;
+					}
+				}
+			}
+		}
+	}
+
+	bool ShortenMoveConflicts::conflicts(int32 agent, ShortenMove::Type move, ShortenMoveSet moves, uint32 agentMask) const {
+		if (move == ShortenMove::Stay()) return false;
+		for (int32 b = 0; b < m_agentCount; b++) if ((agentMask >> b) & 1) {
+			if (b != agent && conflicts(agent, move, b, moves.getAt(b))) return true;
+		}
+		return false;
+	}
+
+	bool ShortenMoveConflicts::conflicts(ShortenMoveSet lhs, uint32 lhsMask, ShortenMoveSet rhs, uint32 rhsMask) const {
+		for (int32 a = 0; a < m_agentCount; a++) if ((lhsMask >> a) & 1) {
+			if (conflicts(a, lhs.getAt(a), rhs, rhsMask)) return true;
+		}
+		return false;
+	}
+
+	Array<Array<ShortenMove::Type>> RankAgentMovesByScore(const GameState& state) {
+		auto color = state.whosTurn();
+		auto opponentColor = GameState::OpponentOf(color);
+		auto agents = state.getAgents(color);
+		auto board = state.getBoard();
+
+		Array<Array<ShortenMove::Type>> res(agents.size());
+		for (size_t i = 0; i < agents.size(); i++) {
+			Array<std::pair<int64, ShortenMove::Type>> scored;
+			for (auto move : ShortenMove::EnumerateValid(*board, agents[i])) {
+				auto next = state.clone();
+				TurnInstruction inst(next, color);
+				inst.insert(ShortenMove::Decode(move, agents[i]));
+				next->makeMove(color, inst);
+				scored.emplace_back(next->getScore(color) - next->getScore(opponentColor), move);
+			}
+			std::stable_sort(scored.begin(), scored.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+			res[i] = scored.map([](const auto& x) { return x.second; });
+		}
+		return res;
+	}
+
+	TurnInstruction GreedyInstruction(BoxPtr<const GameState> state) {
+		auto color = state->whosTurn();
+		auto agents = state->getAgents(color);
+		auto ranked = RankAgentMovesByScore(*state);
+		ShortenMoveConflicts conflicts(agents);
+
+		ShortenMoveSet moves;
+		uint32 decided = 0;
+		TurnInstruction res(state, color);
+		for (int32 i = 0; i < (int32)agents.size(); i++) {
+			ShortenMove::Type chosen = ShortenMove::Stay();
+			for (auto move : ranked[i]) {
+				if (!conflicts.conflicts(i, move, moves, decided)) {
+					chosen = move;
+					break;
+				}
+			}
+			moves.setAt(i, chosen);
+			decided |= 1u << i;
+			res.insert(ShortenMove::Decode(chosen, agents[i]));
+		}
+		return res;
+	}
+
+}
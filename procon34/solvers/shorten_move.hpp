@@ -1,6 +1,7 @@
 ﻿#pragma once
 #include "../stdafx.h"
 #include "../game_state.hpp"
+#include <array>
 
 namespace Procon34 {
 
@@ -18,16 +19,69 @@ namespace Procon34 {
 		static Type Encode(AgentMove);
 		static AgentMove Decode(Type val, Agent agent);
 
+		// 職人 agent の行動の候補を列挙する（明らかに無効な行動は除く）。最初は Stay
+		static Array<Type> EnumerateValid(const GameBoard& board, Agent agent);
+
+		// 候補の個数の上限（滞在 1 + 移動 8 + 建築か解体 4 ）
+		static constexpr int32 MaxValidCount = 13;
+
+		// 上と同じ候補を同じ順に out に書き、個数を返す。確保しないので、プレイアウトのように何度も呼ぶところで使う
+		static int32 EnumerateValid(const GameBoard& board, Agent agent, std::array<Type, MaxValidCount>& out);
+
 	};
 
 	class ShortenMoveSet {
 		uint32 m_valSet;
 	public:
 
+		// すべて Stay で初期化
+		ShortenMoveSet() : m_valSet(0) {}
+
 		ShortenMove::Type getAt(int32 index) const;
 		void setAt(int32 index, ShortenMove::Type val);
 
+		// 全員分の行動を 1 つの整数として取得（比較・重複除去用）
+		uint32 asInteger() const { return m_valSet; }
+
+		bool operator==(const ShortenMoveSet& other) const { return m_valSet == other.m_valSet; }
+
 	};
 
+	// 味方どうしの最初の行動が打ち消し合うかの表（ GameState::makeMove の規則に従う）
+	//   - 同じマスへの移動（両方とも取り消される）
+	//   - 味方が今いるマスへの移動（取り消される）
+	//   - 同じマスへの建築、同じマスの解体（後のほうが無駄になる）
+	class ShortenMoveConflicts {
+	public:
+
+		ShortenMoveConflicts() = default;
+
+		// agents : 添え字は ShortenMoveSet の添え字と対応
+		ShortenMoveConflicts(const Array<Agent>& agents);
+
+		bool conflicts(int32 agentA, ShortenMove::Type moveA, int32 agentB, ShortenMove::Type moveB) const {
+			return m_table[((agentA * MoveCount + moveA) * m_agentCount + agentB) * MoveCount + moveB] != 0;
+		}
+
+		// agent の行動 move が、 moves のうち agentMask に含まれる職人の行動と打ち消し合うか
+		bool conflicts(int32 agent, ShortenMove::Type move, ShortenMoveSet moves, uint32 agentMask) const;
+
+		// lhs の lhsMask の職人と rhs の rhsMask の職人の間に打ち消し合う組があるか
+		bool conflicts(ShortenMoveSet lhs, uint32 lhsMask, ShortenMoveSet rhs, uint32 rhsMask) const;
+
+	private:
+		static constexpr int32 MoveCount = 1 << ShortenMove::ShiftSize;
+		int32 m_agentCount = 0;
+		Array<uint8> m_table; // [agentA][moveA][agentB][moveB]
+	};
+
+	// 手番の職人ごとに、ほかの職人は滞在するとして 1 手動いた後の点差がよい順に行動を並べる。
+	// 点差が同じなら列挙した順（滞在が先）
+	Array<Array<ShortenMove::Type>> RankAgentMovesByScore(const GameState& state);
+
+	// 職人ごとに、前の職人の行動と打ち消し合わないもののうち RankAgentMovesByScore で最もよい行動を選ぶ。
+	// 探索をしないので、ソルバーの答えが出る前にすぐ送る指示に使う
+	TurnInstruction GreedyInstruction(BoxPtr<const GameState> state);
+
 }
 
@@ -0,0 +1,222 @@
+﻿#include "../stdafx.h"
+#include "solver_beam.hpp"
+#include "shorten_move.hpp"
+#include "thread_pool.hpp"
+#include "solver_executor.hpp"
+#include "cancellation.hpp"
+#include "profiler.hpp"
+
+namespace Procon34 {
+
+
+	namespace Solvers {
+
+
+		namespace {
+
+			constexpr int32 MinBeamWidth = 4;
+			constexpr int32 InitialBeamWidth = 32;
+
+			struct BeamNode {
+				BoxPtr<const GameState> turnStart; // このターンの開始時の状態
+				BoxPtr<const GameState> evaluated; // turnStart で partial を実行し、相手が滞在した後の状態
+				ShortenMoveSet partial; // このターンに決めた行動（未決定の職人は滞在）
+				ShortenMoveSet firstMoves; // 最初のターンの行動
+				int32 turn; // 何ターン目の行動を決めているか
+				int32 agentIndex; // 次に行動を決める職人
+				int64 evaluation;
+				uint64 hash;
+			};
+
+			// 実際の点差に、これから陣地になりやすい形への評価を足す。
+			// 自分の壁どうしが 4 方向で隣接していると、その後に囲いを作りやすい。
+			int64 Evaluate(const GameState& state, PlayerColor myColor) {
+				auto board = state.getBoard();
+				int64 res = state.getScore(myColor) - state.getScore(GameState::OpponentOf(myColor));
+
+				int64 connectedWallBonus = state.getInitialState()->teritorryCoefficient / 2;
+				int32 h = board->getHeight();
+				int32 w = board->getWidth();
+				for (int32 r = 0; r < h; r++) {
+					for (int32 c = 0; c < w; c++) {
+						if (!(*board)[BoardPos(r, c)].hasWallOf(myColor)) continue;
+						if (r + 1 < h && (*board)[BoardPos(r + 1, c)].hasWallOf(myColor)) res += connectedWallBonus;
+						if (c + 1 < w && (*board)[BoardPos(r, c + 1)].hasWallOf(myColor)) res += connectedWallBonus;
+					}
+				}
+				return res;
+			}
+
+			// node の次の職人の行動をすべて試す
+			void ExpandNode(const BeamNode& node, PlayerColor myColor, int32 agentCount, Array<BeamNode>& out) {
+				auto agents = node.turnStart->getAgents(myColor);
+				auto agent = agents[node.agentIndex];
+				bool lastAgent = node.agentIndex + 1 == agentCount;
+
+				for (auto move : ShortenMove::EnumerateValid(*node.turnStart->getBoard(), agent)) {
+					auto partial = node.partial;
+					partial.setAt(node.agentIndex, move);
+
+					auto next = node.turnStart->clone();
+					TurnInstruction inst(next, myColor);
+					for (int32 i = 0; i <= node.agentIndex; i++) {
+						inst.insert(ShortenMove::Decode(partial.getAt(i), agents[i]));
+					}
+					next->makeMove(myColor, inst);
+					if (!next->isOver()) next->makeMove(next->whosTurn(), TurnInstruction(next, next->whosTurn())); // 相手は滞在
+
+					BeamNode child;
+					child.evaluated = next;
+					child.evaluation = Evaluate(*next, myColor);
+					if (lastAgent) {
+						child.turnStart = next;
+						child.partial = ShortenMoveSet();
+						child.firstMoves = (node.turn == 0) ? partial : node.firstMoves;
+						child.turn = node.turn + 1;
+						child.agentIndex = 0;
+					}
+					else {
+						child.turnStart = node.turnStart;
+						child.partial = partial;
+						child.firstMoves = node.firstMoves;
+						child.turn = node.turn;
+						child.agentIndex = node.agentIndex + 1;
+					}
+					child.hash = next->hash() ^ ((uint64)child.agentIndex * 0x9E3779B97F4A7C15ull);
+					out.push_back(std::move(child));
+				}
+			}
+
+		}
+
+
+		BeamSearch::BeamSearch(int32 safetyMarginInMiliseconds, int32 searchTurnCount, int32 maxBeamWidth, Optional<uint32> threadBudget)
+			: m_safetyMarginInMiliseconds(safetyMarginInMiliseconds)
+			, m_searchTurnCount(searchTurnCount)
+			, m_maxBeamWidth(maxBeamWidth)
+			, m_threadBudget(threadBudget)
+		{
+		}
+
+		// 盤面の状態から指示を作る
+		TurnInstruction BeamSearch::operator()(BoxPtr<const GameState> state) {
+			return solve(state, nullptr);
+		}
+
+		TurnInstruction BeamSearch::solve(BoxPtr<const GameState> state, std::shared_ptr<const CancellationToken> parentToken) {
+			return solveAnytime(state, parentToken, nullptr);
+		}
+
+		TurnInstruction BeamSearch::solveAnytime(BoxPtr<const GameState> state, std::shared_ptr<const CancellationToken> parentToken, const ImprovementCallback& onImprovement) {
+			using Clock = std::chrono::steady_clock;
+
+			auto myColor = state->whosTurn();
+			auto myAgents = state->getAgents(myColor);
+			int32 agentCount = (int32)myAgents.size();
+			auto result = TurnInstruction(state, myColor);
+			if (state->isOver() || agentCount == 0) return result;
+
+			int32 myTurnsLeft = (state->getInitialState()->turnCount - state->getTurnIndex() + 1) / 2;
+			int32 turnCount = Max(1, Min(m_searchTurnCount, myTurnsLeft));
+			int32 layerCount = turnCount * agentCount;
+
+			int32 timeLimit = Max(0, state->getInitialState()->turnTimeLimitInMiliseconds - m_safetyMarginInMiliseconds);
+			auto cancellationToken = CancellationToken::WithTimeLimit(std::chrono::milliseconds(timeLimit), parentToken);
+
+			auto threadPool = SolverExecutor::Budget(m_threadBudget);
+			uint32 threadCount = threadPool->threadCount();
+
+			Array<BeamNode> beam;
+			{
+				BeamNode root;
+				root.turnStart = state;
+				root.evaluated = state;
+				root.turn = 0;
+				root.agentIndex = 0;
+				root.evaluation = Evaluate(*state, myColor);
+				root.hash = state->hash();
+				beam.push_back(root);
+			}
+
+			int32 beamWidth = InitialBeamWidth;
+			int32 completedLayers = 0;
+			Optional<ShortenMoveSet> reportedMoves; // 最後に onImprovement に渡した最初のターンの行動
+
+			for (int32 layer = 0; layer < layerCount; layer++) {
+				PROCON34_PROFILE_SCOPE("BeamSearch::layer");
+				auto layerStart = Clock::now();
+				size_t expandedNodeCount = beam.size();
+
+				// ビームを分割して並列に展開する
+				size_t sliceCount = Min<size_t>(threadCount, beam.size());
+				Array<Array<BeamNode>> expanded(sliceCount);
+				for (size_t s = 0; s < sliceCount; s++) {
+					threadPool->pushTask([&, s](uint32) {
+						for (size_t i = s; i < beam.size(); i += sliceCount) {
+							if (cancellationToken->isCancelled()) return;
+							ExpandNode(beam[i], myColor, agentCount, expanded[s]);
+						}
+					});
+				}
+				threadPool->sync();
+				if (cancellationToken->isCancelled()) break;
+
+				Array<BeamNode> candidates;
+				for (auto& slice : expanded) for (auto& node : slice) candidates.push_back(std::move(node));
+				if (candidates.empty()) break;
+
+				// 評価値の降順に並べ、同じ局面は 1 つだけ残す
+				std::sort(candidates.begin(), candidates.end(), [](const BeamNode& a, const BeamNode& b) { return a.evaluation > b.evaluation; });
+				HashSet<uint64> visited;
+				Array<BeamNode> nextBeam;
+				for (auto& node : candidates) {
+					if ((int32)nextBeam.size() >= beamWidth) break;
+					if (!visited.insert(node.hash).second) continue;
+					nextBeam.push_back(std::move(node));
+				}
+				beam = std::move(nextBeam);
+				completedLayers = layer + 1;
+
+				// 最初のターンを決め終えた後は、深く読んで最良の行動が変わるたびに渡す
+				if (onImprovement && beam.front().turn > 0 && reportedMoves != beam.front().firstMoves) {
+					reportedMoves = beam.front().firstMoves;
+					TurnInstruction improved(state, myColor);
+					for (int32 i = 0; i < agentCount; i++) improved.insert(ShortenMove::Decode(reportedMoves->getAt(i), myAgents[i]));
+					onImprovement(improved);
+				}
+
+				// 残り時間から次の層のビーム幅を決める。
+				// この層で子 1 つあたりにかかった時間が、残りの層でも同じだと仮定する。
+				auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - layerStart).count();
+				double timePerChild = (double)Max<int64>(elapsed, 1) / Max<size_t>(candidates.size(), 1);
+				double childrenPerNode = Max(1.0, (double)candidates.size() / Max<size_t>(expandedNodeCount, 1));
+				auto remaining = cancellationToken->remainingTime().value_or(std::chrono::milliseconds(0));
+				double remainingMicroseconds = (double)remaining.count() * 1000.0;
+				int32 remainingLayers = layerCount - completedLayers;
+				if (remainingLayers > 0) {
+					double affordable = remainingMicroseconds / remainingLayers / (timePerChild * childrenPerNode);
+					beamWidth = Clamp((int32)Min(affordable, (double)m_maxBeamWidth), MinBeamWidth, m_maxBeamWidth);
+				}
+			}
+
+			// 最初のターンを決め終えていれば、その中で最良の行動を使う。
+			// 決め終えていなければ、決めた職人の行動だけを使う。
+			const BeamNode& best = beam.front();
+			bool firstTurnDecided = best.turn > 0;
+			auto moves = firstTurnDecided ? best.firstMoves : best.partial;
+			int32 decidedAgents = firstTurnDecided ? agentCount : best.agentIndex;
+			for (int32 i = 0; i < decidedAgents; i++) {
+				result.insert(ShortenMove::Decode(moves.getAt(i), myAgents[i]));
+			}
+
+			Console << U"Beam Turn #{} : layers = {} / {} , width = {} , evaluation = {}"_fmt(state->getTurnIndex(), completedLayers, layerCount, beamWidth, best.evaluation);
+
+			return result;
+		}
+
+		String BeamSearch::name() { return U"ビームサーチ"; }
+
+	}
+
+
+} // namespace Procon34
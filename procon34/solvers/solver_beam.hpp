@@ -0,0 +1,45 @@
+﻿#pragma once
+#include "../stdafx.h"
+#include "solver_list.hpp"
+
+namespace Procon34 {
+
+
+	namespace Solvers {
+
+
+		// ビームサーチ。
+		// 自分の職人の行動を 1 人ずつ決め、全員決まったら相手は滞在するとしてターンを進める。
+		// 職人どうしの干渉（同じマスへの建築や移動）は GameState::makeMove でそのまま評価される。
+		class BeamSearch : public SolverInterface {
+		public:
+
+			// safetyMarginInMiliseconds : ターンの制限時間のうち、最後のこれだけの時間は探索せずに残す
+			// searchTurnCount : 読む自分の手番の数
+			// maxBeamWidth : ビーム幅の上限。実際の幅は残り時間から決める
+			// threadBudget : 共有のプールで同時に使うスレッドの数。 none ならすべて
+			BeamSearch(int32 safetyMarginInMiliseconds = 1000, int32 searchTurnCount = 3, int32 maxBeamWidth = 2000, Optional<uint32> threadBudget = none);
+
+		private:
+
+			// 盤面の状態から指示を作る
+			TurnInstruction operator()(BoxPtr<const GameState> state);
+
+			TurnInstruction solve(BoxPtr<const GameState> state, std::shared_ptr<const CancellationToken> cancellationToken);
+
+			// 最初のターンを決め終えた後、層を進めて最良の行動が変わるたびに onImprovement に渡す
+			TurnInstruction solveAnytime(BoxPtr<const GameState> state, std::shared_ptr<const CancellationToken> cancellationToken, const ImprovementCallback& onImprovement);
+
+			String name();
+
+			int32 m_safetyMarginInMiliseconds;
+			int32 m_searchTurnCount;
+			int32 m_maxBeamWidth;
+			Optional<uint32> m_threadBudget;
+
+		};
+
+	}
+
+
+} // namespace Procon34
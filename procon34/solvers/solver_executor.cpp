@@ -0,0 +1,70 @@
+﻿#include "solver_executor.hpp"
+
+#include <mutex>
+
+namespace Procon34 {
+
+	namespace SolverExecutor {
+
+		namespace {
+
+			std::mutex g_mutex;
+			Config g_config;
+			std::unique_ptr<ThreadPool> g_pool; // g_mutex で守る。プロセスの終了まで破棄しない
+
+			thread_local Optional<uint32> t_concurrencyLimit; // ScopedConcurrency で決めた上限
+
+		}
+
+		void Configure(const Config& config) {
+			std::lock_guard lock(g_mutex);
+			if (g_pool) throw Error(U"error at SolverExecutor::Configure : the pool has already been constructed");
+			g_config = config;
+		}
+
+		void ConfigureFromCommandLine() {
+			Config config;
+			for (auto& arg : System::GetCommandLineArgs()) {
+				if (arg == U"--pin-threads") config.pinThreads = true;
+				if (arg.starts_with(U"--solver-threads=")) {
+					if (auto count = ParseOpt<uint32>(arg.substr(17))) config.threadCount = *count;
+				}
+			}
+			Configure(config);
+		}
+
+		uint32 ThreadCount() {
+			std::lock_guard lock(g_mutex);
+			if (g_pool) return g_pool->threadCount();
+			return Max<uint32>(1, g_config.threadCount.value_or(ThreadPool::HardwareConcurrency().value_or(4)));
+		}
+
+		ThreadPool& Pool() {
+			std::lock_guard lock(g_mutex);
+			if (!g_pool) {
+				uint32 threadCount = Max<uint32>(1, g_config.threadCount.value_or(ThreadPool::HardwareConcurrency().value_or(4)));
+				g_pool = ThreadPool::Construct(threadCount, g_config.pinThreads);
+			}
+			return *g_pool;
+		}
+
+		std::unique_ptr<ThreadPool> Budget(Optional<uint32> concurrency) {
+			auto& pool = Pool();
+			uint32 limit = concurrency.value_or(pool.threadCount());
+			if (t_concurrencyLimit) limit = Min(limit, *t_concurrencyLimit);
+			return ThreadPool::ConstructLimited(pool, Max<uint32>(1, limit));
+		}
+
+		ScopedConcurrency::ScopedConcurrency(Optional<uint32> concurrency)
+			: m_previous(t_concurrencyLimit)
+		{
+			if (concurrency) t_concurrencyLimit = m_previous ? Min(*m_previous, *concurrency) : *concurrency;
+		}
+
+		ScopedConcurrency::~ScopedConcurrency() {
+			t_concurrencyLimit = m_previous;
+		}
+
+	}
+
+}
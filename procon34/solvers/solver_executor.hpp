@@ -0,0 +1,51 @@
+﻿#pragma once
+#include "../stdafx.h"
+#include "thread_pool.hpp"
+
+// プロセス全体で 1 つだけ持つ、探索用のスレッドプール。
+// 複数の試合の MatchInteractor 、シミュレータ、 GUI から呼ばれる探索がすべてこれを共有し、
+// 探索ごとに Budget で同時に使うスレッドの数を決める。スレッドは最初に Pool を呼んだときに作られ、プロセスの終了まで残る。
+
+namespace Procon34 {
+
+	namespace SolverExecutor {
+
+		struct Config {
+			Optional<uint32> threadCount = none; // none ならハードウェアのスレッド数
+			bool pinThreads = false; // スレッドを論理プロセッサに固定する
+		};
+
+		// 最初に Pool を呼ぶ前に設定する。プールを作った後に呼ぶと例外を投げる
+		void Configure(const Config& config);
+
+		// コマンドライン引数 --solver-threads=N と --pin-threads を読んで Configure する
+		void ConfigureFromCommandLine();
+
+		// プールのスレッド数（プールは作らない）
+		uint32 ThreadCount();
+
+		// 共有のプール。最初に呼ばれたときに作る
+		ThreadPool& Pool();
+
+		// 共有のプールのスレッドを、同時には最大 concurrency 個だけ使うプール。
+		// none ならすべてのスレッドを使ってよい。探索 1 回ぶんの間だけ持つことを想定している。
+		// 呼んだスレッドに ScopedConcurrency があれば、その数も超えない
+		std::unique_ptr<ThreadPool> Budget(Optional<uint32> concurrency = none);
+
+		// これがある間、同じスレッドから呼んだ Budget の同時に使うスレッドの数を concurrency 以下にする（ none なら何もしない）。
+		// ソルバーを作り直さずに、探索ごとに割り当てを変えるのに使う（ MatchScheduler ）
+		class ScopedConcurrency {
+		public:
+			ScopedConcurrency(Optional<uint32> concurrency);
+			~ScopedConcurrency();
+
+			ScopedConcurrency(const ScopedConcurrency&) = delete;
+			ScopedConcurrency& operator=(const ScopedConcurrency&) = delete;
+
+		private:
+			Optional<uint32> m_previous;
+		};
+
+	}
+
+}
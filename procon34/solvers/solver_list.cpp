@@ -3,6 +3,8 @@
 #include "grid_shortpath.hpp"
 #include "solver_main.hpp"
 #include "solver_main2.hpp"
+#include "solver_mcts.hpp"
+#include "solver_beam.hpp"
 
 namespace Procon34 {
 
@@ -167,6 +169,10 @@ namespace Procon34 {
 		res.push_back(std::make_shared<Solvers::RandomWalk>());
 		res.push_back(std::make_shared<Solvers::StrictRound>());
 		res.push_back(std::make_shared<Solvers::MainSolution>());
+		res.push_back(std::make_shared<Solvers::MonteCarloTreeSearch>());
+		res.push_back(std::make_shared<Solvers::BeamSearch>());
+
+		// 最後のものを試合で使う（ MatchInteractor に渡すソルバーと Pondering は ListOfSolvers().back() ）
 		res.push_back(std::make_shared<Solvers::MainSolution2>());
 
 		return res;
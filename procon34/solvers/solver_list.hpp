@@ -1,6 +1,8 @@
 ﻿#pragma once
 #include "../stdafx.h"
 #include "../game_simulator.hpp"
+#include "cancellation.hpp"
+#include <functional>
 
 namespace Procon34 {
 
@@ -10,6 +12,16 @@ namespace Procon34 {
 
 		virtual TurnInstruction operator()(BoxPtr<const GameState> state) = 0;
 
+		// cancellationToken が打ち切られたら、なるべく早くそれまでに得た指示を返す（制限時間による打ち切りとあわせて）。
+		// 外からの打ち切りに対応していないソルバーでは operator() と同じ
+		virtual TurnInstruction solve(BoxPtr<const GameState> state, std::shared_ptr<const CancellationToken> cancellationToken) { return operator()(state); }
+
+		using ImprovementCallback = std::function<void(const TurnInstruction&)>;
+
+		// solve と同じだが、探索の途中で前より（ソルバーの基準で）よい指示が見つかるたびに onImprovement に渡す（探索しているスレッドから呼ぶので、すぐ戻ること）。
+		// 途中の指示を出さないソルバーでは solve と同じ
+		virtual TurnInstruction solveAnytime(BoxPtr<const GameState> state, std::shared_ptr<const CancellationToken> cancellationToken, const ImprovementCallback& onImprovement) { return solve(state, cancellationToken); }
+
 		virtual String name() { return U"unnamed"; }
 
 		static Array<std::shared_ptr<SolverInterface>> ListOfSolvers();
@@ -3,6 +3,7 @@
 #include "solver_main.hpp"
 #include "construct_wall_path.hpp"
 #include "shorten_move.hpp"
+#include "distance_fields.hpp"
 
 namespace Procon34 {
 
@@ -15,7 +16,6 @@ namespace Procon34 {
 			auto myColor = state->whosTurn();
 			auto opponentColor = state->OpponentOf(myColor);
 			auto myAgents = state->getAgents(myColor);
-			auto opponentAgents = state->getAgents(opponentColor);
 
 			auto board = state->getBoard();
 			auto boardSize = board->getSize();
@@ -30,13 +30,7 @@ namespace Procon34 {
 			auto enabledDifference = WallPath::EnabledDifferenceDefaultValue();
 			auto turnProfit = Array<int64>(turnCount + 1);
 
-			auto distanceFromOpponentAgnet = [&](BoardPos pos) -> int32 {
-				int32 res = 1001001;
-				for (auto agent : opponentAgents) {
-					res = std::min(res, std::abs(agent.pos.r - pos.r) + std::abs(agent.pos.c - pos.c));
-				}
-				return res;
-				};
+			auto distanceFields = DistanceFields::Of(state);
 
 			for (int32 r = 0; r < board->getHeight(); r++) for (int32 c = 0; c < board->getWidth(); c++) {
 				auto boardPos = BoardPos(r, c);
@@ -52,7 +46,7 @@ namespace Procon34 {
 					tProfit = std::min(tProfit, (int64)-100);
 					wProfit = std::min(wProfit, (int64)-100);
 				}
-				int32 dist = distanceFromOpponentAgnet(boardPos);
+				int32 dist = distanceFields->nearestDistance(opponentColor, boardPos);
 				if (dist == 0) {
 					for (int32 t = 0; t <= turnCount; t++) vProfit[t] = -1001001001001;
 				}
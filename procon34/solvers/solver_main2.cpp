@@ -4,23 +4,244 @@
 #include "construct_wall_path_2.hpp"
 #include "shorten_move.hpp"
 #include "thread_pool.hpp"
+#include "task_group.hpp"
+#include "solver_executor.hpp"
+#include "profiler.hpp"
+#include "distance_fields.hpp"
+#include "ranked_plans.hpp"
+
+#include <atomic>
 
 namespace Procon34 {
 
 
 	namespace Solvers {
 
+		namespace {
+
+			struct PlanStep {
+				int32 agentIndex;
+				bool positive;
+				int32 from;
+				int32 to;
+			};
+
+			// 全員の最初の行動を firstMoves に固定したとき、利得が最大になる壁の経路の組（閉路と単独の経路）を求める。
+			// 職人の集合の DP は計画の最初の行動しか持たないので、次のターンに使うためにここで経路を復元する。
+			// 候補が最初の行動で絞られるので、疎な DP で足りる。
+			Optional<Array<Array<PlanStep>>> ReconstructPlan(
+				int32 agentCount,
+				int32 searchSize,
+				ShortenMoveSet firstMoves,
+				const Array<Array<ConstructWallPath2::Answer>>& wallPaths,
+				const Array<Array<ShortenMove::Type>>& wallPathMoves,
+				const Array<Array<ConstructWallPath2::Answer>>& wallPathsPositive
+			) {
+				static const int64 NegativeInf = -1001001001001;
+				struct Group {
+					int64 profit = NegativeInf;
+					Array<Array<PlanStep>> parts;
+				};
+				size_t agentMaskCount = (size_t)1 << agentCount;
+				Array<Group> best(agentMaskCount);
+
+				// 単独の経路
+				for (int32 i = 0; i < agentCount; i++) {
+					for (auto& a : wallPathsPositive[i]) {
+						if (ShortenMove::Encode(a.firstMove) != firstMoves.getAt(i) || a.profit <= best[(size_t)1 << i].profit) continue;
+						best[(size_t)1 << i] = Group{ a.profit, { { PlanStep{ i, true, a.from, a.to } } } };
+					}
+				}
+
+				// 閉路 : solveStage の DP と同じく、添え字が最大の職人 m から始めて、より小さい職人をつないで s に戻る
+				struct Entry {
+					int64 profit;
+					int64 parent; // 前の状態のキー。最初の経路なら -1
+					PlanStep step;
+				};
+				for (int32 m = 0; m < agentCount; m++) {
+					Array<size_t> firstPaths;
+					for (size_t k = 0; k < wallPaths[m].size(); k++) if (wallPathMoves[m][k] == firstMoves.getAt(m)) firstPaths.push_back(k);
+					Array<int32> starts;
+					for (size_t k : firstPaths) starts.push_back(wallPaths[m][k].from);
+					starts.sort_and_unique();
+
+					for (int32 s : starts) {
+						// キーは j * searchSize + base
+						HashTable<int64, Entry> dp;
+						Array<Array<int64>> keysByMask((size_t)1 << m);
+						auto relax = [&](uint32 j, int64 profit, int64 parent, PlanStep step) {
+							int64 key = (int64)j * searchSize + step.to;
+							auto it = dp.find(key);
+							if (it == dp.end()) {
+								dp.emplace(key, Entry{ profit, parent, step });
+								keysByMask[j].push_back(key);
+							}
+							else if (it->second.profit < profit) {
+								it->second = Entry{ profit, parent, step };
+							}
+						};
+						for (size_t k : firstPaths) {
+							auto& a = wallPaths[m][k];
+							if (a.from == s) relax(0, a.profit, -1, PlanStep{ m, false, a.from, a.to });
+						}
+						// 遷移は j を大きくする向きだけなので、 j の小さい順に確定する
+						for (uint32 j = 0; j < ((uint32)1 << m); j++) {
+							for (int64 key : keysByMask[j]) {
+								Entry entry = dp[key];
+								int32 base = (int32)(key % searchSize);
+								uint32 usedAgents = j | ((uint32)1 << m);
+								if (base == s && entry.profit > best[usedAgents].profit) {
+									Array<PlanStep> cycle;
+									for (int64 k = key; k != -1; k = dp[k].parent) cycle.push_back(dp[k].step);
+									best[usedAgents] = Group{ entry.profit, { cycle } };
+								}
+								for (int32 ag = 0; ag < m; ag++) if (!((j >> ag) & 1)) {
+									for (size_t k = 0; k < wallPaths[ag].size(); k++) {
+										auto& a = wallPaths[ag][k];
+										if (a.from != base || wallPathMoves[ag][k] != firstMoves.getAt(ag)) continue;
+										relax(j | ((uint32)1 << ag), entry.profit + a.profit, key, PlanStep{ ag, false, a.from, a.to });
+									}
+								}
+							}
+						}
+					}
+				}
+
+				// 集合を 2 つに分けて合わせる
+				for (size_t i = 1; i < agentMaskCount; i++) {
+					for (size_t j = (i - 1) & i; j != 0; j = (j - 1) & i) {
+						if (best[j].profit <= NegativeInf || best[i - j].profit <= NegativeInf) continue;
+						int64 profit = best[j].profit + best[i - j].profit;
+						if (profit <= best[i].profit) continue;
+						auto parts = best[j].parts;
+						parts.append(best[i - j].parts);
+						best[i] = Group{ profit, std::move(parts) };
+					}
+				}
+
+				if (best[agentMaskCount - 1].profit <= NegativeInf) return none;
+				return best[agentMaskCount - 1].parts;
+			}
+
+		}
+
+		MainSolution2::MainSolution2(int32 safetyMarginInMiliseconds, int32 maxTurnCount, int32 planCount, Optional<uint32> threadBudget)
+			: m_safetyMarginInMiliseconds(safetyMarginInMiliseconds)
+			, m_maxTurnCount(maxTurnCount)
+			, m_planCount(planCount)
+			, m_threadBudget(threadBudget)
+		{
+			if (planCount < 1 || RankedPlanTable<ShortenMoveSet>::MaxPlanCount < planCount) throw Error(U"error at MainSolution2 : planCount is out of range");
+		}
+
 		// 盤面の状態から指示を作る
 		TurnInstruction MainSolution2::operator()(BoxPtr<const GameState> state) {
+			return solve(state, nullptr);
+		}
+
+		TurnInstruction MainSolution2::solve(BoxPtr<const GameState> state, std::shared_ptr<const CancellationToken> parentToken) {
+			return solveAnytime(state, parentToken, nullptr);
+		}
+
+		TurnInstruction MainSolution2::solveAnytime(BoxPtr<const GameState> state, std::shared_ptr<const CancellationToken> parentToken, const ImprovementCallback& onImprovement) {
 			int32 myTurnsLeft = (state->getInitialState()->turnCount - state->getTurnIndex() + 1) / 2;
+			auto myColor = state->whosTurn();
+			auto myAgents = state->getAgents(myColor);
+
+			int32 timeLimit = state->getInitialState()->turnTimeLimitInMiliseconds - m_safetyMarginInMiliseconds;
+			auto cancellationToken = CancellationToken::WithTimeLimit(std::chrono::milliseconds(Max(0, timeLimit)), parentToken);
+
+			// 読むターン数を 2 ずつ増やし、最後に壁の候補を広げる
+			int32 maxTurnCount = Min(m_maxTurnCount, myTurnsLeft);
+			Array<SearchStage> stages;
+			for (int32 t = Min(2, maxTurnCount); ; t = Min(t + 2, maxTurnCount)) {
+				stages.push_back(SearchStage{ .turnCount = t, .differenceRadius = 5 });
+				if (t >= maxTurnCount) break;
+			}
+			stages.push_back(SearchStage{ .turnCount = maxTurnCount, .differenceRadius = 7 });
+
+			// 前の自分の手番の計画が使えるなら、閉路を候補に入れて始める。
+			// 最初の段階が間に合いそうにないほど時間がなければ（途中の指示を渡す先があれば常に）、その計画の壁の端点からだけ解いたものを先に得る
+			const WarmStart* warmStart = nullptr;
+			if (m_warmStart && m_warmStart->turnIndex + 2 == state->getTurnIndex() && m_warmStart->color == myColor && m_warmStart->agentCount == myAgents.size()) {
+				warmStart = &*m_warmStart;
+				if (onImprovement || !m_firstStageMilliseconds || timeLimit < *m_firstStageMilliseconds) {
+					auto warmStage = warmStart->stage;
+					warmStage.turnCount = Min(warmStage.turnCount, maxTurnCount);
+					warmStage.warmStartOnly = true;
+					stages.push_front(warmStage);
+				}
+			}
+
+			// 完了した段階のうち、最も深く広く読んだものの計画を採用する。
+			// 最初の段階も期限で打ち切る（大きな盤面では最初の段階だけで制限時間を超えることがある）
+			Optional<StageResult> bestResult;
+			SearchStage bestStage = stages.front();
+			for (size_t i = 0; i < stages.size(); i++) {
+				auto stageBegin = CancellationToken::Clock::now();
+				auto stageResult = solveStage(state, stages[i], cancellationToken, warmStart);
+				if (!stages[i].warmStartOnly && !bestResult) {
+					// 打ち切られたときは、少なくともこれだけかかる（次のターンに前の計画から先に解くかの判断に使う）
+					int64 elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(CancellationToken::Clock::now() - stageBegin).count();
+					m_firstStageMilliseconds = stageResult ? elapsed : Max(m_firstStageMilliseconds.value_or(0), elapsed);
+				}
+				if (!stageResult.has_value()) {
+					// 前の計画が使えなかっただけなら、普通に解く
+					if (stages[i].warmStartOnly) continue;
+					break;
+				}
+				bestResult = stageResult;
+				bestStage = stages[i];
+
+				// 後の段階ほど深く広く読んでいるので、完了するたびに渡す
+				if (onImprovement) onImprovement(bestResult->instruction);
+				if (cancellationToken->isCancelled()) break;
+			}
+
+			// どの段階も期限までに終わらなかった。探索しない指示を返す（前の計画も残しておく）
+			if (!bestResult) {
+				Console << U"Turn #{} : no stage finished in time , greedy"_fmt(state->getTurnIndex());
+				return GreedyInstruction(state);
+			}
+
+			auto result = bestResult->instruction;
+
+			if (bestResult->plan.size() > 0) {
+				m_warmStart = WarmStart{ .turnIndex = state->getTurnIndex(), .color = myColor, .agentCount = myAgents.size(), .stage = bestStage, .plan = bestResult->plan };
+				m_warmStart->stage.warmStartOnly = false;
+			}
+			else {
+				m_warmStart = none;
+			}
+
+			Console << U"Turn #{} : turnCount = {} , radius = {} , profit = {}{}"_fmt(state->getTurnIndex(), bestStage.turnCount, bestStage.differenceRadius, bestResult->profit, bestStage.warmStartOnly ? U" (warm start)" : U"");
+			for (int32 i = 0; i < myAgents.size(); i++) {
+				auto agentMove = result[i];
+				if (agentMove.isStay()) Console << U"({}, {}) -> Stay"_fmt(myAgents[i].pos.r, myAgents[i].pos.c);
+				if (agentMove.isMove()) Console << U"({}, {}) -> Move {}"_fmt(myAgents[i].pos.r, myAgents[i].pos.c, agentMove.asMove().dir.value());
+				if (agentMove.isConstruct()) Console << U"({}, {}) -> Construct {}"_fmt(myAgents[i].pos.r, myAgents[i].pos.c, agentMove.asConstruct().dir.value());
+				if (agentMove.isDestroy()) Console << U"({}, {}) -> Destroy {}"_fmt(myAgents[i].pos.r, myAgents[i].pos.c, agentMove.asDestroy().dir.value());
+			}
+			Console << U" ---- ---- ---- ----";
+
+			// PROCON34_ENABLE_PROFILER が無効なら何もしない
+			Profiler::DumpChromeTrace(U"profile/turn_{:03}.json"_fmt(state->getTurnIndex()));
+
+			return result;
+		}
+
+		Optional<MainSolution2::StageResult> MainSolution2::solveStage(BoxPtr<const GameState> state, SearchStage stage, std::shared_ptr<const CancellationToken> cancellationToken, const WarmStart* warmStart) {
 			auto myColor = state->whosTurn();
 			auto opponentColor = state->OpponentOf(myColor);
 			auto myAgents = state->getAgents(myColor);
-			auto opponentAgents = state->getAgents(opponentColor);
 
 			auto board = state->getBoard();
 			auto boardSize = board->getSize();
-			int32 turnCount = Min(10, myTurnsLeft);
+			int32 turnCount = stage.turnCount;
+			PROCON34_PROFILE_SCOPE("MainSolution2::solveStage");
+
+			auto isCancelled = [&]() -> bool { return cancellationToken && cancellationToken->isCancelled(); };
 
 			// ----------------------------------------------
 			//   パラメータ
@@ -28,41 +249,14 @@ namespace Procon34 {
 			auto visitingProfit = Array<Grid<int64>>(turnCount + 1, Grid<int64>(boardSize, 0));
 			auto territoryProfit = Grid<int64>(boardSize, 0);
 			auto wallProfit = Grid<int64>(boardSize, 0);
-			auto enabledDifference = WallPath2::EnabledDifferenceDefaultValue();
+			auto enabledDifference = WallPath2::EnabledDifferenceWithRadius(stage.differenceRadius);
 			auto turnProfit = Array<int64>(turnCount + 1);
 			auto wallProfitPositive = Grid<int64>(boardSize, 0);
 
-			auto distanceFromOpponentAgnet = [&](BoardPos pos) -> int32 {
-				int32 res = 1001001;
-				for (auto agent : opponentAgents) {
-					res = std::min(res, std::abs(agent.pos.r - pos.r) + std::abs(agent.pos.c - pos.c));
-				}
-				return res;
-				};
+			auto distanceFields = DistanceFields::Of(state);
 
 			for (int32 i = 0; i <= turnCount; i++) turnProfit[i] = -i;
 
-			auto adjacentToMyAgent = Grid<int32>(boardSize, 0);
-			auto adjacent4ToMyWall = Grid<int32>(boardSize, 0);
-			for (int32 r = 0; r < board->getHeight(); r++) for (int32 c = 0; c < board->getWidth(); c++) {
-				auto boardPos = BoardPos(r, c);
-				auto thisMassAgent = board->getMass(boardPos).agent;
-				adjacentToMyAgent[boardPos.asPoint()]++;
-				if (thisMassAgent.has_value() && thisMassAgent->color == myColor) {
-					for (int32 d = 0; d < 8; d++) {
-						auto newPos = boardPos.movedAlong(MoveDirection(d));
-						if (!board->isOnBoard(newPos)) continue;
-						adjacentToMyAgent[newPos.asPoint()]++;
-					}
-				}
-				for (int32 d = 0; d < 8; d++) {
-					if (!MoveDirection(d).is4Direction()) continue;
-					auto newPos = boardPos.movedAlong(MoveDirection(d));
-					if (!board->isOnBoard(newPos)) continue;
-					if (board->getMass(newPos).hasWallOf(myColor)) adjacent4ToMyWall[boardPos.asPoint()]++;
-				}
-			}
-
 			for (int32 r = 0; r < board->getHeight(); r++) for (int32 c = 0; c < board->getWidth(); c++) {
 				auto boardPos = BoardPos(r, c);
 				int64 tProfit = 1000;
@@ -93,7 +287,8 @@ namespace Procon34 {
 					wProfit = std::min(wProfit, (int64)-10000);
 					wpProfit = -10000;
 				}
-				wpProfit += adjacent4ToMyWall[boardPos.asPoint()] * adjacent4ToMyWall[boardPos.asPoint()] * (-800);
+				int32 adjacent4ToMyWall = distanceFields->wallCountAround4(myColor, boardPos);
+				wpProfit += adjacent4ToMyWall * adjacent4ToMyWall * (-800);
 
 				tProfit *= 5;
 				wProfit *= 5;
@@ -109,12 +304,12 @@ namespace Procon34 {
 				tProfit = 100;
 				// サンプル　終わり
 
-				if (adjacentToMyAgent[boardPos.asPoint()] > 1) {
+				if (distanceFields->agentCountAround8(myColor, boardPos) > 0) {
 					for (size_t t = 0; t < 3; t++) if (t < vProfit.size()) {
 						vProfit[t] = -1001001001001;
 					}
 				}
-				int32 dist = distanceFromOpponentAgnet(boardPos);
+				int32 dist = distanceFields->nearestDistance(opponentColor, boardPos);
 				if (dist == 0) {
 					for (int32 t = 0; t <= turnCount; t++) vProfit[t] = -1001001001001;
 					wProfit = -1001001001001;
@@ -145,6 +340,9 @@ namespace Procon34 {
 			// ----------------------------------------------
 			//   サブルーチン
 
+			// 職人ごとの壁の経路、その中の始点ごとの経路、職人の集合の DP を、すべて共有のプールで並列に解く
+			auto threadPool = SolverExecutor::Budget(m_threadBudget);
+
 			auto gridWalking = std::make_shared<GridWalking>(state, visitingProfit);
 			auto diagGraph = std::make_shared<DiagonalGraph>(state, territoryProfit);
 			auto wallPathA = std::make_shared<WallPath2>(diagGraph, state, wallProfit, enabledDifference, false);
@@ -154,126 +352,302 @@ namespace Procon34 {
 			auto diagGraphZero = std::make_shared<DiagonalGraph>(state, Grid<int64>(boardSize, 0));
 			auto wallPathC = std::make_shared<WallPath2>(diagGraphZero, state, wallProfitPositive, enabledDifference, false);
 			auto constructWallPathPositive = ConstructWallPath2(diagGraphZero, gridWalking, { wallPathC });
+			constructWallPath.setCancellationToken(cancellationToken);
+			constructWallPathPositive.setCancellationToken(cancellationToken);
+			constructWallPath.setPlanCount(m_planCount);
+			constructWallPathPositive.setPlanCount(m_planCount);
+			constructWallPath.setThreadPool(threadPool.get());
+			constructWallPathPositive.setThreadPool(threadPool.get());
+
+			// 前の計画の壁の端点を今の base の番号に直す。角の座標から引けないものは -1
+			auto toBaseId = [&](const PlannedWall& wall, bool isFrom) -> int32 {
+				auto& graph = wall.positive ? diagGraphZero : diagGraph;
+				Point corner = isFrom ? wall.from : wall.to;
+				if (!InRange(corner.x, 0, (int32)graph->m_toBaseId.width() - 1) || !InRange(corner.y, 0, (int32)graph->m_toBaseId.height() - 1)) return -1;
+				return graph->m_toBaseId[corner];
+			};
+
+			if (stage.warmStartOnly) {
+				if (!warmStart) return none;
+				Array<int32> startBases, startBasesPositive;
+				for (auto& group : warmStart->plan) for (auto& wall : group) {
+					for (bool isFrom : { true, false }) {
+						int32 base = toBaseId(wall, isFrom);
+						if (base < 0) return none;
+						(wall.positive ? startBasesPositive : startBases).push_back(base);
+					}
+				}
+				constructWallPath.setStartBases(startBases);
+				constructWallPathPositive.setStartBases(startBasesPositive);
+			}
 
-			auto wallPaths = myAgents.map([&](Agent agent) { return constructWallPath.solve(agent, turnCount, turnProfit); });
-			auto wallPathsPositive = myAgents.map([&](Agent agent) { return constructWallPathPositive.solve(agent, turnCount, turnProfit); });
+			auto gridWalkingAnswers = gridWalking->solveAll(myAgents, turnCount);
+			Array<Array<ConstructWallPath2::Answer>> wallPaths(myAgents.size());
+			Array<Array<ConstructWallPath2::Answer>> wallPathsPositive(myAgents.size());
+			{
+				TaskGroup wallPathGroup(*threadPool, cancellationToken);
+				for (size_t i = 0; i < myAgents.size(); i++) {
+					wallPathGroup.run([&, i] { wallPaths[i] = constructWallPath.solve(myAgents[i], turnCount, turnProfit, gridWalkingAnswers[i]); });
+					wallPathGroup.run([&, i] { wallPathsPositive[i] = constructWallPathPositive.solve(myAgents[i], turnCount, turnProfit, gridWalkingAnswers[i]); });
+				}
+				wallPathGroup.wait();
+			}
+			if (isCancelled()) return none;
 
 
 			// ----------------------------------------------
 
 			static const int64 NegativeInf = -1001001001001;
-			struct SearchNode {
-				int64 profit = NegativeInf;
-				ShortenMoveSet firstMoves;
+			// 職人の集合ごとに、最初の行動の組が異なる計画を m_planCount 個まで持つ
+			using PlanTable = RankedPlanTable<ShortenMoveSet>;
+			PROCON34_PROFILE_SCOPE("MainSolution2::subsetDP");
+			size_t agentMaskCount = (size_t)1 << myAgents.size();
+			uint32 allAgents = (uint32)agentMaskCount - 1;
+			auto maxProfitCycle = PlanTable(agentMaskCount, m_planCount, NegativeInf, ShortenMoveSet());
+
+			// 最初の行動がぶつかる組み合わせは選ばない
+			auto conflicts = ShortenMoveConflicts(myAgents);
+			Array<Array<ShortenMove::Type>> wallPathMoves(myAgents.size());
+			for (size_t i = 0; i < myAgents.size(); i++) {
+				for (auto& a : wallPaths[i]) wallPathMoves[i].push_back(ShortenMove::Encode(a.firstMove));
+			}
+
+			// 分枝限定法の上界 : 職人 b が計画全体に足せる利得は profitCap[b] 以下
+			// restProfitCap[mask] : mask に含まれない職人の profitCap の和
+			Array<int64> profitCap(myAgents.size(), 0);
+			for (size_t b = 0; b < myAgents.size(); b++) {
+				for (auto& a : wallPaths[b]) profitCap[b] = Max(profitCap[b], a.profit);
+				for (auto& a : wallPathsPositive[b]) profitCap[b] = Max(profitCap[b], a.profit);
+			}
+			Array<int64> restProfitCap(agentMaskCount, 0);
+			for (size_t mask = 0; mask < agentMaskCount; mask++) {
+				for (size_t b = 0; b < myAgents.size(); b++) if (!((mask >> b) & 1)) restProfitCap[mask] += profitCap[b];
+			}
+
+			// 閉路の表に単独の計画を加え、集合を 2 つに分けて合わせる。よい組がぶつかるなら、次によい計画で代える
+			auto combinePlans = [&](const PlanTable& cycles) -> PlanTable {
+				auto plans = cycles;
+
+				for (int32 agentId = 0; agentId < (int32)myAgents.size(); agentId++) {
+					for (auto a : wallPathsPositive[agentId]) {
+						ShortenMoveSet firstMoves;
+						firstMoves.setAt(agentId, ShortenMove::Encode(a.firstMove));
+						plans.push((size_t)1 << agentId, a.profit, firstMoves);
+					}
+				}
+
+				for (size_t i = 0; i < agentMaskCount; i++) {
+					for (size_t j = (i - 1) & i; j != 0; j = (j - 1) & i) {
+						for (auto lhs = plans.begin(j); lhs != plans.end(j); lhs++) {
+							for (auto rhs = plans.begin(i - j); rhs != plans.end(i - j); rhs++) {
+								int64 nxprofit = lhs->profit + rhs->profit;
+								if (nxprofit <= plans.threshold(i)) break;
+								if (conflicts.conflicts(lhs->key, (uint32)j, rhs->key, (uint32)(i - j))) continue;
+								auto firstMoves = rhs->key;
+								for (int32 b = 0; b < myAgents.size(); b++) if ((j >> b) & 1) {
+									firstMoves.setAt(b, lhs->key.getAt(b));
+								}
+								plans.push(i, nxprofit, firstMoves);
+							}
+						}
+					}
+				}
+				return plans;
 			};
-			auto maxProfitCycle = Array<SearchNode>((size_t)1 << myAgents.size());
 
-			auto threadPool = ThreadPool::Construct(10);
+			// その時点で求まった閉路だけで組んだ計画。全員ぶんの利得は最終的な計画の利得の下界になる
+			// 前の計画の閉路を今の答えで評価し直し、すべての経路が残っていて最初の行動がぶつからなければ候補に入れる
+			if (warmStart) {
+				int32 searchSize = constructWallPath.getNumberOfBases();
+				for (auto& group : warmStart->plan) {
+					if (group.empty() || group.front().positive) continue;
+
+					// 経路ごとに、同じ端点の答え（最初の行動が異なるものが最大 m_planCount 個）
+					Array<Array<size_t>> candidates;
+					uint32 usedAgents = 0;
+					for (auto& wall : group) {
+						int32 from = toBaseId(wall, true), to = toBaseId(wall, false);
+						Array<size_t> found;
+						if (from >= 0 && to >= 0 && from < searchSize && to < searchSize) {
+							for (size_t k = 0; k < wallPaths[wall.agentIndex].size(); k++) {
+								auto& a = wallPaths[wall.agentIndex][k];
+								if (a.from == from && a.to == to) found.push_back(k);
+							}
+						}
+						if (found.empty() || ((usedAgents >> wall.agentIndex) & 1)) {
+							candidates.clear();
+							break;
+						}
+						usedAgents |= (uint32)1 << wall.agentIndex;
+						candidates.push_back(std::move(found));
+					}
+					if (candidates.empty()) continue;
 
-			for (int32 maxAgentIndex = 0; maxAgentIndex < (int32)myAgents.size(); maxAgentIndex++) {
+					// 組み合わせはたかだか m_planCount ^ (職人の数) 通りなので全部試す
+					auto search = [&](auto&& self, size_t index, int64 profit, ShortenMoveSet moves, uint32 mask) -> void {
+						if (index == group.size()) {
+							maxProfitCycle.push(usedAgents, profit, moves);
+							return;
+						}
+						int32 agentIndex = group[index].agentIndex;
+						for (size_t k : candidates[index]) {
+							auto move = wallPathMoves[agentIndex][k];
+							if (conflicts.conflicts(agentIndex, move, moves, mask)) continue;
+							auto nextMoves = moves;
+							nextMoves.setAt(agentIndex, move);
+							self(self, index + 1, profit + wallPaths[agentIndex][k].profit, nextMoves, mask | ((uint32)1 << agentIndex));
+						}
+					};
+					search(search, 0, 0, ShortenMoveSet(), 0);
+				}
+			}
+
+			auto maxProfitPlan = combinePlans(maxProfitCycle);
+
+			// 暫定解 : これ未満にしかならない状態は調べない（全スレッドで共有）。
+			// combinePlans は上位 K 個だけを残し、ぶつかる組を飛ばすので、表が増えても全員ぶんの最良が下がることがある。
+			// そこで暫定解に使った計画は、全員ぶんの閉路として表に入れておく（最後の計画の利得が暫定解を下回らないように）
+			std::atomic<int64> incumbent = NegativeInf;
+			auto raiseIncumbent = [&](int64 profit) {
+				int64 current = incumbent.load(std::memory_order_relaxed);
+				while (current < profit && !incumbent.compare_exchange_weak(current, profit, std::memory_order_relaxed)) {}
+			};
+			auto pinBest = [&]() {
+				auto& best = maxProfitPlan.best(allAgents);
+				if (best.profit <= NegativeInf) return;
+				maxProfitCycle.push(allAgents, best.profit, best.key);
+				raiseIncumbent(best.profit);
+			};
+			pinBest();
+
+			// 枝刈りに使う下界。枝刈りしないときは何も飛ばさない値
+			auto pruningBound = [&]() -> int64 {
+				return m_branchAndBound ? incumbent.load(std::memory_order_relaxed) : std::numeric_limits<int64>::min();
+			};
+
+			// 前の計画の端点からだけ解くときは、閉路を探さない
+			int32 searchAgentCount = stage.warmStartOnly ? 0 : (int32)myAgents.size();
+
+			for (int32 maxAgentIndex = 0; maxAgentIndex < searchAgentCount; maxAgentIndex++) {
 				int32 searchSize = constructWallPath.getNumberOfBases();
+				uint32 maxAgentBit = (uint32)1 << maxAgentIndex;
+
+				// 始点ごとの、最初の壁の利得の最大値
+				auto startProfit = Array<int64>(searchSize, NegativeInf);
+				for (auto& a : wallPaths[maxAgentIndex]) startProfit[a.from] = Max(startProfit[a.from], a.profit);
 
-				auto canStart = Array<int32>(searchSize, 0);
-				for (auto& a : wallPaths[maxAgentIndex]) canStart[a.from] = 1;
+				Array<PlanTable> maxProfitCycleBuffer(searchSize);
+				TaskGroup cycleGroup(*threadPool, cancellationToken);
 
-				Array<Array<SearchNode>> maxProfitCycleBuffer(canStart.size(), Array<SearchNode>((size_t)1 << myAgents.size()));
+				for (int32 s = 0; s < searchSize; s++) if (startProfit[s] > NegativeInf) {
+					if (startProfit[s] + restProfitCap[maxAgentBit] < pruningBound()) continue;
 
-				for (int32 s = 0; s < (int32)canStart.size(); s++) if(canStart[s] == 1) {
-					auto task = [&, s] (uint32){
+					cycleGroup.run([&, s] {
 
-						auto dp = Array<Array<SearchNode>>((size_t)1 << maxAgentIndex, Array<SearchNode>(searchSize));
-						for (auto& a : wallPaths[maxAgentIndex]) if (a.from == s) if (dp[0][a.to].profit < a.profit) {
-							dp[0][a.to].profit = a.profit;
-							dp[0][a.to].firstMoves.setAt(maxAgentIndex, ShortenMove::Encode(a.firstMove));
+						// dp[j][base] は dp.begin(j * searchSize + base) から
+						auto dp = PlanTable(((size_t)1 << maxAgentIndex) * searchSize, m_planCount, NegativeInf, ShortenMoveSet());
+						for (size_t k = 0; k < wallPaths[maxAgentIndex].size(); k++) {
+							auto& a = wallPaths[maxAgentIndex][k];
+							if (a.from != s) continue;
+							ShortenMoveSet firstMoves;
+							firstMoves.setAt(maxAgentIndex, wallPathMoves[maxAgentIndex][k]);
+							dp.push(a.to, a.profit, firstMoves);
 						}
-						for (int32 j = 0; j < (int32)dp.size(); j++) {
-							//maxProfitCycle[j + (1 << maxAgentIndex)] = *std::max_element(dp[j].begin(), dp[j].end(),
-							//	[](const SearchNode& l, const SearchNode& r) { return l.profit < r.profit; });
-							{
-								auto maxProfitTmp = dp[j][s];
-								if (maxProfitCycleBuffer[s][j + (1 << maxAgentIndex)].profit < maxProfitTmp.profit) {
-									maxProfitCycleBuffer[s][j + (1 << maxAgentIndex)] = maxProfitTmp;
+						auto& buffer = maxProfitCycleBuffer[s];
+						buffer = PlanTable(agentMaskCount, m_planCount, NegativeInf, ShortenMoveSet());
+						for (int32 j = 0; j < ((int32)1 << maxAgentIndex); j++) {
+							if (cycleGroup.isCancelled()) return;
+							uint32 usedAgents = (uint32)j | maxAgentBit;
+							int64 lowerBound = pruningBound();
+
+							// この集合のどの状態から広げても暫定解を超えないなら飛ばす
+							int64 maskBestProfit = NegativeInf;
+							for (int32 base = 0; base < searchSize; base++) maskBestProfit = Max(maskBestProfit, dp.best((size_t)j * searchSize + base).profit);
+							if (maskBestProfit <= NegativeInf || maskBestProfit + restProfitCap[usedAgents] < lowerBound) continue;
+
+							// 閉路ができたら、残りの職人の計画と合わせて暫定解を更新（合わせた計画も全員ぶんとして表に入れる）
+							for (auto plan = dp.begin((size_t)j * searchSize + s); plan != dp.end((size_t)j * searchSize + s); plan++) {
+								if (!buffer.push(usedAgents, plan->profit, plan->key)) continue;
+								uint32 restAgents = allAgents ^ usedAgents;
+								if (restAgents == 0) {
+									raiseIncumbent(plan->profit);
+									continue;
 								}
+								auto& rest = maxProfitPlan.best(restAgents);
+								if (rest.profit <= NegativeInf) continue;
+								if (conflicts.conflicts(plan->key, usedAgents, rest.key, restAgents)) continue;
+								auto firstMoves = rest.key;
+								for (int32 b = 0; b < (int32)myAgents.size(); b++) if ((usedAgents >> b) & 1) firstMoves.setAt(b, plan->key.getAt(b));
+								buffer.push(allAgents, plan->profit + rest.profit, firstMoves);
+								raiseIncumbent(plan->profit + rest.profit);
 							}
+
 							for (int32 ag = 0; ag < maxAgentIndex; ag++) if (!(j & (1 << ag))) {
-								for (auto& a : wallPaths[ag]) {
-									auto& tov = dp[j | (1 << ag)][a.to];
-									int64 nxprofit = dp[j][a.from].profit + a.profit;
-									if (tov.profit < nxprofit) {
-										tov.profit = nxprofit;
-										tov.firstMoves = dp[j][a.from].firstMoves;
-										tov.firstMoves.setAt(ag, ShortenMove::Encode(a.firstMove));
+								uint32 nextAgents = usedAgents | ((uint32)1 << ag);
+								for (size_t k = 0; k < wallPaths[ag].size(); k++) {
+									auto& a = wallPaths[ag][k];
+									size_t from = (size_t)j * searchSize + a.from;
+									size_t to = (size_t)(j | (1 << ag)) * searchSize + a.to;
+
+									// まだ到達していない状態からは遷移しない。最もよい計画でも入らないなら飛ばす（ほとんどはここで終わる）
+									int64 bestProfit = dp.best(from).profit;
+									if (bestProfit <= NegativeInf || bestProfit + a.profit <= dp.threshold(to)) continue;
+									if (bestProfit + a.profit + restProfitCap[nextAgents] < lowerBound) continue;
+
+									auto move = wallPathMoves[ag][k];
+									for (auto plan = dp.begin(from); plan != dp.end(from); plan++) {
+										if (plan->profit <= NegativeInf) break;
+										int64 nxprofit = plan->profit + a.profit;
+										if (nxprofit <= dp.threshold(to) || nxprofit + restProfitCap[nextAgents] < lowerBound) break;
+										if (conflicts.conflicts(ag, move, plan->key, usedAgents)) continue;
+										auto firstMoves = plan->key;
+										firstMoves.setAt(ag, move);
+										dp.push(to, nxprofit, firstMoves);
 									}
 								}
 							}
 						}
 
-					};
-
-					threadPool->pushTask(task);
-
-				}
-
-				threadPool->sync();
+					});
 
-				for (auto& a : maxProfitCycleBuffer) {
-					for (size_t i = 0; i < maxProfitCycle.size(); i++) {
-						if (maxProfitCycle[i].profit < a[i].profit) maxProfitCycle[i] = a[i];
-					}
 				}
 
-			}
-
-			auto maxProfitPlan = maxProfitCycle;
+				cycleGroup.wait();
+				if (isCancelled()) return none;
 
-			for (int32 agentId = 0; agentId < (int32)myAgents.size(); agentId++) {
-				for (auto a : wallPathsPositive[agentId]) {
-					SearchNode buf;
-					buf.profit = a.profit;
-					buf.firstMoves.setAt(agentId, ShortenMove::Encode(a.firstMove));
-					if (maxProfitPlan[(size_t)1 << agentId].profit < buf.profit) {
-						maxProfitPlan[(size_t)1 << agentId] = buf;
+				for (auto& buffer : maxProfitCycleBuffer) if (buffer.size() > 0) {
+					for (size_t i = 0; i < agentMaskCount; i++) {
+						for (auto plan = buffer.begin(i); plan != buffer.end(i); plan++) maxProfitCycle.push(i, plan->profit, plan->key);
 					}
 				}
-			}
 
-			for (size_t i = 0; i < (size_t)1 << myAgents.size(); i++) {
-				for (size_t j = (i - 1) & i; j != 0; j = (j - 1) & i) {
-					if (maxProfitPlan[i].profit < maxProfitPlan[j].profit + maxProfitPlan[i - j].profit) {
-						maxProfitPlan[i].profit = maxProfitPlan[j].profit + maxProfitPlan[i - j].profit;
-						maxProfitPlan[i].firstMoves = maxProfitPlan[i - j].firstMoves;
-						for (int32 b = 0; b < myAgents.size(); b++) if ((j >> b) & 1) {
-							maxProfitPlan[i].firstMoves.setAt(b, maxProfitPlan[j].firstMoves.getAt(b));
-						}
-					}
-				}
+				maxProfitPlan = combinePlans(maxProfitCycle);
+				pinBest();
 			}
 
 			// 次の一手を登録
 			auto result = TurnInstruction(state, myColor);
-			auto planToExec = maxProfitPlan.back();
+			auto planToExec = maxProfitPlan.best(agentMaskCount - 1);
+			if (stage.warmStartOnly && planToExec.profit <= NegativeInf) return none;
 
 			for (int32 i = 0; i < myAgents.size(); i++) {
-				auto agentMove = ShortenMove::Decode(planToExec.firstMoves.getAt(i), myAgents[i]);
+				auto agentMove = ShortenMove::Decode(planToExec.key.getAt(i), myAgents[i]);
 				result.insert(agentMove);
 			}
 
-			Console << U"Turn #{} :"_fmt(state->getTurnIndex());
-			//maxProfitPlan.each_index([&](size_t i, SearchNode node) {
-			//	Console << U"   cand . i = {} , profit = {}"_fmt(i, node.profit);
-			//});
-			for (int32 i = 0; i < myAgents.size(); i++) {
-				auto agentMove = ShortenMove::Decode(planToExec.firstMoves.getAt(i), myAgents[i]);
-				if (agentMove.isStay()) Console << U"({}, {}) -> Stay"_fmt(myAgents[i].pos.r, myAgents[i].pos.c);
-				if (agentMove.isMove()) Console << U"({}, {}) -> Move {}"_fmt(myAgents[i].pos.r, myAgents[i].pos.c, agentMove.asMove().dir.value());
-				if (agentMove.isConstruct()) Console << U"({}, {}) -> Construct {}"_fmt(myAgents[i].pos.r, myAgents[i].pos.c, agentMove.asConstruct().dir.value());
-				if (agentMove.isDestroy()) Console << U"({}, {}) -> Destroy {}"_fmt(myAgents[i].pos.r, myAgents[i].pos.c, agentMove.asDestroy().dir.value());
+			// 次のターンのために、計画の経路を角の座標で残す
+			Array<Array<PlannedWall>> plan;
+			auto steps = ReconstructPlan((int32)myAgents.size(), constructWallPath.getNumberOfBases(), planToExec.key, wallPaths, wallPathMoves, wallPathsPositive);
+			if (steps) for (auto& part : *steps) {
+				Array<PlannedWall> group;
+				for (auto& step : part) {
+					auto& graph = step.positive ? diagGraphZero : diagGraph;
+					group.push_back(PlannedWall{ .agentIndex = step.agentIndex, .positive = step.positive, .from = graph->m_idToBasePos[step.from], .to = graph->m_idToBasePos[step.to] });
+				}
+				plan.push_back(std::move(group));
 			}
-			Console << U" ---- ---- ---- ----";
-
-			return result;
-
 
+			return StageResult{ .instruction = result, .profit = planToExec.profit, .plan = std::move(plan) };
 		}
 
 		String MainSolution2::name() { return U"戦略 アップデート"; }
@@ -1,5 +1,6 @@
 ﻿#include "../stdafx.h"
 #include "solver_list.hpp"
+#include "cancellation.hpp"
 
 namespace Procon34 {
 
@@ -8,12 +9,74 @@ namespace Procon34 {
 
 
 		class MainSolution2 : public SolverInterface {
+		public:
+
+			// safetyMarginInMiliseconds : ターンの制限時間のうち、最後のこれだけの時間は探索せずに残す
+			// maxTurnCount : 読むターン数の上限
+			// planCount : 壁の経路や職人の組ごとに残す計画の個数（最初の行動がぶつかったときの代わり）
+			// threadBudget : 共有のプールで同時に使うスレッドの数。 none ならすべて
+			MainSolution2(int32 safetyMarginInMiliseconds = 1000, int32 maxTurnCount = 16, int32 planCount = 2, Optional<uint32> threadBudget = none);
+
+			// 職人の集合の DP で、暫定解を超えない状態を飛ばすか（既定で飛ばす）。飛ばしても選ぶ計画は変わらない。
+			// 変わらないことを確かめるために切れるようにしてある（ Benchmark::MainSolution2Pruning ）
+			void setBranchAndBound(bool enabled) { m_branchAndBound = enabled; }
+
+		private:
 
 			// 盤面の状態から指示を作る
 			TurnInstruction operator()(BoxPtr<const GameState> state);
 
+			TurnInstruction solve(BoxPtr<const GameState> state, std::shared_ptr<const CancellationToken> cancellationToken);
+
+			// 段階を完了するたびに、その計画の最初の指示を onImprovement に渡す。
+			// どの段階も期限までに終わらなければ GreedyInstruction を返す
+			TurnInstruction solveAnytime(BoxPtr<const GameState> state, std::shared_ptr<const CancellationToken> cancellationToken, const ImprovementCallback& onImprovement);
+
 			String name();
 
+			// 探索の 1 段階ぶんの設定
+			struct SearchStage {
+				int32 turnCount; // 読むターン数
+				int32 differenceRadius; // WallPath2::EnabledDifferenceWithRadius に渡す値
+				bool warmStartOnly = false; // 前のターンの計画の壁の端点からだけ解き、職人の集合の DP はしない
+			};
+
+			// 計画に含まれる壁の経路 1 本。 base の番号はターンごとに変わるので、代表の角の座標で持つ
+			struct PlannedWall {
+				int32 agentIndex;
+				bool positive; // wallPathsPositive の経路か（でなければ閉路の一部）
+				Point from;
+				Point to;
+			};
+
+			struct StageResult {
+				TurnInstruction instruction;
+				int64 profit;
+				Array<Array<PlannedWall>> plan; // 閉路ごと、または単独の経路ごとの組
+			};
+
+			// 前の自分の手番に選んだ計画
+			struct WarmStart {
+				int32 turnIndex;
+				PlayerColor color;
+				size_t agentCount;
+				SearchStage stage;
+				Array<Array<PlannedWall>> plan;
+			};
+
+			// 打ち切られたら none を返す。 cancellationToken が nullptr なら打ち切らない。
+			// warmStart があれば、その閉路を今の盤面で評価し直して最初から候補に入れる（暫定解が上がり、 DP の枝刈りが効く）
+			Optional<StageResult> solveStage(BoxPtr<const GameState> state, SearchStage stage, std::shared_ptr<const CancellationToken> cancellationToken, const WarmStart* warmStart = nullptr);
+
+			int32 m_safetyMarginInMiliseconds;
+			int32 m_maxTurnCount;
+			int32 m_planCount;
+			Optional<uint32> m_threadBudget;
+			bool m_branchAndBound = true;
+
+			Optional<WarmStart> m_warmStart;
+			Optional<int64> m_firstStageMilliseconds; // 前のターンに、前の計画を使わない最初の段階にかかった時間（打ち切られたならそれまでの時間）
+
 		};
 
 	}
@@ -0,0 +1,301 @@
+﻿#include "../stdafx.h"
+#include "solver_mcts.hpp"
+#include "shorten_move.hpp"
+#include "thread_pool.hpp"
+#include "solver_executor.hpp"
+#include "cancellation.hpp"
+#include "profiler.hpp"
+
+namespace Procon34 {
+
+
+	namespace Solvers {
+
+
+		namespace {
+
+			// プレイアウト方策の重み。壁を建てる手を優先する
+			constexpr int32 StayWeight = 1;
+			constexpr int32 MoveWeight = 2;
+			constexpr int32 ConstructWeight = 6;
+			constexpr int32 DestroyWeight = 3;
+
+			int32 PlayoutWeightOf(ShortenMove::Type move) {
+				switch (move >> 3) {
+				case 0:
+					return StayWeight;
+				case 1:
+					return MoveWeight;
+				case 2:
+					return ConstructWeight;
+				default:
+					return DestroyWeight;
+				}
+			}
+
+			// 職人 1 人の行動を、壁の建築に寄せてランダムに選ぶ（候補は ShortenMove::EnumerateValid ）
+			ShortenMove::Type SamplePlayoutMove(const GameBoard& board, Agent agent, SmallRNG& rng) {
+				std::array<ShortenMove::Type, ShortenMove::MaxValidCount> candidates;
+				std::array<int32, ShortenMove::MaxValidCount> weights;
+				int32 candidateCount = ShortenMove::EnumerateValid(board, agent, candidates);
+				int32 weightSum = 0;
+				for (int32 i = 0; i < candidateCount; i++) {
+					weights[i] = PlayoutWeightOf(candidates[i]);
+					weightSum += weights[i];
+				}
+
+				int32 r = UniformIntDistribution<int32>(0, weightSum - 1)(rng);
+				for (int32 i = 0; i < candidateCount; i++) {
+					if (r < weights[i]) return candidates[i];
+					r -= weights[i];
+				}
+				return ShortenMove::Stay();
+			}
+
+			// 手番のプレイヤーの全員分の行動を選ぶ
+			ShortenMoveSet SampleJointMove(const GameState& state, SmallRNG& rng) {
+				auto board = state.getBoard();
+				auto agents = state.getAgents(state.whosTurn());
+				ShortenMoveSet res;
+				for (int32 i = 0; i < (int32)agents.size(); i++) {
+					res.setAt(i, SamplePlayoutMove(*board, agents[i], rng));
+				}
+				return res;
+			}
+
+			// 手番のプレイヤーとして moves を実行する
+			void ApplyJointMove(const BoxPtr<GameState>& state, ShortenMoveSet moves) {
+				auto color = state->whosTurn();
+				auto agents = state->getAgents(color);
+				TurnInstruction inst(state, color);
+				for (int32 i = 0; i < (int32)agents.size(); i++) {
+					inst.insert(ShortenMove::Decode(moves.getAt(i), agents[i]));
+				}
+				state->makeMove(color, inst);
+			}
+
+			// 根の子 1 つぶんの集計
+			struct RootChildStat {
+				ShortenMoveSet moves;
+				int64 visits;
+				double valueSum;
+			};
+
+			// 1 スレッドぶんの探索木
+			class SearchTree {
+			public:
+
+				SearchTree(BoxPtr<const GameState> root, int32 rolloutTurnCount, uint64 seed)
+					: m_root(root)
+					, m_myColor(root->whosTurn())
+					, m_rolloutTurnCount(rolloutTurnCount)
+					, m_rng(seed)
+				{
+					m_nodes.push_back(Node{});
+				}
+
+				// 打ち切られるまで反復する
+				void run(const CancellationToken& cancellationToken) {
+					while (!cancellationToken.isCancelled()) iterate();
+				}
+
+				int64 iterationCount() const { return m_iterationCount; }
+
+				Array<RootChildStat> rootChildren() const {
+					Array<RootChildStat> res;
+					for (auto& child : m_nodes[0].children) {
+						auto& node = m_nodes[child.nodeIndex];
+						res.push_back(RootChildStat{ .moves = child.moves, .visits = node.visits, .valueSum = node.valueSum });
+					}
+					return res;
+				}
+
+			private:
+
+				// 漸進的拡張 (progressive widening) の係数。子の数は WideningCoeff * visits^WideningExponent まで
+				static constexpr double WideningCoeff = 2.0;
+				static constexpr double WideningExponent = 0.5;
+				static constexpr double ExplorationCoeff = 0.7;
+
+				struct Edge {
+					ShortenMoveSet moves;
+					int32 nodeIndex;
+				};
+
+				struct Node {
+					int64 visits = 0;
+					double valueSum = 0.0;
+					Array<Edge> children;
+				};
+
+				BoxPtr<const GameState> m_root;
+				PlayerColor m_myColor;
+				int32 m_rolloutTurnCount;
+				SmallRNG m_rng;
+				Array<Node> m_nodes; // m_nodes[0] が根
+				int64 m_iterationCount = 0;
+
+				// 評価値（点差）の観測範囲。 UCB の正規化に使う
+				double m_minValue = 0.0;
+				double m_maxValue = 0.0;
+
+				// 開ループなので、毎回根から手を再生する
+				void iterate() {
+					auto state = m_root->clone();
+					Array<int32> path = { 0 };
+					int32 nodeIndex = 0;
+
+					while (!state->isOver()) {
+						bool expanded = false;
+						int32 childIndex = selectOrExpand(nodeIndex, *state, expanded);
+						ApplyJointMove(state, m_nodes[nodeIndex].children[childIndex].moves);
+						if (!state->isOver()) ApplyJointMove(state, SampleJointMove(*state, m_rng));
+						nodeIndex = m_nodes[nodeIndex].children[childIndex].nodeIndex;
+						path.push_back(nodeIndex);
+						if (expanded) break;
+					}
+
+					// プレイアウト
+					for (int32 t = 0; t < m_rolloutTurnCount * 2 && !state->isOver(); t++) {
+						ApplyJointMove(state, SampleJointMove(*state, m_rng));
+					}
+
+					double value = (double)(state->getScore(m_myColor) - state->getScore(GameState::OpponentOf(m_myColor)));
+					if (m_iterationCount == 0) {
+						m_minValue = m_maxValue = value;
+					}
+					m_minValue = Min(m_minValue, value);
+					m_maxValue = Max(m_maxValue, value);
+
+					for (int32 idx : path) {
+						m_nodes[idx].visits++;
+						m_nodes[idx].valueSum += value;
+					}
+					m_iterationCount++;
+				}
+
+				// 子を 1 つ選ぶ。新しく子を作ったなら expanded を true にする
+				int32 selectOrExpand(int32 nodeIndex, const GameState& state, bool& expanded) {
+					size_t allowedChildren = 1 + (size_t)(WideningCoeff * std::pow((double)m_nodes[nodeIndex].visits, WideningExponent));
+
+					if (m_nodes[nodeIndex].children.size() < allowedChildren) {
+						auto moves = SampleJointMove(state, m_rng);
+						auto& children = m_nodes[nodeIndex].children;
+						for (int32 i = 0; i < (int32)children.size(); i++) {
+							if (children[i].moves.asInteger() == moves.asInteger()) return i;
+						}
+						int32 newIndex = (int32)m_nodes.size();
+						m_nodes.push_back(Node{}); // ここで参照が無効になるので children は取り直す
+						m_nodes[nodeIndex].children.push_back(Edge{ .moves = moves, .nodeIndex = newIndex });
+						expanded = true;
+						return (int32)m_nodes[nodeIndex].children.size() - 1;
+					}
+
+					// UCB1 で選ぶ
+					const auto& node = m_nodes[nodeIndex];
+					double range = m_maxValue - m_minValue;
+					double logVisits = std::log((double)Max<int64>(node.visits, 1));
+					int32 best = 0;
+					double bestScore = -1e300;
+					for (int32 i = 0; i < (int32)node.children.size(); i++) {
+						const auto& child = m_nodes[node.children[i].nodeIndex];
+						if (child.visits == 0) return i;
+						double mean = child.valueSum / child.visits;
+						double normalized = (range > 0.0) ? (mean - m_minValue) / range : 0.5;
+						double score = normalized + ExplorationCoeff * std::sqrt(logVisits / child.visits);
+						if (bestScore < score) {
+							bestScore = score;
+							best = i;
+						}
+					}
+					return best;
+				}
+
+			};
+
+		}
+
+
+		MonteCarloTreeSearch::MonteCarloTreeSearch(int32 safetyMarginInMiliseconds, int32 rolloutTurnCount, Optional<uint32> threadCount)
+			: m_safetyMarginInMiliseconds(safetyMarginInMiliseconds)
+			, m_rolloutTurnCount(rolloutTurnCount)
+			, m_threadCount(threadCount)
+			, m_seed(RandomUint64())
+		{
+		}
+
+		// 盤面の状態から指示を作る
+		TurnInstruction MonteCarloTreeSearch::operator()(BoxPtr<const GameState> state) {
+			return solve(state, nullptr);
+		}
+
+		TurnInstruction MonteCarloTreeSearch::solve(BoxPtr<const GameState> state, std::shared_ptr<const CancellationToken> parentToken) {
+			auto myColor = state->whosTurn();
+			auto myAgents = state->getAgents(myColor);
+			auto result = TurnInstruction(state, myColor);
+			if (state->isOver()) return result;
+
+			int32 timeLimit = state->getInitialState()->turnTimeLimitInMiliseconds - m_safetyMarginInMiliseconds;
+			auto cancellationToken = CancellationToken::WithTimeLimit(std::chrono::milliseconds(Max(0, timeLimit)), parentToken);
+
+			// 木は期限まで探索し続けるので、同時に動けるスレッドの数だけ作る
+			auto threadPool = SolverExecutor::Budget(m_threadCount);
+			uint32 threadCount = threadPool->threadCount();
+
+			Array<std::unique_ptr<SearchTree>> trees(threadCount);
+			for (uint32 i = 0; i < threadCount; i++) {
+				trees[i] = std::make_unique<SearchTree>(state, m_rolloutTurnCount, m_seed + (uint64)state->getTurnIndex() * threadCount + i);
+			}
+
+			{
+				PROCON34_PROFILE_SCOPE("MonteCarloTreeSearch::search");
+				for (uint32 i = 0; i < threadCount; i++) {
+					threadPool->pushTask([&, i](uint32) { trees[i]->run(*cancellationToken); });
+				}
+				threadPool->sync();
+			}
+
+			// 各スレッドの根の子を、行動ごとに合計する
+			Array<RootChildStat> merged;
+			int64 iterationCount = 0;
+			for (auto& tree : trees) {
+				iterationCount += tree->iterationCount();
+				for (auto& stat : tree->rootChildren()) {
+					auto it = std::find_if(merged.begin(), merged.end(), [&](const RootChildStat& x) { return x.moves.asInteger() == stat.moves.asInteger(); });
+					if (it == merged.end()) {
+						merged.push_back(stat);
+					}
+					else {
+						it->visits += stat.visits;
+						it->valueSum += stat.valueSum;
+					}
+				}
+			}
+
+			// 訪問回数が最大の手を選ぶ
+			Optional<RootChildStat> best;
+			for (auto& stat : merged) {
+				if (stat.visits == 0) continue;
+				if (!best.has_value()
+					|| best->visits < stat.visits
+					|| (best->visits == stat.visits && best->valueSum / best->visits < stat.valueSum / stat.visits)) {
+					best = stat;
+				}
+			}
+
+			if (best.has_value()) {
+				for (int32 i = 0; i < (int32)myAgents.size(); i++) {
+					result.insert(ShortenMove::Decode(best->moves.getAt(i), myAgents[i]));
+				}
+				Console << U"MCTS Turn #{} : iterations = {} , visits = {} , mean = {:.1f}"_fmt(state->getTurnIndex(), iterationCount, best->visits, best->valueSum / best->visits);
+			}
+
+			return result;
+		}
+
+		String MonteCarloTreeSearch::name() { return U"モンテカルロ木探索"; }
+
+	}
+
+
+} // namespace Procon34
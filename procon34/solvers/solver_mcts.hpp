@@ -0,0 +1,41 @@
+﻿#pragma once
+#include "../stdafx.h"
+#include "solver_list.hpp"
+
+namespace Procon34 {
+
+
+	namespace Solvers {
+
+
+		// モンテカルロ木探索。
+		// 木には自分の手番だけを持ち、相手の手はプレイアウトと同じ方策でその都度選ぶ（開ループ）。
+		// スレッドごとに独立した木を作り、最後に根の子の訪問回数を合計する（ルート並列化）。
+		class MonteCarloTreeSearch : public SolverInterface {
+		public:
+
+			// safetyMarginInMiliseconds : ターンの制限時間のうち、最後のこれだけの時間は探索せずに残す
+			// rolloutTurnCount : 木を抜けた後にプレイアウトする自分の手番の数
+			// threadCount : 木の数（共有のプールで同時に使うスレッドの数）。 none なら共有のプールのスレッド数
+			MonteCarloTreeSearch(int32 safetyMarginInMiliseconds = 1000, int32 rolloutTurnCount = 8, Optional<uint32> threadCount = none);
+
+		private:
+
+			// 盤面の状態から指示を作る
+			TurnInstruction operator()(BoxPtr<const GameState> state);
+
+			TurnInstruction solve(BoxPtr<const GameState> state, std::shared_ptr<const CancellationToken> cancellationToken);
+
+			String name();
+
+			int32 m_safetyMarginInMiliseconds;
+			int32 m_rolloutTurnCount;
+			Optional<uint32> m_threadCount;
+			uint64 m_seed;
+
+		};
+
+	}
+
+
+} // namespace Procon34
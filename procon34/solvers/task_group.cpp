@@ -0,0 +1,72 @@
+﻿#include "task_group.hpp"
+
+namespace Procon34 {
+
+	TaskGroup::TaskGroup(ThreadPool& pool, std::shared_ptr<const CancellationToken> parentToken)
+		: m_pool(pool)
+		, m_cancellationToken(CancellationToken::ChildOf(std::move(parentToken)))
+	{
+	}
+
+	TaskGroup::~TaskGroup() {
+		try {
+			wait();
+		}
+		catch (...) {
+		}
+	}
+
+	void TaskGroup::wait() {
+		while (m_unreleased.load(std::memory_order_acquire) != 0) {
+			uint32 current = m_remaining.load(std::memory_order_acquire);
+			if (current == 0) {
+				// 最後のタスクが m_remaining を 0 にしてから m_unreleased を減らすまでの短い間
+				std::this_thread::yield();
+			}
+			else if (!m_pool.runPendingTask()) {
+				// プールのスレッドは眠らない（ ThreadPool::parallelFor と同じ）
+				if (m_pool.isWorkerThread()) std::this_thread::yield();
+				else m_remaining.wait(current, std::memory_order_acquire);
+			}
+		}
+
+		std::exception_ptr exception;
+		{
+			std::lock_guard lock(m_exceptionMutex);
+			exception = std::exchange(m_exception, nullptr);
+		}
+		if (exception) std::rethrow_exception(exception);
+	}
+
+	void TaskGroup::cancel() {
+		m_cancellationToken->cancel();
+	}
+
+	bool TaskGroup::isCancelled() const {
+		return m_cancellationToken->isCancelled();
+	}
+
+	const std::shared_ptr<CancellationToken>& TaskGroup::cancellationToken() const {
+		return m_cancellationToken;
+	}
+
+	ThreadPool& TaskGroup::pool() const {
+		return m_pool;
+	}
+
+	void TaskGroup::finishTask() {
+		if (m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) m_remaining.notify_all();
+		// これ以降 this に触れてはいけない
+		m_unreleased.fetch_sub(1, std::memory_order_release);
+	}
+
+	void TaskGroup::storeException(std::exception_ptr exception) {
+		{
+			std::lock_guard lock(m_exceptionMutex);
+			if (!m_exception) m_exception = exception;
+		}
+		// 残りのタスクは実行しない
+		cancel();
+	}
+
+}
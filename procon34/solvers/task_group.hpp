@@ -0,0 +1,159 @@
+﻿#pragma once
+#include "../stdafx.h"
+#include "thread_pool.hpp"
+#include "cancellation.hpp"
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+namespace Procon34 {
+
+	class TaskGroup;
+
+	// TaskGroup::async の結果を受け取る
+	template<class T>
+	class TaskFuture {
+	public:
+
+		static_assert(!std::is_void_v<T>, "TaskFuture<void> is not supported. use TaskGroup::run");
+
+		TaskFuture() = default;
+
+		bool valid() const { return (bool)m_state; }
+
+		// 結果が出ていれば true
+		bool isReady() const { return m_state->ready.load(std::memory_order_acquire) != 0; }
+
+		// 結果が出るまで待って返す。タスクが例外を投げていたり、打ち切られて実行されなかったりしたら、ここで投げる
+		T& get() {
+			if (!m_state) throw Error(U"error at TaskFuture::get : no state");
+			while (m_state->ready.load(std::memory_order_acquire) == 0) {
+				if (m_pool->runPendingTask()) continue;
+				if (m_pool->isWorkerThread()) std::this_thread::yield();
+				else m_state->ready.wait(0, std::memory_order_acquire);
+			}
+			if (m_state->exception) std::rethrow_exception(m_state->exception);
+			return *m_state->value;
+		}
+
+	private:
+
+		friend class TaskGroup;
+
+		struct State {
+			std::atomic<uint32> ready = 0;
+			Optional<T> value;
+			std::exception_ptr exception;
+
+			void finish() {
+				ready.store(1, std::memory_order_release);
+				ready.notify_all();
+			}
+		};
+
+		ThreadPool* m_pool = nullptr;
+		std::shared_ptr<State> m_state; // タスクと共有するので、待つ側が先に破棄しても問題ない
+	};
+
+	// ThreadPool に入れたタスクのうち、ひとまとまりの終わりだけを待つためのもの。
+	//
+	// wait はこのグループのタスクだけを待つので、タスクの中で入れ子に TaskGroup を作って待ってもよい。
+	// プールのスレッドで待つときは、待つ間ほかのタスクを進める。
+	// グループは親のトークンの子となるトークンを持ち、打ち切られた後に始まるタスクは中身を実行しない。
+	class TaskGroup {
+	public:
+
+		// parentToken が打ち切られると、このグループも打ち切られる
+		TaskGroup(ThreadPool& pool, std::shared_ptr<const CancellationToken> parentToken = nullptr);
+
+		TaskGroup(TaskGroup&&) = delete;
+		TaskGroup(const TaskGroup&) = delete;
+
+		// 終わっていないタスクがあれば待つ。例外は捨てる
+		~TaskGroup();
+
+		// f() （または f(threadIndex) ）を実行するタスクを追加する。
+		// タスクの中から呼んでもよい。
+		template<class F>
+		void run(F&& f) {
+			spawn([this, fn = std::forward<F>(f)](uint32 threadIndex) mutable {
+				if (isCancelled()) return;
+				if constexpr (std::is_invocable_v<decltype(fn)&, uint32>) fn(threadIndex);
+				else fn();
+			});
+		}
+
+		// f() の戻り値を TaskFuture で受け取る。
+		// 例外や打ち切りは TaskFuture::get に伝わり、 wait では投げない
+		template<class F>
+		auto async(F&& f) {
+			using T = std::decay_t<std::invoke_result_t<std::decay_t<F>&>>;
+			TaskFuture<T> future;
+			future.m_pool = &m_pool;
+			future.m_state = std::make_shared<typename TaskFuture<T>::State>();
+			// 打ち切られていても実行し、 get が待ち続けないようにする
+			spawn([state = future.m_state, fn = std::forward<F>(f), token = m_cancellationToken](uint32) mutable {
+				try {
+					if (token->isCancelled()) throw Error(U"error at TaskGroup::async : cancelled");
+					state->value = fn();
+				}
+				catch (...) {
+					state->exception = std::current_exception();
+				}
+				state->finish();
+			});
+			return future;
+		}
+
+		// このグループのタスクがすべて終わるまで待つ。
+		// タスクが例外を投げていたら、最初のものをここで投げ直す（グループは打ち切られている）
+		void wait();
+
+		// まだ始まっていないタスクを実行しないようにする。
+		// 実行中のタスクには cancellationToken() を通して伝わる
+		void cancel();
+
+		bool isCancelled() const;
+
+		// タスクの中で打ち切りを調べたり、入れ子の TaskGroup や探索部品に渡したりするためのトークン
+		const std::shared_ptr<CancellationToken>& cancellationToken() const;
+
+		ThreadPool& pool() const;
+
+	private:
+
+		ThreadPool& m_pool;
+		std::shared_ptr<CancellationToken> m_cancellationToken;
+
+		// m_remaining はタスクの中身が終わったときに、 m_unreleased はそのあと this に触れなくなったときに減らす。
+		// wait は m_unreleased が 0 になるまで戻らないので、タスクが破棄済みのグループに触れることはない
+		std::atomic<uint32> m_remaining = 0;
+		std::atomic<uint32> m_unreleased = 0;
+
+		std::mutex m_exceptionMutex;
+		std::exception_ptr m_exception;
+
+		// f(threadIndex) を実行するタスクを追加する。打ち切られていても実行する
+		template<class F>
+		void spawn(F&& f) {
+			m_remaining.fetch_add(1, std::memory_order_relaxed);
+			m_unreleased.fetch_add(1, std::memory_order_relaxed);
+			m_pool.pushTask([this, fn = std::forward<F>(f)](uint32 threadIndex) mutable {
+				try {
+					fn(threadIndex);
+				}
+				catch (...) {
+					storeException(std::current_exception());
+				}
+				finishTask();
+			});
+		}
+
+		void finishTask();
+
+		void storeException(std::exception_ptr exception);
+	};
+
+}
@@ -1,14 +1,25 @@
-﻿
-// copied https://github.com/NachiaVivias/procon2022-omuct/blob/main/procon2022-omuct/solver/thread_pool.cpp
+﻿// 最初の版は https://github.com/NachiaVivias/procon2022-omuct/blob/main/procon2022-omuct/solver/thread_pool.cpp からコピーした
+//
+// スレッドごとの両端キュー（ Chase-Lev ）と、外から入れるための共有のキュー（ Vyukov の有界 MPMC キュー）を持つ。
+// 仕事がないスレッドは、自分のキュー → 共有のキュー → ほかのスレッドのキュー の順に探し、
+// しばらく見つからなければ std::atomic::wait で眠る（ futex / WaitOnAddress ）。
+//
+// LimitedThreadPool は別のプールの上に作る見かけのプールで、同時に使うスレッドの数だけを制限する。
 
 #include "thread_pool.hpp"
+#include "profiler.hpp"
 
+#include <bit>
 #include <deque>
 #include <mutex>
 #include <thread>
-#include <future>
-#include <condition_variable>
-#include <chrono>
+
+#if SIV3D_PLATFORM(WINDOWS)
+#include <Siv3D/Windows/Windows.hpp>
+#elif SIV3D_PLATFORM(LINUX)
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 
 namespace Procon34 {
@@ -17,216 +28,453 @@ namespace Procon34 {
 	namespace {
 
 
-		class ThreadPoolImpl;
+		// 偽共有を避けるための間隔
+		constexpr size_t CacheLineSize = 64;
 
 
-		class ThreadPoolWorker {
+		// 持ち主のスレッドだけが push / pop し、ほかのスレッドは steal する両端キュー。
+		// 大きさは固定で、いっぱいなら push は false を返す。
+		class WorkStealingDeque {
 		public:
 
-			ThreadPoolWorker(ThreadPoolImpl* parent, uint32 index);
+			static constexpr int64 Capacity = 1024;
 
-			~ThreadPoolWorker();
+			WorkStealingDeque() : m_slots(Capacity) {}
 
-			// その時点で持っているタスクは完了するが、新しいタスクは受け取らない
-			void terminate();
+			// 持ち主のみ
+			bool push(const ThreadTaskSlot& task) {
+				int64 bottom = m_bottom.load(std::memory_order_relaxed);
+				int64 top = m_top.load(std::memory_order_acquire);
+				if (bottom - top >= Capacity) return false;
+				m_slots[bottom & (Capacity - 1)] = task;
+				m_bottom.store(bottom + 1, std::memory_order_release);
+				return true;
+			}
 
-			void notifyAll();
+			// 持ち主のみ。最後に入れたものから取り出す
+			bool pop(ThreadTaskSlot& out) {
+				int64 bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+				m_bottom.store(bottom, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				int64 top = m_top.load(std::memory_order_relaxed);
+				if (top > bottom) {
+					m_bottom.store(bottom + 1, std::memory_order_relaxed);
+					return false;
+				}
+				out = m_slots[bottom & (Capacity - 1)];
+				if (top == bottom) {
+					// 最後の 1 つは steal と取り合う
+					bool won = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+					m_bottom.store(bottom + 1, std::memory_order_relaxed);
+					return won;
+				}
+				return true;
+			}
 
-			// その時点で持っているタスクは完了して同期し、その後新しいタスクを受け取る
-			void sync();
+			// 誰でも。最初に入れたものから取り出す
+			bool steal(ThreadTaskSlot& out) {
+				int64 top = m_top.load(std::memory_order_acquire);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				int64 bottom = m_bottom.load(std::memory_order_acquire);
+				if (top >= bottom) return false;
+				// 取り合いに負けたときは、読んだ内容ごと捨てる
+				out = m_slots[top & (Capacity - 1)];
+				return m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			}
 
 		private:
-			ThreadPoolImpl* const m_parent;
-			bool m_hasTask; // タスク実行中かどうか
-			bool m_terminationRequested; // スレッド終了の条件
-			std::mutex m_thisMutex; // m_index 以外のメンバを保護
-			const uint32 m_index;
+			alignas(CacheLineSize) std::atomic<int64> m_top = 0;
+			alignas(CacheLineSize) std::atomic<int64> m_bottom = 0;
+			Array<ThreadTaskSlot> m_slots;
+		};
+
 
-			// - キューにタスクが追加されたとき
-			// - 終了命令時
-			// - タスク完了時
-			std::condition_variable m_condition;
+		// 複数のスレッドから入れて、複数のスレッドから取り出せる有界キュー（ロックなし）
+		class InjectionQueue {
+		public:
 
-			std::thread m_thread;
+			static constexpr size_t Capacity = 4096;
 
-			void threadTask(); // std::thread で実行されるメソッド
+			InjectionQueue() : m_cells(new Cell[Capacity]) {
+				for (size_t i = 0; i < Capacity; i++) m_cells[i].sequence.store(i, std::memory_order_relaxed);
+			}
+
+			// いっぱいなら false
+			bool tryPush(const ThreadTaskSlot& task) {
+				size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+				while (true) {
+					Cell& cell = m_cells[pos & (Capacity - 1)];
+					size_t sequence = cell.sequence.load(std::memory_order_acquire);
+					intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+					if (diff == 0) {
+						if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+							cell.task = task;
+							cell.sequence.store(pos + 1, std::memory_order_release);
+							return true;
+						}
+					}
+					else if (diff < 0) {
+						return false;
+					}
+					else {
+						pos = m_enqueuePos.load(std::memory_order_relaxed);
+					}
+				}
+			}
+
+			// 空なら false
+			bool tryPop(ThreadTaskSlot& out) {
+				size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+				while (true) {
+					Cell& cell = m_cells[pos & (Capacity - 1)];
+					size_t sequence = cell.sequence.load(std::memory_order_acquire);
+					intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+					if (diff == 0) {
+						if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+							out = cell.task;
+							cell.sequence.store(pos + Capacity, std::memory_order_release);
+							return true;
+						}
+					}
+					else if (diff < 0) {
+						return false;
+					}
+					else {
+						pos = m_dequeuePos.load(std::memory_order_relaxed);
+					}
+				}
+			}
+
+		private:
+			struct Cell {
+				std::atomic<size_t> sequence;
+				ThreadTaskSlot task;
+			};
+
+			std::unique_ptr<Cell[]> m_cells;
+			alignas(CacheLineSize) std::atomic<size_t> m_enqueuePos = 0;
+			alignas(CacheLineSize) std::atomic<size_t> m_dequeuePos = 0;
 		};
 
 
-		const bool QUEUE_TASK_AFTER_TERMINATION = true;
+		// スレッドを論理プロセッサ processor に固定する。できない環境では何もしない
+		void PinToProcessor(std::thread& thread, uint32 processor) {
+#if SIV3D_PLATFORM(WINDOWS)
+			::SetThreadAffinityMask(thread.native_handle(), (DWORD_PTR)1 << (processor % 64));
+#elif SIV3D_PLATFORM(LINUX)
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(processor % CPU_SETSIZE, &set);
+			pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+			(void)thread;
+			(void)processor;
+#endif
+		}
+
+
+		class ThreadPoolImpl;
+		class LimitedThreadPool;
+
+		// 今のスレッドがどのプールの何番目のスレッドか
+		thread_local ThreadPoolImpl* t_currentPool = nullptr;
+		thread_local uint32 t_threadIndex = 0;
+
+		// 今のスレッドが LimitedThreadPool のどの枠でタスクを実行しているか
+		thread_local LimitedThreadPool* t_currentLimitedPool = nullptr;
+		thread_local uint32 t_limitedSlot = 0;
 
 
 		class ThreadPoolImpl : public ThreadPool {
 		public:
 
-			ThreadPoolImpl(uint32 threadCount);
+			ThreadPoolImpl(uint32 threadCount, bool pinThreads);
 
 			ThreadPoolImpl(ThreadPoolImpl&&) = delete;
 			ThreadPoolImpl(const ThreadPoolImpl&) = delete;
 			~ThreadPoolImpl();
 
-			// タスクをキューに追加する
-			void pushTask(Task&& task);
+			void pushTask(Task&& task) override;
+
+			void sync() override;
 
-			// 少なくとも今キューにあるタスクをすべて完了するか、終了信号まで待つ
-			void sync();
+			uint32 threadCount() const override { return (uint32)m_workers.size(); }
 
-			// キューにタスクがあれば 1 つ取り出す
-			Optional<Task> pullTask();
+			bool isWorkerThread() const override { return t_currentPool == this; }
 
-			// それぞれのスレッドは、その時点で持っているタスクは完了するが、新しいタスクは受け取らない
-			void terminate();
+			bool runPendingTask() override;
 
 		private:
 
-			std::deque<Task> m_taskQueue;
-			bool m_terminationRequested; // スレッド終了の条件
+			// 眠る前に探し直す回数
+			static constexpr int32 SpinCount = 32;
 
-			std::mutex m_thisMutex; // m_workers 以外のメンバを保護
-			std::condition_variable m_condition;
+			struct alignas(CacheLineSize) Worker {
+				WorkStealingDeque deque;
+				std::thread thread;
+			};
 
-			Array<std::unique_ptr<ThreadPoolWorker>> m_workers;
+			Array<std::unique_ptr<Worker>> m_workers;
+			InjectionQueue m_injection;
 
-		};
+			alignas(CacheLineSize) std::atomic<int64> m_pendingCount = 0; // 追加されてまだ終わっていないタスクの数
+			alignas(CacheLineSize) std::atomic<uint32> m_wakeEpoch = 0; // 眠っているスレッドを起こすたびに増やす
+			alignas(CacheLineSize) std::atomic<int32> m_sleepingCount = 0;
+			std::atomic<bool> m_stopping = false;
 
+			void workerLoop(uint32 index);
 
+			// 自分のキュー → 共有のキュー → ほかのスレッドのキュー の順に探す
+			bool findTask(uint32 index, ThreadTaskSlot& out);
 
-		ThreadPoolWorker::ThreadPoolWorker(ThreadPoolImpl* parent, uint32 index) :
-			m_parent(parent),
-			m_hasTask(false),
-			m_terminationRequested(false),
-			m_index(index),
-			m_thread([&]() -> void { threadTask(); })
-		{
-			m_condition.notify_all();
+			void runTask(uint32 index, ThreadTaskSlot& task);
+
+			// 眠っているスレッドがいれば 1 つ起こす
+			void wakeOne();
+		};
+
+
+		ThreadPoolImpl::ThreadPoolImpl(uint32 threadCount, bool pinThreads) {
+			threadCount = Max<uint32>(threadCount, 1);
+			m_workers.resize(threadCount);
+			for (uint32 index = 0; index < threadCount; index++) m_workers[index] = std::make_unique<Worker>();
+			// キューがすべてできてからスレッドを開始
+			uint32 processorCount = HardwareConcurrency().value_or(threadCount);
+			for (uint32 index = 0; index < threadCount; index++) {
+				m_workers[index]->thread = std::thread([this, index]() -> void { workerLoop(index); });
+				if (pinThreads) PinToProcessor(m_workers[index]->thread, index % processorCount);
+			}
 		}
 
-		ThreadPoolWorker::~ThreadPoolWorker() {
-			terminate();
-			if (m_thread.joinable()) m_thread.join();
+		ThreadPoolImpl::~ThreadPoolImpl() {
+			sync();
+			m_stopping.store(true, std::memory_order_seq_cst);
+			m_wakeEpoch.fetch_add(1, std::memory_order_seq_cst);
+			m_wakeEpoch.notify_all();
+			for (auto& worker : m_workers) {
+				if (worker->thread.joinable()) worker->thread.join();
+			}
 		}
 
-		void ThreadPoolWorker::threadTask() {
+		void ThreadPoolImpl::pushTask(ThreadPool::Task&& task) {
+			if (!task) return;
+			m_pendingCount.fetch_add(1, std::memory_order_relaxed);
+			auto slot = task.release();
+
+			bool pushed = false;
+			if (t_currentPool == this) {
+				// どちらのキューもいっぱいなら、自分で 1 つ実行して空ける（ほかのスレッドを待つと、スレッドが 1 つのとき止まる）
+				while (!pushed) {
+					pushed = m_workers[t_threadIndex]->deque.push(slot) || m_injection.tryPush(slot);
+					if (!pushed && !runPendingTask()) std::this_thread::yield();
+				}
+			}
+			while (!pushed) {
+				pushed = m_injection.tryPush(slot);
+				if (!pushed) std::this_thread::yield();
+			}
 
-			while (true) {
-				Optional<ThreadPool::Task> task = m_parent->pullTask();
+			wakeOne();
+		}
 
-				/* 終了命令を受けて終了するか、タスクを獲得するまで待機 */
-				if (!task.has_value()) {
+		void ThreadPoolImpl::sync() {
+			while (true) {
+				int64 current = m_pendingCount.load(std::memory_order_acquire);
+				if (current == 0) break;
+				m_pendingCount.wait(current, std::memory_order_acquire);
+			}
+		}
 
-					{
-						std::unique_lock lock(m_thisMutex);
-						m_hasTask = false;
-					}
+		bool ThreadPoolImpl::runPendingTask() {
+			if (t_currentPool != this) return false;
+			ThreadTaskSlot task;
+			if (!findTask(t_threadIndex, task)) return false;
+			runTask(t_threadIndex, task);
+			return true;
+		}
 
-					m_condition.notify_all();
-					std::unique_lock lock(m_thisMutex);
-					m_condition.wait(
-						lock,
-						[&]() -> bool {
-							task = m_parent->pullTask();
-							if (m_terminationRequested) return true;
-							return task.has_value();
-						}
-					);
+		void ThreadPoolImpl::workerLoop(uint32 index) {
+			t_currentPool = this;
+			t_threadIndex = index;
 
-					// 終了命令が来たらすぐに終了
-					if (m_terminationRequested) {
-						break;
-					}
+			ThreadTaskSlot task;
+			while (true) {
+				bool found = findTask(index, task);
+				for (int32 spin = 0; spin < SpinCount && !found; spin++) {
+					std::this_thread::yield();
+					found = findTask(index, task);
+				}
 
-					m_hasTask = true;
+				if (!found) {
+					// 眠る。先に m_sleepingCount を増やしてから探し直すので、 pushTask の起こし忘れは起きない
+					m_sleepingCount.fetch_add(1, std::memory_order_seq_cst);
+					uint32 epoch = m_wakeEpoch.load(std::memory_order_seq_cst);
+					found = findTask(index, task);
+					if (!found && !m_stopping.load(std::memory_order_seq_cst)) m_wakeEpoch.wait(epoch, std::memory_order_seq_cst);
+					m_sleepingCount.fetch_sub(1, std::memory_order_relaxed);
 				}
-				// タスク開始
-				task.value()(m_index);
-			}
 
+				if (found) runTask(index, task);
+				else if (m_stopping.load(std::memory_order_seq_cst)) break;
+			}
 		}
 
-		void ThreadPoolWorker::sync() {
-			// 終了命令かタスク消化まで待つ
-			bool result;
-			do {
-				m_condition.notify_all();
-				std::unique_lock lock(m_thisMutex);
-				auto pred = [&]() -> bool { return this->m_terminationRequested || !this->m_hasTask; };
-				result = m_condition.wait_for(lock, std::chrono::seconds(3), pred);
-			} while (!result);
-			//auto pred = [&]() -> bool { return this->m_terminationRequested || !this->m_hasTask; };
-			//m_condition.wait(lock, pred);
+		bool ThreadPoolImpl::findTask(uint32 index, ThreadTaskSlot& out) {
+			if (m_workers[index]->deque.pop(out)) return true;
+			if (m_injection.tryPop(out)) return true;
+			uint32 workerCount = (uint32)m_workers.size();
+			for (uint32 k = 1; k < workerCount; k++) {
+				if (m_workers[(index + k) % workerCount]->deque.steal(out)) return true;
+			}
+			return false;
 		}
 
-		void ThreadPoolWorker::terminate() {
+		void ThreadPoolImpl::runTask(uint32 index, ThreadTaskSlot& task) {
 			{
-				std::lock_guard lock(m_thisMutex);
-				m_terminationRequested = true;
+				PROCON34_PROFILE_SCOPE("ThreadPool::task");
+				task.run(task.storage, index);
 			}
-			m_condition.notify_all(); // 終了命令を通知
+			if (m_pendingCount.fetch_sub(1, std::memory_order_acq_rel) == 1) m_pendingCount.notify_all();
 		}
 
-		void ThreadPoolWorker::notifyAll() {
-			m_condition.notify_all();
+		void ThreadPoolImpl::wakeOne() {
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (m_sleepingCount.load(std::memory_order_relaxed) > 0) {
+				m_wakeEpoch.fetch_add(1, std::memory_order_seq_cst);
+				m_wakeEpoch.notify_one();
+			}
 		}
 
 
-		ThreadPoolImpl::ThreadPoolImpl(uint32 threadCount) :
-			m_terminationRequested(false)
+		// 枠（ slot ）を concurrency 個持ち、枠が空いていれば base に「キューが空になるまでタスクを実行し続けるタスク」を入れる。
+		// タスクは粗い（探索の 1 まとまり）ことを想定して、キューはロックで守る。
+		class LimitedThreadPool : public ThreadPool {
+		public:
+
+			static constexpr uint32 MaxConcurrency = 64;
+
+			LimitedThreadPool(ThreadPool& base, uint32 concurrency);
+
+			LimitedThreadPool(LimitedThreadPool&&) = delete;
+			LimitedThreadPool(const LimitedThreadPool&) = delete;
+			~LimitedThreadPool();
+
+			void pushTask(Task&& task) override;
+
+			void sync() override;
+
+			uint32 threadCount() const override { return m_concurrency; }
+
+			bool isWorkerThread() const override { return m_base.isWorkerThread(); }
+
+			bool runPendingTask() override;
+
+		private:
+
+			ThreadPool& m_base;
+			uint32 m_concurrency;
+			uint64 m_allSlots;
+
+			std::mutex m_mutex;
+			std::deque<ThreadTask> m_queue; // m_mutex で守る
+			uint64 m_freeSlots; // m_mutex で守る。ビット i が立っていれば枠 i は空き
+
+			alignas(CacheLineSize) std::atomic<int64> m_pendingCount = 0;
+
+			// 枠 slot を持ってキューが空になるまで実行し、枠を返す
+			void runSlot(uint32 slot);
+
+			// キューから 1 つ取り出す。空なら、 releaseSlot が true のときは枠を返して false
+			bool popTask(ThreadTask& out, bool releaseSlot, uint32 slot);
+
+			void runTask(ThreadTask& task, uint32 slot);
+		};
+
+
+		LimitedThreadPool::LimitedThreadPool(ThreadPool& base, uint32 concurrency)
+			: m_base(base)
+			, m_concurrency(Clamp<uint32>(Min(concurrency, base.threadCount()), 1, MaxConcurrency))
 		{
-			// threadCount 個のスレッドを開始
-			m_workers.resize(threadCount);
-			for (uint32 idx = 0; idx < threadCount; idx++) {
-				m_workers[idx] = std::make_unique<ThreadPoolWorker>(this, idx);
+			m_allSlots = (m_concurrency == 64) ? ~(uint64)0 : (((uint64)1 << m_concurrency) - 1);
+			m_freeSlots = m_allSlots;
+		}
+
+		LimitedThreadPool::~LimitedThreadPool() {
+			sync();
+			// 最後のタスクの後、枠が返されるまで待つ
+			while (true) {
+				{
+					std::lock_guard lock(m_mutex);
+					if (m_freeSlots == m_allSlots) break;
+				}
+				std::this_thread::yield();
 			}
 		}
 
-		ThreadPoolImpl::~ThreadPoolImpl() { sync(); terminate(); }
+		void LimitedThreadPool::pushTask(ThreadPool::Task&& task) {
+			if (!task) return;
+			m_pendingCount.fetch_add(1, std::memory_order_relaxed);
 
-		void ThreadPoolImpl::pushTask(ThreadPool::Task&& task) {
+			Optional<uint32> slot;
 			{
-				std::lock_guard lock(m_thisMutex);
-				// 定数式を if に入れると警告がでるが、回避方法がわからない
-#pragma warning(push)
-#pragma warning(disable : 4127)
-				if (!QUEUE_TASK_AFTER_TERMINATION && m_terminationRequested) return;
-#pragma warning(pop)
-				m_taskQueue.push_back(std::move(task));
+				std::lock_guard lock(m_mutex);
+				m_queue.push_back(std::move(task));
+				if (m_freeSlots != 0) {
+					slot = (uint32)std::countr_zero(m_freeSlots);
+					m_freeSlots &= ~((uint64)1 << *slot);
+				}
+			}
+			if (slot.has_value()) {
+				m_base.pushTask([this, slot = *slot](uint32) { runSlot(slot); });
 			}
-			for (auto& worker : m_workers) worker->notifyAll();
 		}
 
-		void ThreadPoolImpl::sync() {
-			{
-				std::unique_lock lock(m_thisMutex);
-
-				// 今たまっているタスクを消化
-				auto pred = [&]() -> bool { return this->m_terminationRequested || this->m_taskQueue.empty(); };
-				m_condition.wait(lock, pred);
+		void LimitedThreadPool::sync() {
+			while (true) {
+				int64 current = m_pendingCount.load(std::memory_order_acquire);
+				if (current == 0) break;
+				m_pendingCount.wait(current, std::memory_order_acquire);
 			}
+		}
 
-			for (auto& worker : m_workers) worker->sync(); // スレッドに残ったタスクを待つ
+		bool LimitedThreadPool::runPendingTask() {
+			// 自分の枠で実行中のタスクが待っているなら、その枠のまま次のタスクを進める。
+			// base のタスクは進めない（ほかのプールの runSlot を拾うと、別の試合の探索をその上限の外で最後まで実行してしまう）
+			if (t_currentLimitedPool != this) return false;
+			ThreadTask task;
+			if (!popTask(task, false, t_limitedSlot)) return false;
+			runTask(task, t_limitedSlot);
+			return true;
 		}
 
-		Optional<ThreadPool::Task> ThreadPoolImpl::pullTask() {
-			Optional<ThreadPool::Task> res = none;
-			{
-				std::unique_lock<std::mutex> lock(m_thisMutex);
+		void LimitedThreadPool::runSlot(uint32 slot) {
+			auto previousPool = t_currentLimitedPool;
+			auto previousSlot = t_limitedSlot;
+			t_currentLimitedPool = this;
+			t_limitedSlot = slot;
 
-				if (!m_taskQueue.empty()) {
-					res = std::move(m_taskQueue.front());
-					m_taskQueue.pop_front();
-				}
-			}
-			m_condition.notify_all();
-			return res;
+			ThreadTask task;
+			while (popTask(task, true, slot)) runTask(task, slot);
+			// 枠を返した後は this に触れない
+
+			t_currentLimitedPool = previousPool;
+			t_limitedSlot = previousSlot;
 		}
 
-		void ThreadPoolImpl::terminate() {
-			{
-				std::lock_guard lock(m_thisMutex);
-				m_terminationRequested = true;
+		bool LimitedThreadPool::popTask(ThreadTask& out, bool releaseSlot, uint32 slot) {
+			std::lock_guard lock(m_mutex);
+			if (m_queue.empty()) {
+				if (releaseSlot) m_freeSlots |= (uint64)1 << slot;
+				return false;
 			}
-			m_condition.notify_all(); // 終了命令を通知
-			for (auto& worker : m_workers) worker->terminate(); // 終了命令を各スレッドに転送
+			out = std::move(m_queue.front());
+			m_queue.pop_front();
+			return true;
+		}
+
+		void LimitedThreadPool::runTask(ThreadTask& task, uint32 slot) {
+			task(slot);
+			if (m_pendingCount.fetch_sub(1, std::memory_order_acq_rel) == 1) m_pendingCount.notify_all();
 		}
 
 	}
@@ -236,8 +484,12 @@ namespace Procon34 {
 	}
 
 
-	std::unique_ptr<ThreadPool> ThreadPool::Construct(uint32 threadCount) {
-		return std::unique_ptr<ThreadPool>(new ThreadPoolImpl(threadCount));
+	std::unique_ptr<ThreadPool> ThreadPool::Construct(uint32 threadCount, bool pinThreads) {
+		return std::unique_ptr<ThreadPool>(new ThreadPoolImpl(threadCount, pinThreads));
+	}
+
+	std::unique_ptr<ThreadPool> ThreadPool::ConstructLimited(ThreadPool& base, uint32 concurrency) {
+		return std::unique_ptr<ThreadPool>(new LimitedThreadPool(base, concurrency));
 	}
 
-} // namespace Procon33
+} // namespace Procon34
@@ -1,21 +1,109 @@
 ﻿#pragma once
 
-// copied https://github.com/NachiaVivias/procon2022-omuct/blob/main/procon2022-omuct/solver/thread_pool.h
+// 最初の版は https://github.com/NachiaVivias/procon2022-omuct/blob/main/procon2022-omuct/solver/thread_pool.h からコピーした
 
 
 // 参考 ： (基礎) https://qiita.com/termoshtt/items/c01745ea4bcc89d37edc
 //         (主に理論) https://contentsviewer.work/Master/Cpp/how-to-implement-a-thread-pool/article
 //         (コード例) https://zenn.dev/rita0222/articles/13953a5dfb9698
+//         (work stealing) D. Chase, Y. Lev. Dynamic Circular Work-Stealing Deque. SPAA 2005.
+//                         N. M. Lê et al. Correct and Efficient Work-Stealing for Weak Memory Models. PPoPP 2013.
 
 #include "../stdafx.h"
-#include <functional>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <type_traits>
 
 namespace Procon34 {
 
+	// ThreadPool のキューに入る形。 memcpy で運べる
+	struct ThreadTaskSlot {
+		static constexpr size_t InlineSize = 112;
+
+		void (*run)(void* storage, uint32 threadIndex) = nullptr; // 実行して後始末もする
+		void (*discard)(void* storage) = nullptr; // 実行せずに後始末する
+		alignas(16) unsigned char storage[InlineSize];
+	};
+
+	// ThreadPool に渡す処理。
+	// 小さくて単純にコピーできる関数オブジェクト（参照や整数をキャプチャしたラムダなど）は中に持つので、確保が起きない。
+	// それ以外は new して持つ。
+	class ThreadTask {
+	public:
+
+		ThreadTask() = default;
+
+		template<class F, std::enable_if_t<!std::is_same_v<std::decay_t<F>, ThreadTask>, int> = 0>
+		ThreadTask(F&& f) {
+			using Fn = std::decay_t<F>;
+			if constexpr (sizeof(Fn) <= ThreadTaskSlot::InlineSize && alignof(Fn) <= 16
+				&& std::is_trivially_copyable_v<Fn> && std::is_trivially_destructible_v<Fn>) {
+				new (m_slot.storage) Fn(std::forward<F>(f));
+				m_slot.run = [](void* storage, uint32 threadIndex) { (*static_cast<Fn*>(storage))(threadIndex); };
+				m_slot.discard = [](void*) {};
+			}
+			else {
+				Fn* ptr = new Fn(std::forward<F>(f));
+				std::memcpy(m_slot.storage, &ptr, sizeof(ptr));
+				m_slot.run = [](void* storage, uint32 threadIndex) {
+					Fn* ptr; std::memcpy(&ptr, storage, sizeof(ptr));
+					std::unique_ptr<Fn> owner(ptr);
+					(*ptr)(threadIndex);
+				};
+				m_slot.discard = [](void* storage) {
+					Fn* ptr; std::memcpy(&ptr, storage, sizeof(ptr));
+					delete ptr;
+				};
+			}
+		}
+
+		ThreadTask(ThreadTask&& other) noexcept : m_slot(other.release()) {}
+
+		ThreadTask& operator=(ThreadTask&& other) noexcept {
+			if (this != &other) {
+				reset();
+				m_slot = other.release();
+			}
+			return *this;
+		}
+
+		ThreadTask(const ThreadTask&) = delete;
+		ThreadTask& operator=(const ThreadTask&) = delete;
+
+		~ThreadTask() { reset(); }
+
+		explicit operator bool() const { return m_slot.run != nullptr; }
+
+		// 実行する。実行した後は空になる
+		void operator()(uint32 threadIndex) {
+			auto slot = release();
+			slot.run(slot.storage, threadIndex);
+		}
+
+		// 中身を取り出して空になる。取り出したものは run か discard をちょうど 1 回呼ぶこと
+		ThreadTaskSlot release() {
+			auto slot = m_slot;
+			m_slot.run = nullptr;
+			m_slot.discard = nullptr;
+			return slot;
+		}
+
+	private:
+		ThreadTaskSlot m_slot;
+
+		void reset() {
+			if (m_slot.discard) m_slot.discard(m_slot.storage);
+			m_slot.run = nullptr;
+			m_slot.discard = nullptr;
+		}
+	};
+
 	class ThreadPool {
 	public:
 
-		using Task = std::function<void(uint32)>;
+		using Task = ThreadTask;
 
 		// コピーとかだめだよ
 		ThreadPool(ThreadPool&&) = delete;
@@ -25,8 +113,15 @@ namespace Procon34 {
 		// デストラクト時には sync が呼ばれる
 		virtual ~ThreadPool() = default;
 
-		// スレッドを threadCount 個管理するプールを作成
-		static std::unique_ptr<ThreadPool> Construct(uint32 threadCount);
+		// スレッドを threadCount 個管理するプールを作成。
+		// pinThreads が true なら、 i 番目のスレッドを i 番目の論理プロセッサに固定する
+		static std::unique_ptr<ThreadPool> Construct(uint32 threadCount, bool pinThreads = false);
+
+		// base のスレッドのうち、同時には最大 concurrency 個だけを使うプールを作成。
+		// スレッドは作らず、タスクは base で実行される。 threadIndex は 0 以上 threadCount() 未満になる。
+		// runPendingTask で進めるのはこのプールのタスクだけ（ base のほかのタスクは拾わない）。
+		// base より先に破棄すること
+		static std::unique_ptr<ThreadPool> ConstructLimited(ThreadPool& base, uint32 concurrency);
 
 		// ハードウェアでサポートされるスレッド数を返す。
 		// わからないなら none を返す。
@@ -36,12 +131,65 @@ namespace Procon34 {
 			return res;
 		}
 
-		// タスクをキューに追加する
+		// タスクを追加する。
+		// このプールのタスクの中から呼ぶとそのスレッドの両端キューに、それ以外からは共有のキューに入る
 		virtual void pushTask(Task&& task) = 0;
 
-		// キューにあるタスクをすべて処理する
+		// 追加したタスクがすべて終わるまで待つ。
+		// このプールのタスクの中から呼んではいけない（自分の終わりを待つことになる）
 		virtual void sync() = 0;
 
+		virtual uint32 threadCount() const = 0;
+
+		// 今のスレッドがこのプールのスレッドか
+		virtual bool isWorkerThread() const = 0;
+
+		// このプールのスレッドから呼ばれたら、待っているタスクを 1 つ実行して true を返す。
+		// タスクの中で何かを待つときに、待つ間ほかのタスクを進めるために使う（ TaskGroup::wait など）
+		virtual bool runPendingTask() = 0;
+
+		// [begin, end) の各 i について f(i) （または f(i, threadIndex) ）を並列に呼び、すべて終わるまで待つ。
+		// 区間はスレッド数の 4 倍程度のかたまりに分ける。
+		// ほかのタスクの終わりは待たない。このプールのタスクの中から呼んでもよい。
+		template<class F>
+		void parallelFor(size_t begin, size_t end, F&& f) {
+			if (begin >= end) return;
+			size_t chunkCount = Min<size_t>(end - begin, (size_t)Max<uint32>(1, threadCount()) * 4);
+			size_t chunkSize = (end - begin + chunkCount - 1) / chunkCount;
+			chunkCount = (end - begin + chunkSize - 1) / chunkSize;
+
+			// remaining と finished はこの関数のスタックにあるので、最後のタスクが finished を書くまでは戻らない
+			std::atomic<size_t> remaining = chunkCount;
+			std::atomic<bool> finished = false;
+			auto* func = &f;
+			for (size_t chunkBegin = begin; chunkBegin < end; chunkBegin += chunkSize) {
+				size_t chunkEnd = Min(chunkBegin + chunkSize, end);
+				pushTask([func, &remaining, &finished, chunkBegin, chunkEnd](uint32 threadIndex) {
+					for (size_t i = chunkBegin; i < chunkEnd; i++) {
+						if constexpr (std::is_invocable_v<F&, size_t, uint32>) (*func)(i, threadIndex);
+						else (*func)(i);
+					}
+					if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+						remaining.notify_all();
+						finished.store(true, std::memory_order_release);
+					}
+				});
+			}
+
+			// タスクの中から呼ばれたら、待つ間もほかのタスクを進める。
+			// そのときは眠らない（眠ると、後から積まれたタスクを誰も実行しなくなることがある）
+			while (!finished.load(std::memory_order_acquire)) {
+				size_t current = remaining.load(std::memory_order_acquire);
+				if (current == 0) {
+					std::this_thread::yield();
+				}
+				else if (!runPendingTask()) {
+					if (isWorkerThread()) std::this_thread::yield();
+					else remaining.wait(current, std::memory_order_acquire);
+				}
+			}
+		}
+
 	protected:
 
 		// static 関数 Construct を使うこと
@@ -49,4 +197,4 @@ namespace Procon34 {
 
 	};
 
-} // namespace Procon33
+} // namespace Procon34
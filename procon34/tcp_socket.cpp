@@ -0,0 +1,225 @@
+﻿#include "tcp_socket.hpp"
+#include <chrono>
+#include <utility>
+
+#if SIV3D_PLATFORM(WINDOWS)
+#include <Siv3D/Windows/Windows.hpp>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+namespace Procon34 {
+
+	namespace {
+
+#if SIV3D_PLATFORM(WINDOWS)
+		using SocketHandle = SOCKET;
+		constexpr int32 SendFlags = 0;
+		constexpr int32 ShutdownBoth = SD_BOTH;
+
+		void CloseSocketHandle(SocketHandle s) { closesocket(s); }
+
+		// WSAStartup は最初にソケットを作る前に 1 回だけ呼ぶ
+		void EnsureInitialized() {
+			struct WinsockSession {
+				WinsockSession() { WSADATA data; WSAStartup(MAKEWORD(2, 2), &data); }
+				~WinsockSession() { WSACleanup(); }
+			};
+			static WinsockSession session;
+		}
+
+		void SetNonBlocking(SocketHandle s, bool enabled) {
+			u_long mode = enabled ? 1 : 0;
+			::ioctlsocket(s, FIONBIO, &mode);
+		}
+
+		// 非ブロッキングの connect が、まだ終わっていないだけか
+		bool IsConnectInProgress() { return ::WSAGetLastError() == WSAEWOULDBLOCK; }
+
+		// 接続が終わる（書き込めるようになるか、失敗する）まで最大 milliseconds 待つ。時間切れなら false
+		bool WaitConnected(SocketHandle s, int32 milliseconds) {
+			fd_set writable, failed;
+			FD_ZERO(&writable);
+			FD_ZERO(&failed);
+			FD_SET(s, &writable);
+			FD_SET(s, &failed);
+			timeval timeout{ .tv_sec = milliseconds / 1000, .tv_usec = (milliseconds % 1000) * 1000 };
+			return ::select(0, nullptr, &writable, &failed, &timeout) > 0;
+		}
+#else
+		using SocketHandle = int;
+		constexpr int32 SendFlags = MSG_NOSIGNAL; // 切れた接続に書いても SIGPIPE で落ちないように
+		constexpr int32 ShutdownBoth = SHUT_RDWR;
+
+		void CloseSocketHandle(SocketHandle s) { ::close(s); }
+
+		void EnsureInitialized() {}
+
+		void SetNonBlocking(SocketHandle s, bool enabled) {
+			int flags = ::fcntl(s, F_GETFL, 0);
+			::fcntl(s, F_SETFL, enabled ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK));
+		}
+
+		// 非ブロッキングの connect が、まだ終わっていないだけか
+		bool IsConnectInProgress() { return errno == EINPROGRESS; }
+
+		// 接続が終わる（書き込めるようになるか、失敗する）まで最大 milliseconds 待つ。時間切れなら false
+		bool WaitConnected(SocketHandle s, int32 milliseconds) {
+			pollfd target{ .fd = s, .events = POLLOUT };
+			return ::poll(&target, 1, milliseconds) > 0;
+		}
+#endif
+
+		constexpr intptr_t InvalidHandle = -1;
+
+		SocketHandle ToHandle(intptr_t s) { return (SocketHandle)s; }
+
+		bool IsValid(SocketHandle s) { return (intptr_t)s != InvalidHandle; }
+
+		// 非ブロッキングで接続を始め、 milliseconds まで待つ。つながったらブロッキングに戻して true
+		bool ConnectWithTimeout(SocketHandle s, const addrinfo& address, int32 milliseconds) {
+			SetNonBlocking(s, true);
+			if (::connect(s, address.ai_addr, (int)address.ai_addrlen) != 0) {
+				if (!IsConnectInProgress() || !WaitConnected(s, milliseconds)) return false;
+				int error = 0;
+				socklen_t errorLength = sizeof(error);
+				if (::getsockopt(s, SOL_SOCKET, SO_ERROR, (char*)&error, &errorLength) != 0 || error != 0) return false;
+			}
+			SetNonBlocking(s, false);
+			return true;
+		}
+
+	}
+
+
+	TcpSocket::TcpSocket(TcpSocket&& other) noexcept
+		: m_handle(std::exchange(other.m_handle, InvalidHandle))
+	{}
+
+	TcpSocket& TcpSocket::operator=(TcpSocket&& other) noexcept {
+		if (this != &other) {
+			close();
+			m_handle = std::exchange(other.m_handle, InvalidHandle);
+		}
+		return *this;
+	}
+
+	TcpSocket::~TcpSocket() {
+		close();
+	}
+
+	TcpSocket TcpSocket::Connect(const std::string& host, uint16 port, int32 timeoutMilliseconds) {
+		EnsureInitialized();
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMilliseconds);
+
+		addrinfo hints{};
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_protocol = IPPROTO_TCP;
+		addrinfo* addresses = nullptr;
+		if (::getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0) return TcpSocket();
+
+		TcpSocket res;
+		for (auto address = addresses; address; address = address->ai_next) {
+			auto rest = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+			if (rest <= 0) break;
+			SocketHandle s = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+			if (!IsValid(s)) continue;
+			if (ConnectWithTimeout(s, *address, (int32)rest)) {
+				res = TcpSocket((intptr_t)s);
+				break;
+			}
+			CloseSocketHandle(s);
+		}
+		::freeaddrinfo(addresses);
+		return res;
+	}
+
+	TcpSocket TcpSocket::Listen(uint16 port) {
+		EnsureInitialized();
+
+		SocketHandle s = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (!IsValid(s)) return TcpSocket();
+		TcpSocket res((intptr_t)s);
+
+		int yes = 1;
+		::setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&yes, sizeof(yes));
+
+		sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_port = htons(port);
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		if (::bind(s, (const sockaddr*)&address, sizeof(address)) != 0 || ::listen(s, 64) != 0) return TcpSocket();
+		return res;
+	}
+
+	TcpSocket TcpSocket::accept() const {
+		SocketHandle s = ::accept(ToHandle(m_handle), nullptr, nullptr);
+		if (!IsValid(s)) return TcpSocket();
+		return TcpSocket((intptr_t)s);
+	}
+
+	bool TcpSocket::isOpen() const {
+		return m_handle != InvalidHandle;
+	}
+
+	uint16 TcpSocket::localPort() const {
+		sockaddr_in address{};
+		socklen_t addressLength = sizeof(address);
+		if (::getsockname(ToHandle(m_handle), (sockaddr*)&address, &addressLength) != 0) return 0;
+		return ntohs(address.sin_port);
+	}
+
+	void TcpSocket::setNoDelay() {
+		int yes = 1;
+		::setsockopt(ToHandle(m_handle), IPPROTO_TCP, TCP_NODELAY, (const char*)&yes, sizeof(yes));
+	}
+
+	void TcpSocket::setReceiveTimeout(int32 milliseconds) {
+#if SIV3D_PLATFORM(WINDOWS)
+		DWORD timeout = (DWORD)milliseconds;
+#else
+		timeval timeout{ .tv_sec = milliseconds / 1000, .tv_usec = (milliseconds % 1000) * 1000 };
+#endif
+		::setsockopt(ToHandle(m_handle), SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+	}
+
+	bool TcpSocket::sendAll(const char* data, size_t size) const {
+		while (size > 0) {
+			auto sent = ::send(ToHandle(m_handle), data, (int)Min<size_t>(size, 1 << 20), SendFlags);
+			if (sent <= 0) return false;
+			data += sent;
+			size -= (size_t)sent;
+		}
+		return true;
+	}
+
+	bool TcpSocket::receiveMore(std::string& buffer) const {
+		char chunk[16384];
+		auto received = ::recv(ToHandle(m_handle), chunk, (int)sizeof(chunk), 0);
+		if (received <= 0) return false;
+		buffer.append(chunk, (size_t)received);
+		return true;
+	}
+
+	void TcpSocket::shutdown() const {
+		if (isOpen()) ::shutdown(ToHandle(m_handle), ShutdownBoth);
+	}
+
+	void TcpSocket::close() {
+		if (isOpen()) CloseSocketHandle(ToHandle(std::exchange(m_handle, InvalidHandle)));
+	}
+
+}
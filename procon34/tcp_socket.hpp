@@ -0,0 +1,64 @@
+﻿#pragma once
+#include "stdafx.h"
+#include <string>
+
+// TCP のソケットを 1 つ持つ（ Windows と Linux の違いをここに閉じ込める）。
+// HttpClient とローカルのサーバー (MockServer::LocalHttpServer) で使う。
+
+namespace Procon34 {
+
+	class TcpSocket {
+	public:
+
+		// 何も持たない
+		TcpSocket() = default;
+
+		TcpSocket(TcpSocket&& other) noexcept;
+		TcpSocket& operator=(TcpSocket&& other) noexcept;
+
+		TcpSocket(const TcpSocket&) = delete;
+		TcpSocket& operator=(const TcpSocket&) = delete;
+
+		~TcpSocket();
+
+		// host:port に接続する。名前が複数のアドレスになれば順に試す。
+		// timeoutMilliseconds までにつながらなければ（すべてのアドレスを合わせて）何も持たないものを返す
+		static TcpSocket Connect(const std::string& host, uint16 port, int32 timeoutMilliseconds);
+
+		// 127.0.0.1:port で待ち受ける。 port が 0 なら空いているものを使う。待ち受けられなければ何も持たないものを返す
+		static TcpSocket Listen(uint16 port);
+
+		// 待ち受けているソケットで接続を 1 つ受け付ける。失敗したら（閉じられたら）何も持たないものを返す
+		TcpSocket accept() const;
+
+		bool isOpen() const;
+
+		explicit operator bool() const { return isOpen(); }
+
+		// 待ち受けているポート、または接続元のポート
+		uint16 localPort() const;
+
+		// 小さな要求・応答をまとめずにすぐ送る (TCP_NODELAY)
+		void setNoDelay();
+
+		// 受信を待つ時間の上限。過ぎると receiveMore が false を返す
+		void setReceiveTimeout(int32 milliseconds);
+
+		// すべて送る。接続が切れたら false
+		bool sendAll(const char* data, size_t size) const;
+
+		// 受け取ったものを buffer の後ろに足す。接続が切れたら（時間切れなら） false
+		bool receiveMore(std::string& buffer) const;
+
+		// 送受信をやめる。別のスレッドで待っている accept や receiveMore が戻る（閉じはしない）
+		void shutdown() const;
+
+		void close();
+
+	private:
+		intptr_t m_handle = -1;
+
+		explicit TcpSocket(intptr_t handle) : m_handle(handle) {}
+	};
+
+}